@@ -1393,3 +1393,298 @@ int CRC32_ex(void *key, const int key_len, \
 	return crc;
 }
 
+
+/* wyhash: 64 bits multiply-mix hash, reads 8 bytes per step,
+ * the 64 bits result is folded to 32 bits for HashFunc
+ */
+static const uint64_t wyhash_secret[4] = {
+	0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+	0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+static inline void wyhash_mum(uint64_t *a, uint64_t *b)
+{
+#ifdef __SIZEOF_INT128__
+	__uint128_t r;
+	r = *a;
+	r *= *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#else
+	uint64_t ha, hb, la, lb;
+	uint64_t rh, rm0, rm1, rl;
+	uint64_t t, lo, c;
+
+	ha = *a >> 32; hb = *b >> 32;
+	la = (uint32_t)*a; lb = (uint32_t)*b;
+	rh = ha * hb; rm0 = ha * lb; rm1 = hb * la; rl = la * lb;
+	t = rl + (rm0 << 32);
+	c = t < rl;
+	lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t wyhash_mix(uint64_t a, uint64_t b)
+{
+	wyhash_mum(&a, &b);
+	return a ^ b;
+}
+
+static inline uint64_t wyhash_read8(const unsigned char *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t wyhash_read4(const unsigned char *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static uint64_t wyhash64(const void *key, const int key_len, uint64_t seed)
+{
+	const unsigned char *p;
+	uint64_t a;
+	uint64_t b;
+	uint64_t see1;
+	uint64_t see2;
+	int i;
+
+	p = (const unsigned char *)key;
+	seed ^= wyhash_mix(seed ^ wyhash_secret[0], wyhash_secret[1]);
+	if (key_len <= 16)
+	{
+		if (key_len >= 4)
+		{
+			a = (wyhash_read4(p) << 32) |
+				wyhash_read4(p + ((key_len >> 3) << 2));
+			b = (wyhash_read4(p + key_len - 4) << 32) |
+				wyhash_read4(p + key_len - 4 - ((key_len >> 3) << 2));
+		}
+		else if (key_len > 0)
+		{
+			a = ((uint64_t)p[0] << 16) | ((uint64_t)p[key_len >> 1] << 8) |
+				p[key_len - 1];
+			b = 0;
+		}
+		else
+		{
+			a = b = 0;
+		}
+	}
+	else
+	{
+		i = key_len;
+		if (i > 48)
+		{
+			see1 = see2 = seed;
+			do
+			{
+				seed = wyhash_mix(wyhash_read8(p) ^ wyhash_secret[1],
+						wyhash_read8(p + 8) ^ seed);
+				see1 = wyhash_mix(wyhash_read8(p + 16) ^ wyhash_secret[2],
+						wyhash_read8(p + 24) ^ see1);
+				see2 = wyhash_mix(wyhash_read8(p + 32) ^ wyhash_secret[3],
+						wyhash_read8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while (i > 16)
+		{
+			seed = wyhash_mix(wyhash_read8(p) ^ wyhash_secret[1],
+					wyhash_read8(p + 8) ^ seed);
+			p += 16;
+			i -= 16;
+		}
+		a = wyhash_read8(p + i - 16);
+		b = wyhash_read8(p + i - 8);
+	}
+
+	a ^= wyhash_secret[1];
+	b ^= seed;
+	wyhash_mum(&a, &b);
+	return wyhash_mix(a ^ wyhash_secret[0] ^ key_len, b ^ wyhash_secret[1]);
+}
+
+#define WYHASH_FOLD(h)  ((int)((h) ^ ((h) >> 32)))
+
+int wyhash(const void *key, const int key_len)
+{
+	uint64_t h;
+	h = wyhash64(key, key_len, 0);
+	return WYHASH_FOLD(h);
+}
+
+int wyhash_ex(const void *key, const int key_len, \
+	const int init_value)
+{
+	uint64_t h;
+	h = wyhash64(key, key_len, (uint32_t)init_value);
+	return WYHASH_FOLD(h);
+}
+
+/* CRC32C (Castagnoli polynomial), use the SSE4.2 crc32 instruction
+ * when the CPU supports, otherwise slicing-by-8 tables.
+ * both implementations return the same value
+ */
+#define CRC32C_POLY  0x82F63B78
+
+typedef unsigned int (*crc32c_func)(unsigned int crc,
+		const unsigned char *p, int len);
+
+static unsigned int crc32c_table[8][256];
+
+static unsigned int crc32c_resolve(unsigned int crc,
+		const unsigned char *p, int len);
+
+static volatile crc32c_func crc32c_update = crc32c_resolve;
+
+static unsigned int crc32c_sw(unsigned int crc,
+		const unsigned char *p, int len)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	uint64_t v;
+
+	while (len >= 8)
+	{
+		v = wyhash_read8(p) ^ crc;
+		crc = crc32c_table[7][v & 0xFF] ^
+			crc32c_table[6][(v >> 8) & 0xFF] ^
+			crc32c_table[5][(v >> 16) & 0xFF] ^
+			crc32c_table[4][(v >> 24) & 0xFF] ^
+			crc32c_table[3][(v >> 32) & 0xFF] ^
+			crc32c_table[2][(v >> 40) & 0xFF] ^
+			crc32c_table[1][(v >> 48) & 0xFF] ^
+			crc32c_table[0][v >> 56];
+		p += 8;
+		len -= 8;
+	}
+#endif
+	while (len-- > 0)
+	{
+		crc = crc32c_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define CRC32C_HW_SUPPORTED 1
+
+__attribute__((target("sse4.2")))
+static unsigned int crc32c_hw(unsigned int crc,
+		const unsigned char *p, int len)
+{
+	uint64_t c;
+
+	c = crc;
+	while (len >= 8)
+	{
+		c = __builtin_ia32_crc32di(c, wyhash_read8(p));
+		p += 8;
+		len -= 8;
+	}
+	crc = (unsigned int)c;
+	if (len >= 4)
+	{
+		crc = __builtin_ia32_crc32si(crc, (unsigned int)wyhash_read4(p));
+		p += 4;
+		len -= 4;
+	}
+	while (len-- > 0)
+	{
+		crc = __builtin_ia32_crc32qi(crc, *p++);
+	}
+	return crc;
+}
+#endif
+
+static volatile int crc32c_table_inited = 0;
+
+static void crc32c_init_table()
+{
+	unsigned int c;
+	int i;
+	int k;
+
+	for (i=0; i<256; i++)
+	{
+		c = i;
+		for (k=0; k<8; k++)
+		{
+			c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+		}
+		crc32c_table[0][i] = c;
+	}
+	for (i=0; i<256; i++)
+	{
+		c = crc32c_table[0][i];
+		for (k=1; k<8; k++)
+		{
+			c = crc32c_table[0][c & 0xFF] ^ (c >> 8);
+			crc32c_table[k][i] = c;
+		}
+	}
+
+	//the tables should be seen before the flag
+	__sync_synchronize();
+	crc32c_table_inited = 1;
+}
+
+static unsigned int crc32c_resolve(unsigned int crc,
+		const unsigned char *p, int len)
+{
+#ifdef CRC32C_HW_SUPPORTED
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse4.2"))
+	{
+		crc32c_update = crc32c_hw;
+		return crc32c_hw(crc, p, len);
+	}
+#endif
+
+	if (!crc32c_table_inited)
+	{
+		crc32c_init_table();
+	}
+	crc32c_update = crc32c_sw;
+	return crc32c_sw(crc, p, len);
+}
+
+int CRC32C(const void *key, const int key_len)
+{
+	return crc32c_update(CRC32_XINIT, (const unsigned char *)key,
+			key_len) ^ CRC32_XOROT;
+}
+
+int CRC32C_ex(const void *key, const int key_len, \
+	const int init_value)
+{
+	return crc32c_update(init_value, (const unsigned char *)key, key_len);
+}
+
+int CRC32C_soft_ex(const void *key, const int key_len, \
+	const int init_value)
+{
+	if (!crc32c_table_inited)
+	{
+		crc32c_init_table();
+	}
+	return crc32c_sw(init_value, (const unsigned char *)key, key_len);
+}
+
+bool CRC32C_hw_enabled()
+{
+	if (crc32c_update == crc32c_resolve)
+	{
+		CRC32C("", 0);
+	}
+	return crc32c_update != crc32c_sw;
+}
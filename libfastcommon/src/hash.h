@@ -356,6 +356,30 @@ int CRC32_ex(void *key, const int key_len, \
 
 #define CRC32_FINAL(crc)  (crc ^ CRC32_XOROT)
 
+/* wyhash: fast 64 bits multiply-mix hash folded to 32 bits,
+ * much faster than the byte-serial hashes for long keys
+ */
+int wyhash(const void *key, const int key_len);
+int wyhash_ex(const void *key, const int key_len, \
+	const int init_value);
+
+/* CRC32C (Castagnoli): use the SSE4.2 crc32 instruction when the CPU
+ * supports, otherwise the slicing-by-8 software implementation.
+ * init with CRC32_XINIT and finish with CRC32_FINAL for CRC32C_ex
+ */
+int CRC32C(const void *key, const int key_len);
+int CRC32C_ex(const void *key, const int key_len, \
+	const int init_value);
+
+/* the slicing-by-8 software CRC32C, returns the same value as CRC32C_ex
+ * to verify the hardware one
+ */
+int CRC32C_soft_ex(const void *key, const int key_len, \
+	const int init_value);
+
+/* if CRC32C uses the SSE4.2 crc32 instruction */
+bool CRC32C_hw_enabled();
+
 #define INIT_HASH_CODES4(hash_codes) \
 	hash_codes[0] = CRC32_XINIT; \
 	hash_codes[1] = 0; \
@@ -81,6 +81,209 @@ int get_sys_total_mem_size(int64_t *mem_size)
 #endif
 }
 
+#define CGROUP_ROOT_PATH   "/sys/fs/cgroup"
+
+//the limit >= this value means no limit for cgroup v1
+#define CGROUP_V1_NO_LIMIT (1LL << 62)
+
+static int read_first_line(const char *filename, char *buff, const int size)
+{
+    FILE *fp;
+    int len;
+
+    if ((fp=fopen(filename, "r")) == NULL)
+    {
+        return errno != 0 ? errno : ENOENT;
+    }
+    if (fgets(buff, size, fp) == NULL)
+    {
+        fclose(fp);
+        return EIO;
+    }
+    fclose(fp);
+
+    len = strlen(buff);
+    while (len > 0 && (buff[len - 1] == '\n' || buff[len - 1] == '\r'))
+    {
+        buff[--len] = '\0';
+    }
+    return 0;
+}
+
+/* get the cgroup path of the current process from /proc/self/cgroup,
+ * the line format: hierarchy-ID:controller-list:cgroup-path
+ * cgroup v2 line such as: 0::/user.slice
+ * cgroup v1 line such as: 4:memory:/docker/xxx
+ */
+static int get_cgroup_path(const bool v2, char *path, const int size)
+{
+    FILE *fp;
+    char line[1024];
+    char *controllers;
+    char *cgroup_path;
+    char *p;
+    bool found;
+
+    if ((fp=fopen("/proc/self/cgroup", "r")) == NULL)
+    {
+        return errno != 0 ? errno : ENOENT;
+    }
+
+    found = false;
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        if ((controllers=strchr(line, ':')) == NULL)
+        {
+            continue;
+        }
+        controllers++;
+        if ((cgroup_path=strchr(controllers, ':')) == NULL)
+        {
+            continue;
+        }
+        *cgroup_path++ = '\0';
+        if ((p=strchr(cgroup_path, '\n')) != NULL)
+        {
+            *p = '\0';
+        }
+
+        if (v2)
+        {
+            found = (*controllers == '\0');
+        }
+        else
+        {
+            for (p=strtok(controllers, ","); p!=NULL; p=strtok(NULL, ","))
+            {
+                if (strcmp(p, "memory") == 0)
+                {
+                    found = true;
+                    break;
+                }
+            }
+        }
+
+        if (found)
+        {
+            snprintf(path, size, "%s", cgroup_path);
+            break;
+        }
+    }
+    fclose(fp);
+
+    return found ? 0 : ENOENT;
+}
+
+/* parse the memory limit file, return ENOENT for no limit */
+static int get_cgroup_limit_from_file(const char *filename, int64_t *limit)
+{
+    int result;
+    char buff[64];
+    char *end;
+
+    if ((result=read_first_line(filename, buff, sizeof(buff))) != 0)
+    {
+        return result;
+    }
+    if (strcmp(buff, "max") == 0)  //cgroup v2 no limit
+    {
+        return ENOENT;
+    }
+
+    *limit = strtoll(buff, &end, 10);
+    if (end == buff || *limit <= 0 || *limit >= CGROUP_V1_NO_LIMIT)
+    {
+        return ENOENT;
+    }
+    return 0;
+}
+
+static int get_cgroup_mem_limit_ex(const bool v2, int64_t *limit)
+{
+    const char *dir;
+    const char *limit_filename;
+    char cgroup_path[MAX_PATH_SIZE];
+    char filename[2 * MAX_PATH_SIZE];
+
+    if (v2)
+    {
+        dir = CGROUP_ROOT_PATH;
+        limit_filename = "memory.max";
+    }
+    else
+    {
+        dir = CGROUP_ROOT_PATH"/memory";
+        limit_filename = "memory.limit_in_bytes";
+    }
+
+    //the cgroup path maybe invisible in the container, try the root
+    if (get_cgroup_path(v2, cgroup_path, sizeof(cgroup_path)) == 0 &&
+            strcmp(cgroup_path, "/") != 0)
+    {
+        snprintf(filename, sizeof(filename), "%s%s/%s",
+                dir, cgroup_path, limit_filename);
+        if (access(filename, F_OK) == 0)
+        {
+            return get_cgroup_limit_from_file(filename, limit);
+        }
+    }
+
+    snprintf(filename, sizeof(filename), "%s/%s", dir, limit_filename);
+    return get_cgroup_limit_from_file(filename, limit);
+}
+
+int get_cgroup_mem_limit(int64_t *limit)
+{
+#ifdef OS_LINUX
+    int result;
+
+    *limit = 0;
+    if ((result=get_cgroup_mem_limit_ex(true, limit)) == 0)
+    {
+        return 0;
+    }
+    if (result != ENOENT && result != ENOTDIR)
+    {
+        return result;
+    }
+    if ((result=get_cgroup_mem_limit_ex(false, limit)) == ENOTDIR)
+    {
+        result = ENOENT;
+    }
+    return result;
+#else
+    *limit = 0;
+    return ENOENT;
+#endif
+}
+
+int get_container_mem_size(int64_t *mem_size)
+{
+    int result;
+    int64_t limit;
+
+    if ((result=get_sys_total_mem_size(mem_size)) != 0)
+    {
+        return result;
+    }
+
+    if ((result=get_cgroup_mem_limit(&limit)) == 0)
+    {
+        if (limit < *mem_size)
+        {
+            *mem_size = limit;
+        }
+    }
+    else if (result != ENOENT)
+    {
+        logWarning("file: "__FILE__", line: %d, "
+                "get cgroup memory limit fail, "
+                "errno: %d, error info: %s, use the system total memory",
+                __LINE__, result, STRERROR(result));
+    }
+    return 0;
+}
+
 int get_sys_cpu_count()
 {
 #if defined(OS_LINUX) || defined(OS_FREEBSD)
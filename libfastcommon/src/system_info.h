@@ -120,6 +120,21 @@ extern "C" {
 */
 int get_sys_total_mem_size(int64_t *mem_size);
 
+/** get the memory limit of the cgroup (v1 or v2) of the current process
+ *  parameters:
+ *  	limit: return the memory limit
+ *  return: error no , 0 success, ENOENT for no limit, != 0 fail
+*/
+int get_cgroup_mem_limit(int64_t *limit);
+
+/** get the memory size which the current process can use, the less one
+ *  of the system total memory size and the cgroup memory limit
+ *  parameters:
+ *  	mem_size: return the memory size
+ *  return: error no , 0 success, != 0 fail
+*/
+int get_container_mem_size(int64_t *mem_size);
+
 
 /** get system CPU count
  *  parameters:
@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+#include <sys/types.h>
+#include "logger.h"
+#include "hash.h"
+
+#define CRC32C_CHECK_VALUE  0xE3069283
+#define MAX_DATA_LENGTH     4096
+#define RANDOM_TEST_COUNT   10000
+
+/* the reference of wyhash final4 for the key_len <= 16 */
+static const uint64_t ref_secret[4] = {
+	0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+	0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+static uint64_t ref_mix(uint64_t a, uint64_t b)
+{
+	__uint128_t r;
+	r = a;
+	r *= b;
+	return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+static uint64_t ref_read(const unsigned char *p, const int bytes)
+{
+	uint64_t v;
+	int i;
+
+	v = 0;
+	for (i=bytes-1; i>=0; i--)
+	{
+		v = (v << 8) | p[i];
+	}
+	return v;
+}
+
+static int ref_wyhash(const unsigned char *p, const int len,
+		uint64_t seed)
+{
+	uint64_t a;
+	uint64_t b;
+	__uint128_t r;
+	uint64_t h;
+
+	seed ^= ref_mix(seed ^ ref_secret[0], ref_secret[1]);
+	if (len >= 4)
+	{
+		a = (ref_read(p, 4) << 32) | ref_read(p + ((len >> 3) << 2), 4);
+		b = (ref_read(p + len - 4, 4) << 32) |
+			ref_read(p + len - 4 - ((len >> 3) << 2), 4);
+	}
+	else if (len > 0)
+	{
+		a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) |
+			p[len - 1];
+		b = 0;
+	}
+	else
+	{
+		a = b = 0;
+	}
+
+	a ^= ref_secret[1];
+	b ^= seed;
+	r = a;
+	r *= b;
+	a = (uint64_t)r;
+	b = (uint64_t)(r >> 64);
+	h = ref_mix(a ^ ref_secret[0] ^ len, b ^ ref_secret[1]);
+	return (int)(h ^ (h >> 32));
+}
+
+static int test_crc32c_check_value()
+{
+	const char *str = "123456789";
+	unsigned int crc;
+
+	crc = CRC32C(str, strlen(str));
+	if (crc != CRC32C_CHECK_VALUE)
+	{
+		printf("CRC32C (%s): %08X != %08X\n", CRC32C_hw_enabled() ?
+			"sse4.2" : "table", crc, CRC32C_CHECK_VALUE);
+		return 1;
+	}
+
+	crc = CRC32_FINAL(CRC32C_soft_ex(str, strlen(str), CRC32_XINIT));
+	if (crc != CRC32C_CHECK_VALUE)
+	{
+		printf("CRC32C (table): %08X != %08X\n", crc, CRC32C_CHECK_VALUE);
+		return 1;
+	}
+	return 0;
+}
+
+static int test_crc32c_random(unsigned char *buff)
+{
+	int i;
+	int offset;
+	int len;
+	int split;
+	unsigned int crc;
+	unsigned int soft;
+
+	for (i=0; i<RANDOM_TEST_COUNT; i++)
+	{
+		//the unaligned start and the tail shorter than 8 bytes
+		offset = rand() % 8;
+		len = rand() % (MAX_DATA_LENGTH - offset);
+		crc = CRC32C_ex(buff + offset, len, CRC32_XINIT);
+		soft = CRC32C_soft_ex(buff + offset, len, CRC32_XINIT);
+		if (crc != soft)
+		{
+			printf("offset: %d, length: %d, CRC32C: %08X != %08X\n",
+				offset, len, crc, soft);
+			return 1;
+		}
+
+		//the incremental one is the same as the whole one
+		split = len > 0 ? rand() % len : 0;
+		crc = CRC32C_ex(buff + offset + split, len - split,
+			CRC32C_soft_ex(buff + offset, split, CRC32_XINIT));
+		if (crc != soft)
+		{
+			printf("offset: %d, length: %d, split: %d, "
+				"CRC32C: %08X != %08X\n", offset, len, split, crc, soft);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int test_wyhash_tail(unsigned char *buff)
+{
+	unsigned char key[16];
+	int len;
+	int i;
+	int k;
+	int h;
+	int ref;
+
+	for (i=0; i<RANDOM_TEST_COUNT; i++)
+	{
+		len = i % 8;
+		memcpy(key, buff + rand() % (MAX_DATA_LENGTH - sizeof(key)),
+			sizeof(key));
+		h = wyhash_ex(key, len, i);
+		ref = ref_wyhash(key, len, (uint32_t)i);
+		if (h != ref)
+		{
+			printf("length: %d, wyhash: %08X != %08X\n", len, h, ref);
+			return 1;
+		}
+
+		//the bytes after the key are never read
+		memset(key + len, ~key[len], sizeof(key) - len);
+		if (wyhash_ex(key, len, i) != h)
+		{
+			printf("length: %d, wyhash reads after the key\n", len);
+			return 1;
+		}
+
+		//every byte of the key is mixed
+		for (k=0; k<len; k++)
+		{
+			key[k] ^= 0x5A;
+			if (wyhash_ex(key, len, i) == h)
+			{
+				printf("length: %d, wyhash ignores byte #%d\n", len, k);
+				return 1;
+			}
+			key[k] ^= 0x5A;
+		}
+	}
+
+	if (wyhash("", 0) != ref_wyhash((const unsigned char *)"", 0, 0))
+	{
+		printf("wyhash of the empty key is wrong\n");
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned char buff[MAX_DATA_LENGTH];
+	int i;
+	int fail_count;
+
+	log_init();
+	srand(time(NULL));
+	for (i=0; i<MAX_DATA_LENGTH; i++)
+	{
+		buff[i] = rand();
+	}
+
+	printf("CRC32C uses %s\n", CRC32C_hw_enabled() ? "sse4.2" : "table");
+	fail_count = 0;
+	fail_count += test_crc32c_check_value();
+	fail_count += test_crc32c_random(buff);
+	fail_count += test_wyhash_tail(buff);
+	if (fail_count == 0)
+	{
+		printf("hash test OK\n");
+	}
+	return fail_count;
+}
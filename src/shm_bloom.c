@@ -0,0 +1,115 @@
+//shm_bloom.c
+
+#include <errno.h>
+#include "logger.h"
+#include "shared_func.h"
+#include "shm_bloom.h"
+
+int shm_bloom_get_block_count(struct shmcache_config *config)
+{
+    int64_t counters;
+
+    if (!config->bloom_filter.enabled) {
+        return 0;
+    }
+
+    counters = (int64_t)config->max_key_count *
+        config->bloom_filter.counters_per_key;
+    return (counters + SHM_BLOOM_BLOCK_COUNTERS - 1) /
+        SHM_BLOOM_BLOCK_COUNTERS;
+}
+
+void shm_bloom_init(struct shmcache_context *context, const int block_count,
+        const int64_t base_offset, const int counters_per_key)
+{
+    int hash_count;
+
+    memset(&context->memory->bloom, 0, sizeof(context->memory->bloom));
+    if (block_count == 0) {
+        return;
+    }
+
+    //the optimal hash count is ln2 * counters per key
+    hash_count = (counters_per_key * 69 + 50) / 100;
+    if (hash_count < 1) {
+        hash_count = 1;
+    } else if (hash_count > SHM_BLOOM_MAX_HASH_COUNT) {
+        hash_count = SHM_BLOOM_MAX_HASH_COUNT;
+    }
+
+    context->memory->bloom.block_count = block_count;
+    context->memory->bloom.hash_count = hash_count;
+    context->memory->bloom.base_offset = base_offset;
+    shm_bloom_clear(context);
+}
+
+void shm_bloom_add(struct shmcache_context *context,
+        const unsigned int hash_code)
+{
+    unsigned char *block;
+    int c1;
+    int c2;
+    int index;
+    int counter;
+    int i;
+
+    if (context->memory->bloom.block_count == 0) {
+        return;
+    }
+
+    SHM_BLOOM_MIX(context, hash_code, block, c1, c2);
+    for (i=0; i<context->memory->bloom.hash_count; i++) {
+        index = (c1 + i * c2) & (SHM_BLOOM_BLOCK_COUNTERS - 1);
+        counter = SHM_BLOOM_COUNTER(block, index);
+        if (counter == SHM_BLOOM_COUNTER_MAX) {
+            continue;
+        }
+        if (++counter == SHM_BLOOM_COUNTER_MAX) {
+            context->memory->bloom.stats.saturated++;
+        }
+        block[index >> 1] = (block[index >> 1] & ~(0x0F << ((index & 1) << 2)))
+            | (counter << ((index & 1) << 2));
+    }
+
+    //the readers should see the counters before the entry
+    __sync_synchronize();
+}
+
+void shm_bloom_remove(struct shmcache_context *context,
+        const unsigned int hash_code)
+{
+    unsigned char *block;
+    int c1;
+    int c2;
+    int index;
+    int counter;
+    int i;
+
+    if (context->memory->bloom.block_count == 0) {
+        return;
+    }
+
+    SHM_BLOOM_MIX(context, hash_code, block, c1, c2);
+    for (i=0; i<context->memory->bloom.hash_count; i++) {
+        index = (c1 + i * c2) & (SHM_BLOOM_BLOCK_COUNTERS - 1);
+        counter = SHM_BLOOM_COUNTER(block, index);
+        //the saturated counter never decrease because the count is lost
+        if (counter == 0 || counter == SHM_BLOOM_COUNTER_MAX) {
+            continue;
+        }
+        counter--;
+        block[index >> 1] = (block[index >> 1] & ~(0x0F << ((index & 1) << 2)))
+            | (counter << ((index & 1) << 2));
+    }
+}
+
+void shm_bloom_clear(struct shmcache_context *context)
+{
+    if (context->memory->bloom.block_count == 0) {
+        return;
+    }
+
+    memset(context->segments.hashtable.base + context->memory->bloom.
+            base_offset, 0, (int64_t)SHM_BLOOM_BLOCK_SIZE *
+            context->memory->bloom.block_count);
+}
@@ -0,0 +1,113 @@
+//shm_bloom.h
+
+#ifndef _SHM_BLOOM_H
+#define _SHM_BLOOM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "common_define.h"
+#include "shmcache_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+get the block count of the filter by the config
+parameters:
+	config: the config
+return the block count, 0 for disabled
+*/
+int shm_bloom_get_block_count(struct shmcache_config *config);
+
+/**
+filter init when the share memory created
+parameters:
+	context: the context pointer
+    block_count: the block count, 0 for disabled
+    base_offset: the offset of the blocks in the hashtable segment
+    counters_per_key: the counters per key
+return none
+*/
+void shm_bloom_init(struct shmcache_context *context, const int block_count,
+        const int64_t base_offset, const int counters_per_key);
+
+/**
+add the key to the filter, should be called before the entry linked to
+the bucket, the caller should hold the lock
+parameters:
+	context: the context pointer
+    hash_code: the hash code of the key
+return none
+*/
+void shm_bloom_add(struct shmcache_context *context,
+        const unsigned int hash_code);
+
+/**
+remove the key from the filter, should be called after the entry unlinked
+from the bucket, the caller should hold the lock
+parameters:
+	context: the context pointer
+    hash_code: the hash code of the key
+return none
+*/
+void shm_bloom_remove(struct shmcache_context *context,
+        const unsigned int hash_code);
+
+/**
+reset all counters, the caller should hold the lock
+parameters:
+	context: the context pointer
+return none
+*/
+void shm_bloom_clear(struct shmcache_context *context);
+
+//the block and the first two counters from the mixed hash code
+#define SHM_BLOOM_MIX(context, hash_code, block, c1, c2) \
+    do { \
+        uint64_t _h; \
+        _h = (uint64_t)(hash_code) * 0x9e3779b97f4a7c15ULL; \
+        _h ^= _h >> 32; \
+        _h *= 0xc4ceb9fe1a85ec53ULL; \
+        _h ^= _h >> 29; \
+        block = (unsigned char *)(context->segments.hashtable.base + \
+            context->memory->bloom.base_offset) + SHM_BLOOM_BLOCK_SIZE * \
+            (int64_t)((uint32_t)(_h >> 32) % context->memory->bloom.block_count); \
+        c1 = _h & (SHM_BLOOM_BLOCK_COUNTERS - 1); \
+        c2 = ((_h >> 7) & (SHM_BLOOM_BLOCK_COUNTERS - 1)) | 1; \
+    } while (0)
+
+#define SHM_BLOOM_COUNTER(block, index) \
+    ((block[(index) >> 1] >> (((index) & 1) << 2)) & 0x0F)
+
+//false means the key never set, for lock-free readers
+static inline bool shm_bloom_may_contain(struct shmcache_context *context,
+        const unsigned int hash_code)
+{
+    unsigned char *block;
+    int c1;
+    int c2;
+    int i;
+
+    if (context->memory->bloom.block_count == 0) {
+        return true;
+    }
+
+    SHM_BLOOM_MIX(context, hash_code, block, c1, c2);
+    for (i=0; i<context->memory->bloom.hash_count; i++) {
+        if (SHM_BLOOM_COUNTER(block, (c1 + i * c2) &
+                    (SHM_BLOOM_BLOCK_COUNTERS - 1)) == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
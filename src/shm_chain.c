@@ -0,0 +1,283 @@
+//shm_chain.c
+
+#include <errno.h>
+#include "logger.h"
+#include "shared_func.h"
+#include "shm_checkpoint.h"
+#include "shm_chain.h"
+
+#define SHM_CHAIN_MIN_BUFFER_SIZE  (64 * 1024)
+
+//the assemble buffer of one thread
+struct shm_chain_buffer {
+    char *buff;
+    int size;
+};
+
+static pthread_key_t shm_chain_key;
+static pthread_once_t shm_chain_once = PTHREAD_ONCE_INIT;
+static int shm_chain_key_result = 0;
+
+void shm_chain_init(struct shmcache_context *context, const int part_size)
+{
+    memset(&context->memory->chain, 0, sizeof(context->memory->chain));
+    context->memory->chain.part_size = part_size;
+}
+
+int shm_chain_alloc(struct shmcache_context *context,
+        const struct shmcache_value_info *value, struct shm_chain_ref *ref)
+{
+    const char *data;
+    int remain;
+    int length;
+    int64_t offset;
+    int64_t previous_offset;
+    struct shm_hash_entry *part;
+    struct shm_hash_entry *previous;
+    bool recycled;
+
+    memset(ref, 0, sizeof(*ref));
+    ref->length = value->length;
+    ref->stamp = ++context->memory->hashtable.version;
+    context->memory->chain.count++;
+
+    previous = NULL;
+    previous_offset = 0;
+    data = value->data;
+    remain = value->length;
+    while (remain > 0) {
+        length = remain > context->memory->chain.part_size ?
+            context->memory->chain.part_size : remain;
+        //the allocator never recycles the parts allocated before
+        if ((part=shm_value_allocator_alloc(context,
+                        shm_value_allocator_entry_size(0, length),
+                        &offset)) == NULL)
+        {
+            recycled = false;
+            shm_chain_release(context, ref, &recycled);
+            return ENOMEM;
+        }
+
+        memset(&part->list, 0, sizeof(part->list));
+        part->ht_next = 0;
+        part->expires = 0;
+        part->version = ref->stamp;
+        part->value.length = length;
+        part->value.options = 0;
+        part->key_len = 0;
+        part->ns = 0;
+        part->flags = 0;
+        part->generation = 0;
+        memcpy(shm_get_value_ptr(context, part), data, length);
+        shm_checkpoint_mark_entry(context, offset);
+
+        if (previous == NULL) {
+            ref->first_offset = offset;
+        } else {
+            previous->ht_next = offset;
+            shm_checkpoint_mark_entry(context, previous_offset);
+        }
+        previous = part;
+        previous_offset = offset;
+
+        ref->count++;
+        ref->size += part->size;
+        context->memory->chain.parts++;
+        context->memory->chain.bytes += length;
+        context->memory->usage.used.value += length;
+        data += length;
+        remain -= length;
+    }
+
+    return 0;
+}
+
+void shm_chain_release(struct shmcache_context *context,
+        const struct shm_chain_ref *ref, bool *recycled)
+{
+    int64_t offset;
+    int64_t next_offset;
+    struct shm_hash_entry *part;
+    int i;
+
+    offset = ref->first_offset;
+    for (i=0; i<ref->count; i++) {
+        if (offset == 0 || (part=shm_get_hentry_ptr(context,
+                        offset)) == NULL)
+        {
+            logError("file: "__FILE__", line: %d, "
+                    "the part #%d of %d not exist, offset: %"PRId64,
+                    __LINE__, i, ref->count, offset);
+            break;
+        }
+
+        next_offset = part->ht_next;
+        context->memory->chain.parts--;
+        context->memory->chain.bytes -= part->value.length;
+        context->memory->usage.used.value -= part->value.length;
+        shm_value_allocator_free(context, part, offset, recycled);
+        part->ht_next = 0;
+        shm_checkpoint_mark_entry(context, offset);
+        offset = next_offset;
+    }
+    context->memory->chain.count--;
+}
+
+int shm_chain_copy(struct shmcache_context *context,
+        const struct shm_chain_ref *ref, char *buff, const int size)
+{
+    int64_t offset;
+    int64_t stamp;
+    int count;
+    int length;
+    int remain;
+    int part_len;
+    struct shm_hash_entry *part;
+    char *p;
+
+    offset = ref->first_offset;
+    count = ref->count;
+    length = ref->length;
+    stamp = ref->stamp;
+    if (count <= 0 || length <= 0 || length > size) {
+        return -EINVAL;
+    }
+
+    p = buff;
+    remain = length;
+    while (count-- > 0) {
+        //the part must be in the segment, the offset maybe garbage
+        if (offset == 0 || shm_get_hentry_segment(offset) < 0 ||
+                shm_get_hentry_segment_offset(offset) +
+                sizeof(struct shm_hash_entry) > context->memory->
+                vm_info.segment.size || (part=shm_get_hentry_ptr(
+                        context, offset)) == NULL)
+        {
+            return -ENOENT;
+        }
+
+        part_len = part->value.length;
+        if (part->version != stamp || part->key_len != 0 || part_len <= 0 ||
+                part_len > remain || part_len > context->memory->
+                chain.part_size || shm_get_hentry_segment_offset(offset) +
+                shm_value_allocator_entry_size(0, part_len) > context->
+                memory->vm_info.segment.size)
+        {
+            return -ENOENT;
+        }
+        offset = part->ht_next;
+        memcpy(p, shm_get_value_ptr(context, part), part_len);
+        __sync_synchronize();
+        if (part->version != stamp) {
+            return -ENOENT;   //freed and reused while copying
+        }
+        p += part_len;
+        remain -= part_len;
+    }
+
+    return remain == 0 ? length : -ENOENT;
+}
+
+static void shm_chain_free_buffer(void *arg)
+{
+    struct shm_chain_buffer *buffer;
+
+    buffer = (struct shm_chain_buffer *)arg;
+    free(buffer->buff);
+    free(buffer);
+}
+
+static void shm_chain_create_key()
+{
+    shm_chain_key_result = pthread_key_create(&shm_chain_key,
+            shm_chain_free_buffer);
+}
+
+static char *shm_chain_get_buffer(const int size)
+{
+    struct shm_chain_buffer *buffer;
+    int alloc_size;
+    int result;
+
+    pthread_once(&shm_chain_once, shm_chain_create_key);
+    if (shm_chain_key_result != 0) {
+        logError("file: "__FILE__", line: %d, "
+                "pthread_key_create fail, errno: %d, error info: %s",
+                __LINE__, shm_chain_key_result,
+                STRERROR(shm_chain_key_result));
+        return NULL;
+    }
+
+    buffer = (struct shm_chain_buffer *)pthread_getspecific(shm_chain_key);
+    if (buffer == NULL) {
+        buffer = (struct shm_chain_buffer *)calloc(1, sizeof(*buffer));
+        if (buffer == NULL) {
+            logError("file: "__FILE__", line: %d, "
+                    "malloc %d bytes fail", __LINE__, (int)sizeof(*buffer));
+            return NULL;
+        }
+        if ((result=pthread_setspecific(shm_chain_key, buffer)) != 0) {
+            logError("file: "__FILE__", line: %d, "
+                    "pthread_setspecific fail, errno: %d, error info: %s",
+                    __LINE__, result, STRERROR(result));
+            free(buffer);
+            return NULL;
+        }
+    }
+
+    if (buffer->size >= size) {
+        return buffer->buff;
+    }
+
+    alloc_size = size > SHM_CHAIN_MIN_BUFFER_SIZE ?
+        size : SHM_CHAIN_MIN_BUFFER_SIZE;
+    free(buffer->buff);
+    if ((buffer->buff=(char *)malloc(alloc_size)) == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, alloc_size);
+        buffer->size = 0;
+        return NULL;
+    }
+    buffer->size = alloc_size;
+    return buffer->buff;
+}
+
+int shm_chain_assemble(struct shmcache_context *context,
+        struct shmcache_value_info *value)
+{
+    struct shm_chain_ref ref;
+    char *buff;
+    int length;
+
+    if (value->length != sizeof(ref)) {
+        return ENOENT;
+    }
+    memcpy(&ref, value->data, sizeof(ref));
+    if (ref.length <= 0 || ref.length > context->config.max_value_size) {
+        return ENOENT;
+    }
+    if ((buff=shm_chain_get_buffer(ref.length)) == NULL) {
+        return ENOMEM;
+    }
+
+    if ((length=shm_chain_copy(context, &ref, buff, ref.length)) < 0) {
+        return ENOENT;
+    }
+    //the entry is overwritten or recycled while copying
+    __sync_synchronize();
+    if (((struct shm_chain_ref *)value->data)->stamp != ref.stamp) {
+        return ENOENT;
+    }
+
+    value->data = buff;
+    value->length = length;
+    value->options &= ~SHMCACHE_OPTIONS_CHAINED;
+    return 0;
+}
+
+void shm_chain_clear(struct shmcache_context *context)
+{
+    context->memory->chain.count = 0;
+    context->memory->chain.parts = 0;
+    context->memory->chain.bytes = 0;
+}
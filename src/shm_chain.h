@@ -0,0 +1,115 @@
+//shm_chain.h
+
+#ifndef _SHM_CHAIN_H
+#define _SHM_CHAIN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "common_define.h"
+#include "shmcache_types.h"
+#include "shm_value_allocator.h"
+
+//the min part size, the smaller one is raised to it
+#define SHM_CHAIN_MIN_PART_SIZE  (4 * 1024)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+chain init when the share memory created
+parameters:
+	context: the context pointer
+    part_size: the max value length of one part, 0 for disabled
+return none
+*/
+void shm_chain_init(struct shmcache_context *context, const int part_size);
+
+/**
+split the value to the parts and link them, the caller should hold the lock
+parameters:
+	context: the context pointer
+    value: the value to split
+    ref: return the ref to store as the value of the entry
+return error no, 0 for success
+*/
+int shm_chain_alloc(struct shmcache_context *context,
+        const struct shmcache_value_info *value, struct shm_chain_ref *ref);
+
+/**
+free the parts of the ref, the caller should hold the lock
+parameters:
+	context: the context pointer
+    ref: the ref of the parts
+    recycled: set to true when the striping of a part recycled
+return none
+*/
+void shm_chain_release(struct shmcache_context *context,
+        const struct shm_chain_ref *ref, bool *recycled);
+
+/**
+copy the parts to the buffer, the lock-free reader maybe see the parts
+freed by the writer, so the parts are checked by the stamp
+parameters:
+	context: the context pointer
+    ref: the ref of the parts
+    buff: the buffer to copy to
+    size: the buffer size
+return the value length, < 0 for the parts changed or invalid
+*/
+int shm_chain_copy(struct shmcache_context *context,
+        const struct shm_chain_ref *ref, char *buff, const int size);
+
+/**
+assemble the value filled from the entry with SHMCACHE_OPTIONS_CHAINED
+in place, the data is the buffer of the calling thread which is valid
+until the next get of this thread, lock-free
+parameters:
+	context: the context pointer
+    value: the value filled from the entry
+return error no, 0 for success, ENOENT for the parts changed
+*/
+int shm_chain_assemble(struct shmcache_context *context,
+        struct shmcache_value_info *value);
+
+/**
+reset the chain stats, the caller should hold the lock
+parameters:
+	context: the context pointer
+return none
+*/
+void shm_chain_clear(struct shmcache_context *context);
+
+//the part size limits the alloc size instead of max_value_size
+static inline int shm_chain_get_max_alloc_value_size(
+        struct shmcache_config *config)
+{
+    return config->chain.part_size > 0 ? config->chain.part_size :
+        config->max_value_size;
+}
+
+//if the value should be split, the hash and the sorted set are
+//modified in place, so never split
+static inline bool shm_chain_accept(struct shmcache_context *context,
+        const struct shmcache_value_info *value)
+{
+    return context->memory->chain.part_size > 0 &&
+        value->length > context->memory->chain.part_size &&
+        (value->options & (SHMCACHE_SERIALIZER_HASH |
+            SHMCACHE_SERIALIZER_ZSET | SHMCACHE_OPTIONS_DEDUP |
+            SHMCACHE_OPTIONS_CHAINED)) == 0;
+}
+
+static inline struct shm_chain_ref *shm_chain_get_ref(
+        struct shmcache_context *context, struct shm_hash_entry *entry)
+{
+    return (struct shm_chain_ref *)shm_get_value_ptr(context, entry);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
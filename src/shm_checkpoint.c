@@ -0,0 +1,177 @@
+//shm_checkpoint.c
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "logger.h"
+#include "shared_func.h"
+#include "sched_thread.h"
+#include "system_info.h"
+#include "shmopt.h"
+#include "shm_lock.h"
+#include "shm_hashtable.h"
+#include "shm_checkpoint.h"
+
+//the boot time calculated by uptime may be jittery
+#define SHM_CHECKPOINT_BOOT_TIME_JITTER  5
+
+static int shm_checkpoint_msync(void *addr, const int64_t size,
+        const char *label, const int index)
+{
+    int result;
+
+    if (msync(addr, size, MS_SYNC) != 0) {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "msync %s #%d, addr: %p, size: %"PRId64" fail, "
+                "errno: %d, error info: %s", __LINE__, label, index,
+                addr, size, result, strerror(result));
+        return result;
+    }
+    return 0;
+}
+
+//the struct shm_memory_info is in the first page
+#define SHM_CHECKPOINT_SYNC_HEADER(context) \
+    shm_checkpoint_msync(context->segments.hashtable.base, \
+            getpagesize(), "header", 0)
+
+static int shm_checkpoint_get_boot_time(int64_t *boot_time)
+{
+    int result;
+    struct timeval tv;
+
+    if ((result=get_boot_time(&tv)) != 0) {
+        return result;
+    }
+    *boot_time = tv.tv_sec;
+    return 0;
+}
+
+int shm_checkpoint_init(struct shmcache_context *context)
+{
+    int result;
+    int64_t boot_time;
+
+    memset(&context->memory->checkpoint, 0,
+            sizeof(context->memory->checkpoint));
+    if (!context->config.checkpoint.enabled) {
+        return 0;
+    }
+
+    if ((result=shm_checkpoint_get_boot_time(&boot_time)) != 0) {
+        return result;
+    }
+    context->memory->checkpoint.boot_time = boot_time;
+    context->memory->checkpoint.epoch = 1;
+    context->memory->checkpoint.dirty = 1;
+    context->memory->checkpoint.enabled = 1;
+    return 0;
+}
+
+int shm_checkpoint_recover(struct shmcache_context *context)
+{
+    int result;
+    int64_t boot_time;
+
+    if ((result=shm_checkpoint_get_boot_time(&boot_time)) != 0) {
+        return result;
+    }
+    if (llabs(boot_time - context->memory->checkpoint.boot_time) <=
+            SHM_CHECKPOINT_BOOT_TIME_JITTER)
+    {
+        return 0;
+    }
+
+    if ((result=shm_lock_file(context)) != 0) {
+        return result;
+    }
+
+    do {
+        if (llabs(boot_time - context->memory->checkpoint.boot_time) <=
+                SHM_CHECKPOINT_BOOT_TIME_JITTER)
+        {
+            break;
+        }
+
+        //the mutex maybe locked by the process before reboot
+        if ((result=shm_lock_init(context)) != 0) {
+            break;
+        }
+
+        if (context->memory->checkpoint.dirty) {
+            logWarning("file: "__FILE__", line: %d, pid: %d, "
+                    "modified after the last checkpoint epoch: %"PRId64
+                    ", the files maybe inconsistent, clear hashtable",
+                    __LINE__, context->pid,
+                    context->memory->checkpoint.epoch);
+            shm_ht_clear(context);
+        } else {
+            logInfo("file: "__FILE__", line: %d, pid: %d, "
+                    "reuse the files of checkpoint epoch: %"PRId64", "
+                    "hashtable entries: %d", __LINE__, context->pid,
+                    context->memory->checkpoint.epoch,
+                    context->memory->hashtable.count);
+        }
+        context->memory->checkpoint.boot_time = boot_time;
+    } while (0);
+
+    shm_unlock_file(context);
+    return result;
+}
+
+int shm_checkpoint_set_dirty(struct shmcache_context *context)
+{
+    //the dirty flag must reach the file before any modification
+    context->memory->checkpoint.dirty = 1;
+    return SHM_CHECKPOINT_SYNC_HEADER(context);
+}
+
+int shm_checkpoint(struct shmcache_context *context, int *striping_count)
+{
+    int result;
+    char *base;
+    struct shm_striping_allocator *allocator;
+    struct shm_striping_allocator *end;
+
+    *striping_count = 0;
+    if (!context->memory->checkpoint.enabled) {
+        logError("file: "__FILE__", line: %d, "
+                "checkpoint is not enabled", __LINE__);
+        return EOPNOTSUPP;
+    }
+
+    end = context->value_allocator.allocators +
+        context->memory->vm_info.striping.count.current;
+    for (allocator=context->value_allocator.allocators;
+            allocator<end; allocator++)
+    {
+        if (allocator->epoch != context->memory->checkpoint.epoch) {
+            continue;
+        }
+
+        base = shmopt_get_value_segment(context, allocator->index.segment);
+        if (base == NULL) {
+            return ENOENT;
+        }
+        if ((result=shm_checkpoint_msync(base + allocator->offset.base,
+                        allocator->size.total, "striping",
+                        allocator->index.striping)) != 0)
+        {
+            return result;
+        }
+        (*striping_count)++;
+    }
+
+    if ((result=shm_checkpoint_msync(context->segments.hashtable.base,
+                    context->segments.hashtable.size, "hashtable", 0)) != 0)
+    {
+        return result;
+    }
+
+    //all data are persisted, then clear the dirty flag
+    context->memory->checkpoint.epoch++;
+    context->memory->checkpoint.last_time = get_current_time();
+    context->memory->checkpoint.dirty = 0;
+    return SHM_CHECKPOINT_SYNC_HEADER(context);
+}
@@ -0,0 +1,86 @@
+//shm_checkpoint.h
+
+#ifndef _SHM_CHECKPOINT_H
+#define _SHM_CHECKPOINT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "common_define.h"
+#include "shmcache_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+init the checkpoint info when the share memory created
+parameters:
+	context: the context pointer
+return error no, 0 for success, != 0 for fail
+*/
+int shm_checkpoint_init(struct shmcache_context *context);
+
+/**
+validate the checkpoint when the share memory attached first time
+after the host reboot, the hashtable is cleared when the last
+checkpoint is not consistent
+parameters:
+	context: the context pointer
+return error no, 0 for success, != 0 for fail
+*/
+int shm_checkpoint_recover(struct shmcache_context *context);
+
+/**
+set the dirty flag and sync it to the file, the caller should hold the lock
+parameters:
+	context: the context pointer
+return error no, 0 for success, != 0 for fail
+*/
+int shm_checkpoint_set_dirty(struct shmcache_context *context);
+
+/**
+sync the hashtable segment and the dirty stripings to the files,
+the caller should hold the lock
+parameters:
+	context: the context pointer
+    striping_count: return the synced striping count
+return error no, 0 for success, != 0 for fail
+*/
+int shm_checkpoint(struct shmcache_context *context, int *striping_count);
+
+//call before modify the share memory
+static inline void shm_checkpoint_before_write(struct shmcache_context *context)
+{
+    if (context->memory->checkpoint.enabled &&
+            !context->memory->checkpoint.dirty)
+    {
+        shm_checkpoint_set_dirty(context);
+    }
+}
+
+//mark the striping modified in the current epoch
+static inline void shm_checkpoint_mark_striping(
+        struct shmcache_context *context, const int striping_index)
+{
+    if (context->memory->checkpoint.enabled) {
+        context->value_allocator.allocators[striping_index].epoch =
+            context->memory->checkpoint.epoch;
+    }
+}
+
+//mark the striping of the entry by the entry offset
+#define shm_checkpoint_mark_entry(context, entry_offset) \
+    do { \
+        if ((context)->memory->checkpoint.enabled) { \
+            shm_checkpoint_mark_striping(context, \
+                    shm_get_hentry_striping(context, entry_offset)); \
+        } \
+    } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
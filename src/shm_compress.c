@@ -0,0 +1,418 @@
+//shm_compress.c
+
+#include <errno.h>
+#include "logger.h"
+#include "shared_func.h"
+#include "shm_compress.h"
+
+//the LZ4 block format: the sequences of the token, the literals and the
+//match (offset + length), the last sequence has the literals only
+#define SHM_LZ4_MIN_MATCH       4
+#define SHM_LZ4_LAST_LITERALS   5   //the last bytes are always literals
+#define SHM_LZ4_MF_LIMIT       12   //no match starts in the last bytes
+#define SHM_LZ4_MAX_DISTANCE   65535
+#define SHM_LZ4_HASH_LOG       12
+#define SHM_LZ4_SKIP_TRIGGER    6   //step faster on the incompressible data
+#define SHM_LZ4_RUN_MASK       15
+
+#define SHM_LZ4_HASH(seq) (((seq) * 2654435761U) >> (32 - SHM_LZ4_HASH_LOG))
+
+#define SHM_COMPRESS_MIN_BUFFER_SIZE  (4 * 1024)
+
+struct shm_compress_buffer {
+    char *buff;
+    int size;
+};
+
+//the buffers of one thread
+struct shm_compress_buffers {
+    struct shm_compress_buffer compress;
+    struct shm_compress_buffer uncompress;
+};
+
+static pthread_key_t shm_compress_key;
+static pthread_once_t shm_compress_once = PTHREAD_ONCE_INIT;
+static int shm_compress_key_result = 0;
+
+static inline uint32_t shm_lz4_read32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline unsigned char *shm_lz4_write_length(unsigned char *op,
+        int length)
+{
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = length;
+    return op;
+}
+
+//the max bytes of one sequence
+#define SHM_LZ4_SEQUENCE_SIZE(literals, match_len) \
+    (1 + (literals) + (literals) / 255 + 1 + 2 + (match_len) / 255 + 1)
+
+int shm_compress_block(const char *src, const int length,
+        char *dest, const int capacity)
+{
+    int table[1 << SHM_LZ4_HASH_LOG];
+    const unsigned char *base;
+    const unsigned char *ip;
+    const unsigned char *anchor;
+    const unsigned char *ref;
+    const unsigned char *end;
+    const unsigned char *mflimit;
+    const unsigned char *match_limit;
+    unsigned char *op;
+    unsigned char *oend;
+    unsigned char *token;
+    uint32_t seq;
+    uint32_t h;
+    int search;
+    int literals;
+    int match_len;
+
+    base = (const unsigned char *)src;
+    ip = anchor = base;
+    end = base + length;
+    op = (unsigned char *)dest;
+    oend = op + capacity;
+    if (length > SHM_LZ4_MF_LIMIT) {
+        mflimit = end - SHM_LZ4_MF_LIMIT;
+        match_limit = end - SHM_LZ4_LAST_LITERALS;
+        memset(table, 0, sizeof(table));
+        search = 1 << SHM_LZ4_SKIP_TRIGGER;
+        ip++;
+        while (ip < mflimit) {
+            seq = shm_lz4_read32(ip);
+            h = SHM_LZ4_HASH(seq);
+            ref = base + table[h];
+            table[h] = ip - base;
+            if (ip - ref > SHM_LZ4_MAX_DISTANCE ||
+                    shm_lz4_read32(ref) != seq)
+            {
+                ip += search++ >> SHM_LZ4_SKIP_TRIGGER;
+                continue;
+            }
+            search = 1 << SHM_LZ4_SKIP_TRIGGER;
+
+            while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            match_len = SHM_LZ4_MIN_MATCH;
+            while (ip + match_len < match_limit &&
+                    ip[match_len] == ref[match_len])
+            {
+                match_len++;
+            }
+
+            literals = ip - anchor;
+            if (oend - op < SHM_LZ4_SEQUENCE_SIZE(literals, match_len)) {
+                return 0;
+            }
+            token = op++;
+            if (literals >= SHM_LZ4_RUN_MASK) {
+                *token = SHM_LZ4_RUN_MASK << 4;
+                op = shm_lz4_write_length(op, literals - SHM_LZ4_RUN_MASK);
+            } else {
+                *token = literals << 4;
+            }
+            memcpy(op, anchor, literals);
+            op += literals;
+
+            *op++ = (ip - ref) & 0xFF;
+            *op++ = (ip - ref) >> 8;
+            match_len -= SHM_LZ4_MIN_MATCH;
+            if (match_len >= SHM_LZ4_RUN_MASK) {
+                *token |= SHM_LZ4_RUN_MASK;
+                op = shm_lz4_write_length(op, match_len - SHM_LZ4_RUN_MASK);
+            } else {
+                *token |= match_len;
+            }
+
+            ip += match_len + SHM_LZ4_MIN_MATCH;
+            anchor = ip;
+            if (ip < mflimit) {
+                table[SHM_LZ4_HASH(shm_lz4_read32(ip - 2))] = ip - 2 - base;
+            }
+        }
+    }
+
+    literals = end - anchor;
+    if (oend - op < SHM_LZ4_SEQUENCE_SIZE(literals, 0)) {
+        return 0;
+    }
+    token = op++;
+    if (literals >= SHM_LZ4_RUN_MASK) {
+        *token = SHM_LZ4_RUN_MASK << 4;
+        op = shm_lz4_write_length(op, literals - SHM_LZ4_RUN_MASK);
+    } else {
+        *token = literals << 4;
+    }
+    memcpy(op, anchor, literals);
+    op += literals;
+    return op - (unsigned char *)dest;
+}
+
+//read the extra length bytes, return -1 for overflow the limit
+static inline int shm_lz4_read_length(const unsigned char **ip,
+        const unsigned char *iend, int length, const int limit)
+{
+    int b;
+
+    do {
+        if (*ip >= iend) {
+            return -1;
+        }
+        b = *(*ip)++;
+        length += b;
+        if (length > limit) {
+            return -1;
+        }
+    } while (b == 255);
+    return length;
+}
+
+int shm_uncompress_block(const char *src, const int length,
+        char *dest, const int capacity)
+{
+    const unsigned char *ip;
+    const unsigned char *iend;
+    unsigned char *op;
+    unsigned char *oend;
+    unsigned char *ref;
+    int token;
+    int literals;
+    int match_len;
+    int offset;
+
+    ip = (const unsigned char *)src;
+    iend = ip + length;
+    op = (unsigned char *)dest;
+    oend = op + capacity;
+    while (ip < iend) {
+        token = *ip++;
+        literals = token >> 4;
+        if (literals == SHM_LZ4_RUN_MASK && (literals=shm_lz4_read_length(
+                        &ip, iend, literals, capacity)) < 0)
+        {
+            return -1;
+        }
+        if (literals > iend - ip || literals > oend - op) {
+            return -1;
+        }
+        memcpy(op, ip, literals);
+        op += literals;
+        ip += literals;
+        if (ip == iend) {   //the last sequence
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return -1;
+        }
+        offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op - (unsigned char *)dest) {
+            return -1;
+        }
+        match_len = token & SHM_LZ4_RUN_MASK;
+        if (match_len == SHM_LZ4_RUN_MASK && (match_len=shm_lz4_read_length(
+                        &ip, iend, match_len, capacity)) < 0)
+        {
+            return -1;
+        }
+        match_len += SHM_LZ4_MIN_MATCH;
+        if (match_len > oend - op) {
+            return -1;
+        }
+
+        ref = op - offset;
+        if (offset >= match_len) {
+            memcpy(op, ref, match_len);
+            op += match_len;
+        } else {   //overlapped, repeat the pattern
+            while (match_len-- > 0) {
+                *op++ = *ref++;
+            }
+        }
+    }
+
+    return op - (unsigned char *)dest;
+}
+
+static void shm_compress_free_buffers(void *arg)
+{
+    struct shm_compress_buffers *buffers;
+
+    buffers = (struct shm_compress_buffers *)arg;
+    free(buffers->compress.buff);
+    free(buffers->uncompress.buff);
+    free(buffers);
+}
+
+static void shm_compress_create_key()
+{
+    shm_compress_key_result = pthread_key_create(&shm_compress_key,
+            shm_compress_free_buffers);
+}
+
+static struct shm_compress_buffers *shm_compress_get_buffers()
+{
+    struct shm_compress_buffers *buffers;
+    int result;
+
+    pthread_once(&shm_compress_once, shm_compress_create_key);
+    if (shm_compress_key_result != 0) {
+        logError("file: "__FILE__", line: %d, "
+                "pthread_key_create fail, errno: %d, error info: %s",
+                __LINE__, shm_compress_key_result,
+                STRERROR(shm_compress_key_result));
+        return NULL;
+    }
+
+    buffers = (struct shm_compress_buffers *)pthread_getspecific(
+            shm_compress_key);
+    if (buffers != NULL) {
+        return buffers;
+    }
+
+    buffers = (struct shm_compress_buffers *)calloc(1, sizeof(*buffers));
+    if (buffers == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, (int)sizeof(*buffers));
+        return NULL;
+    }
+    if ((result=pthread_setspecific(shm_compress_key, buffers)) != 0) {
+        logError("file: "__FILE__", line: %d, "
+                "pthread_setspecific fail, errno: %d, error info: %s",
+                __LINE__, result, STRERROR(result));
+        free(buffers);
+        return NULL;
+    }
+    return buffers;
+}
+
+static char *shm_compress_check_buffer(struct shm_compress_buffer *buffer,
+        const int size)
+{
+    int alloc_size;
+
+    if (buffer->size >= size) {
+        return buffer->buff;
+    }
+
+    alloc_size = size > SHM_COMPRESS_MIN_BUFFER_SIZE ?
+        size : SHM_COMPRESS_MIN_BUFFER_SIZE;
+    free(buffer->buff);
+    if ((buffer->buff=(char *)malloc(alloc_size)) == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, alloc_size);
+        buffer->size = 0;
+        return NULL;
+    }
+    buffer->size = alloc_size;
+    return buffer->buff;
+}
+
+int shm_compress_value(struct shmcache_context *context,
+        const struct shmcache_value_info *value,
+        struct shmcache_value_info *stored)
+{
+    struct shm_compress_buffers *buffers;
+    char *buff;
+    int capacity;
+    int length;
+
+    *stored = *value;
+    if (context->config.compress.threshold <= 0 ||
+            value->length < context->config.compress.threshold ||
+            value->length > context->config.max_value_size ||
+            (value->options & (SHMCACHE_SERIALIZER_HASH |
+                SHMCACHE_SERIALIZER_ZSET | SHMCACHE_OPTIONS_COMPRESSED)) != 0)
+    {
+        return 0;
+    }
+
+    if ((buffers=shm_compress_get_buffers()) == NULL) {
+        return ENOMEM;
+    }
+    if ((buff=shm_compress_check_buffer(&buffers->compress,
+                    value->length)) == NULL)
+    {
+        return ENOMEM;
+    }
+
+    capacity = value->length - value->length / 8 - SHM_COMPRESS_HEADER_SIZE;
+    length = capacity > 0 ? shm_compress_block(value->data, value->length,
+            buff + SHM_COMPRESS_HEADER_SIZE, capacity) : 0;
+    if (length <= 0) {
+        __sync_add_and_fetch(&context->memory->stats.
+                hashtable.compress.skip, 1);
+        return 0;
+    }
+
+    memcpy(buff, &value->length, SHM_COMPRESS_HEADER_SIZE);
+    stored->data = buff;
+    stored->length = SHM_COMPRESS_HEADER_SIZE + length;
+    stored->options = value->options | SHMCACHE_OPTIONS_COMPRESSED;
+    __sync_add_and_fetch(&context->memory->stats.hashtable.compress.total, 1);
+    __sync_add_and_fetch(&context->memory->stats.hashtable.
+            compress.raw_bytes, value->length);
+    __sync_add_and_fetch(&context->memory->stats.hashtable.
+            compress.stored_bytes, stored->length);
+    return 0;
+}
+
+int shm_uncompress_value(struct shmcache_context *context,
+        struct shmcache_value_info *value)
+{
+    struct shm_compress_buffers *buffers;
+    char *buff;
+    int length;
+
+    if ((value->options & SHMCACHE_OPTIONS_COMPRESSED) == 0) {
+        return 0;
+    }
+
+    length = 0;
+    if (value->length >= SHM_COMPRESS_HEADER_SIZE) {
+        memcpy(&length, value->data, SHM_COMPRESS_HEADER_SIZE);
+    }
+    if (length <= 0 || length > context->config.max_value_size) {
+        __sync_add_and_fetch(&context->memory->stats.
+                hashtable.compress.fail, 1);
+        return EBADMSG;
+    }
+
+    if ((buffers=shm_compress_get_buffers()) == NULL) {
+        return ENOMEM;
+    }
+    if ((buff=shm_compress_check_buffer(&buffers->uncompress,
+                    length)) == NULL)
+    {
+        return ENOMEM;
+    }
+
+    //the lock-free reader maybe see the value overwritten by the writer
+    if (shm_uncompress_block(value->data + SHM_COMPRESS_HEADER_SIZE,
+                value->length - SHM_COMPRESS_HEADER_SIZE,
+                buff, length) != length)
+    {
+        __sync_add_and_fetch(&context->memory->stats.
+                hashtable.compress.fail, 1);
+        return EBADMSG;
+    }
+
+    value->data = buff;
+    value->length = length;
+    value->options &= ~SHMCACHE_OPTIONS_COMPRESSED;
+    __sync_add_and_fetch(&context->memory->stats.
+            hashtable.compress.uncompress, 1);
+    return 0;
+}
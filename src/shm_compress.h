@@ -0,0 +1,77 @@
+//shm_compress.h
+
+#ifndef _SHM_COMPRESS_H
+#define _SHM_COMPRESS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "common_define.h"
+#include "shmcache_types.h"
+
+//the stored value: the original length + the LZ4 block
+#define SHM_COMPRESS_HEADER_SIZE  ((int)sizeof(int))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+compress the data to the LZ4 block format
+parameters:
+	src: the data to compress
+    length: the data length
+    dest: the buffer to store the compressed data
+    capacity: the buffer size
+return the compressed length, 0 for the buffer is too small
+*/
+int shm_compress_block(const char *src, const int length,
+        char *dest, const int capacity);
+
+/**
+uncompress the LZ4 block, never read or write out of the bounds
+parameters:
+	src: the compressed data
+    length: the compressed length
+    dest: the buffer to store the original data
+    capacity: the buffer size
+return the original length, < 0 for the corrupted data
+*/
+int shm_uncompress_block(const char *src, const int length,
+        char *dest, const int capacity);
+
+/**
+compress the value when the length >= compress.threshold of the config,
+the value is stored raw when the compressed one saves less than 1/8.
+the share memory is not touched, so it is called before the lock by set
+to keep the critical section short, and under the lock by the range
+write of the compressed value
+parameters:
+	context: the context pointer
+    value: the value to set
+    stored: return the value to store, the data is the buffer of the
+            calling thread when compressed, otherwise the same as value
+return error no, 0 for success
+*/
+int shm_compress_value(struct shmcache_context *context,
+        const struct shmcache_value_info *value,
+        struct shmcache_value_info *stored);
+
+/**
+uncompress the value returned by get in place when the options has
+SHMCACHE_OPTIONS_COMPRESSED, the data is the buffer of the calling thread
+which is valid until the next get of this thread
+parameters:
+	context: the context pointer
+    value: the value returned by get
+return error no, 0 for success, EBADMSG for the corrupted data
+*/
+int shm_uncompress_value(struct shmcache_context *context,
+        struct shmcache_value_info *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,175 @@
+//shm_dedup.c
+
+#include <errno.h>
+#include "logger.h"
+#include "shared_func.h"
+#include "hash.h"
+#include "shm_hashtable.h"
+#include "shm_checkpoint.h"
+#include "shm_dedup.h"
+
+#define SHM_DEDUP_BUCKETS(context) ((uint32_t *)(context->segments. \
+            hashtable.base + context->memory->dedup.base_offset))
+
+//the blob count is far less than the key count for the shared values
+#define SHM_DEDUP_KEYS_PER_BUCKET  4
+
+int shm_dedup_get_capacity(struct shmcache_config *config)
+{
+    if (config->dedup.threshold <= 0) {
+        return 0;
+    }
+    return shm_ht_get_capacity(config->max_key_count /
+            SHM_DEDUP_KEYS_PER_BUCKET + 1);
+}
+
+void shm_dedup_init(struct shmcache_context *context, const int capacity,
+        const int64_t base_offset)
+{
+    memset(&context->memory->dedup, 0, sizeof(context->memory->dedup));
+    if (capacity == 0) {
+        return;
+    }
+
+    context->memory->dedup.capacity = capacity;
+    context->memory->dedup.base_offset = base_offset;
+    shm_dedup_clear(context);
+}
+
+static inline struct shm_dedup_blob *shm_dedup_get_blob(
+        struct shmcache_context *context, struct shm_hash_entry *entry)
+{
+    return (struct shm_dedup_blob *)shm_get_value_ptr(context, entry);
+}
+
+int shm_dedup_acquire(struct shmcache_context *context,
+        const struct shmcache_value_info *value, struct shm_dedup_ref *ref)
+{
+    uint32_t *bucket;
+    unsigned int hash_code;
+    int64_t offset;
+    struct shm_hash_entry *entry;
+    struct shm_dedup_blob *blob;
+
+    hash_code = (unsigned int)wyhash(value->data, value->length);
+    bucket = SHM_DEDUP_BUCKETS(context) + hash_code %
+        context->memory->dedup.capacity;
+    offset = *bucket;
+    while (offset > 0) {
+        entry = shm_get_hentry_ptr(context, offset);
+        blob = shm_dedup_get_blob(context, entry);
+        if (blob->hash_code == hash_code && entry->value.length ==
+                value->length && memcmp(blob->data, value->data,
+                    value->length) == 0)
+        {
+            blob->refcount++;
+            shm_checkpoint_mark_entry(context, offset);
+            context->memory->dedup.refs++;
+            context->memory->dedup.saved += value->length;
+            context->memory->dedup.stats.hit++;
+            ref->blob_offset = offset;
+            ref->length = value->length;
+            return 0;
+        }
+        offset = entry->ht_next;
+    }
+
+    //the allocator may recycle the other blobs of the bucket
+    if ((entry=shm_value_allocator_alloc(context, shm_value_allocator_entry_size(
+                        0, sizeof(struct shm_dedup_blob) + value->length),
+                    &offset)) == NULL)
+    {
+        return ENOMEM;
+    }
+
+    memset(&entry->list, 0, sizeof(entry->list));
+    entry->expires = 0;
+    entry->version = 0;
+    entry->value.length = value->length;
+    entry->value.options = 0;
+    entry->key_len = 0;
+    entry->ns = 0;
+    entry->flags = 0;
+    entry->generation = 0;
+    blob = shm_dedup_get_blob(context, entry);
+    blob->hash_code = hash_code;
+    blob->refcount = 1;
+    memcpy(blob->data, value->data, value->length);
+
+    entry->ht_next = *bucket;
+    *bucket = offset;
+    shm_checkpoint_mark_entry(context, offset);
+    context->memory->dedup.count++;
+    context->memory->dedup.refs++;
+    context->memory->dedup.bytes += value->length;
+    context->memory->usage.used.value += value->length;
+
+    ref->blob_offset = offset;
+    ref->length = value->length;
+    return 0;
+}
+
+void shm_dedup_release(struct shmcache_context *context,
+        const int64_t blob_offset, bool *recycled)
+{
+    uint32_t *bucket;
+    int64_t offset;
+    int64_t previous_offset;
+    struct shm_hash_entry *entry;
+    struct shm_hash_entry *previous;
+    struct shm_dedup_blob *blob;
+
+    if ((entry=shm_get_hentry_ptr(context, blob_offset)) == NULL) {
+        return;
+    }
+
+    blob = shm_dedup_get_blob(context, entry);
+    context->memory->dedup.refs--;
+    if (--blob->refcount > 0) {
+        context->memory->dedup.saved -= entry->value.length;
+        shm_checkpoint_mark_entry(context, blob_offset);
+        return;
+    }
+
+    bucket = SHM_DEDUP_BUCKETS(context) + blob->hash_code %
+        context->memory->dedup.capacity;
+    previous = NULL;
+    previous_offset = 0;
+    offset = *bucket;
+    while (offset > 0 && offset != blob_offset) {
+        previous_offset = offset;
+        previous = shm_get_hentry_ptr(context, offset);
+        offset = previous->ht_next;
+    }
+    if (offset == 0) {
+        logError("file: "__FILE__", line: %d, "
+                "the blob offset: %"PRId64" not in the bucket, "
+                "hash code: %u", __LINE__, blob_offset, blob->hash_code);
+    } else if (previous == NULL) {
+        *bucket = entry->ht_next;
+    } else {
+        previous->ht_next = entry->ht_next;
+        shm_checkpoint_mark_entry(context, previous_offset);
+    }
+
+    context->memory->dedup.count--;
+    context->memory->dedup.bytes -= entry->value.length;
+    context->memory->usage.used.value -= entry->value.length;
+    shm_value_allocator_free(context, entry, blob_offset, recycled);
+    entry->ht_next = 0;
+    shm_checkpoint_mark_entry(context, blob_offset);
+}
+
+void shm_dedup_clear(struct shmcache_context *context)
+{
+    if (context->memory->dedup.capacity == 0) {
+        return;
+    }
+
+    memset(SHM_DEDUP_BUCKETS(context), 0, sizeof(uint32_t) *
+            context->memory->dedup.capacity);
+    context->memory->dedup.count = 0;
+    context->memory->dedup.refs = 0;
+    context->memory->dedup.bytes = 0;
+    context->memory->dedup.saved = 0;
+}
@@ -0,0 +1,171 @@
+//shm_dedup.h
+
+#ifndef _SHM_DEDUP_H
+#define _SHM_DEDUP_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "common_define.h"
+#include "shmcache_types.h"
+#include "shm_value_allocator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+get the bucket count of the blobs by the config
+parameters:
+	config: the config
+return the bucket count, 0 for disabled
+*/
+int shm_dedup_get_capacity(struct shmcache_config *config);
+
+/**
+dedup init when the share memory created
+parameters:
+	context: the context pointer
+    capacity: the bucket count, 0 for disabled
+    base_offset: the offset of the buckets in the hashtable segment
+return none
+*/
+void shm_dedup_init(struct shmcache_context *context, const int capacity,
+        const int64_t base_offset);
+
+/**
+find the blob of the same value or create it, the refcount of the blob
+is increased, so it is kept when the value allocator recycles before the
+entry linked. the caller should hold the lock
+parameters:
+	context: the context pointer
+    value: the value to share
+    ref: return the ref to store as the value of the entry
+return error no, 0 for success
+*/
+int shm_dedup_acquire(struct shmcache_context *context,
+        const struct shmcache_value_info *value, struct shm_dedup_ref *ref);
+
+/**
+decrease the refcount of the blob, free it when the last ref released.
+the caller should hold the lock
+parameters:
+	context: the context pointer
+    blob_offset: the entry offset of the blob
+    recycled: set to true when the striping of the blob recycled
+return none
+*/
+void shm_dedup_release(struct shmcache_context *context,
+        const int64_t blob_offset, bool *recycled);
+
+/**
+reset all buckets, the caller should hold the lock
+parameters:
+	context: the context pointer
+return none
+*/
+void shm_dedup_clear(struct shmcache_context *context);
+
+//the bucket stores the 32 bits blob offset
+static inline int64_t shm_dedup_get_memory_size(const int capacity)
+{
+    return MEM_ALIGN(sizeof(uint32_t) * (int64_t)capacity);
+}
+
+//if the value should be shared, the hash and the sorted set are
+//modified in place, so never shared. the blob is one entry, so the
+//value longer than the part size is chained instead
+static inline bool shm_dedup_accept(struct shmcache_context *context,
+        const struct shmcache_value_info *value)
+{
+    return context->memory->dedup.capacity > 0 &&
+        context->config.dedup.threshold > 0 &&
+        value->length >= context->config.dedup.threshold &&
+        (context->memory->chain.part_size == 0 ||
+         value->length <= context->memory->chain.part_size) &&
+        (value->options & (SHMCACHE_SERIALIZER_HASH |
+            SHMCACHE_SERIALIZER_ZSET | SHMCACHE_OPTIONS_DEDUP)) == 0;
+}
+
+//the blob of the ref, the ref maybe stale for the lock-free readers,
+//so check the blob offset in the segment before reading the blob
+static inline struct shm_hash_entry *shm_dedup_find_blob(
+        struct shmcache_context *context, const struct shm_dedup_ref *ref)
+{
+    int64_t segment_offset;
+    struct shm_hash_entry *blob;
+
+    if (ref->blob_offset == 0 || ref->length < 0 || ref->length >
+            context->memory->vm_info.segment.size ||
+            shm_get_hentry_segment(ref->blob_offset) < 0)
+    {
+        return NULL;
+    }
+    segment_offset = shm_get_hentry_segment_offset(ref->blob_offset);
+    if (segment_offset + shm_value_allocator_entry_size(0,
+                sizeof(struct shm_dedup_blob) + ref->length) >
+            context->memory->vm_info.segment.size)
+    {
+        return NULL;
+    }
+    if ((blob=shm_get_hentry_ptr(context, ref->blob_offset)) == NULL ||
+            blob->value.length != ref->length)
+    {
+        return NULL;
+    }
+    return blob;
+}
+
+//the value of the entry, include the shared one
+static inline char *shm_dedup_entry_value(struct shmcache_context *context,
+        struct shm_hash_entry *entry, int *length)
+{
+    struct shm_dedup_ref *ref;
+    struct shm_hash_entry *blob;
+
+    if ((entry->value.options & SHMCACHE_OPTIONS_DEDUP) == 0) {
+        *length = entry->value.length;
+        return shm_get_value_ptr(context, entry);
+    }
+
+    ref = (struct shm_dedup_ref *)shm_get_value_ptr(context, entry);
+    if ((blob=shm_dedup_find_blob(context, ref)) == NULL) {
+        *length = 0;
+        return NULL;
+    }
+    *length = ref->length;
+    return ((struct shm_dedup_blob *)shm_get_value_ptr(
+                context, blob))->data;
+}
+
+/**
+resolve the value filled from the entry with SHMCACHE_OPTIONS_DEDUP
+to the shared one, lock-free
+parameters:
+	context: the context pointer
+    value: the value filled from the entry
+return error no, 0 for success, ENOENT for the blob not exist
+*/
+static inline int shm_dedup_resolve(struct shmcache_context *context,
+        struct shmcache_value_info *value)
+{
+    struct shm_dedup_ref *ref;
+    struct shm_hash_entry *blob;
+
+    ref = (struct shm_dedup_ref *)value->data;
+    if ((blob=shm_dedup_find_blob(context, ref)) == NULL) {
+        return ENOENT;
+    }
+    value->data = ((struct shm_dedup_blob *)shm_get_value_ptr(
+                context, blob))->data;
+    value->length = ref->length;
+    value->options &= ~SHMCACHE_OPTIONS_DEDUP;
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,320 @@
+//shm_field.c
+
+#include <errno.h>
+#include "logger.h"
+#include "shared_func.h"
+#include "sched_thread.h"
+#include "shm_checkpoint.h"
+#include "shm_hashtable.h"
+#include "shmcache.h"
+#include "shm_field.h"
+
+//the records are appended in place, so stop at the incomplete one.
+//the updated field is appended before the old one deleted, so the
+//reader which sees the old length returns the deleted old one
+static struct shm_field *shm_field_find(char *data, const int length,
+        const struct shmcache_key_info *name)
+{
+    struct shm_field *field;
+    struct shm_field *deleted;
+    char *p;
+    char *end;
+    int size;
+
+    deleted = NULL;
+    p = data;
+    end = data + length;
+    while (end - p >= (int)sizeof(struct shm_field)) {
+        field = (struct shm_field *)p;
+        size = SHM_FIELD_RECORD_SIZE(field->name_len, field->capacity);
+        if (field->capacity < 0 || end - p < size) {
+            break;
+        }
+        if (field->name_len == name->length &&
+                memcmp(field->name, name->data, name->length) == 0)
+        {
+            if ((field->flags & SHM_FIELD_FLAG_DELETED) == 0) {
+                return field;
+            }
+            if (deleted == NULL) {
+                deleted = field;
+            }
+        }
+        p += size;
+    }
+
+    return deleted;
+}
+
+//build the field record to the buffer, return the record size
+static int shm_field_build(char *buff, const struct shmcache_key_info *name,
+        const char *data, const int length)
+{
+    struct shm_field *field;
+    int size;
+
+    size = SHM_FIELD_RECORD_SIZE(name->length, length);
+    field = (struct shm_field *)buff;
+    field->name_len = name->length;
+    field->flags = 0;
+    field->value_len = length;
+    field->capacity = size - sizeof(struct shm_field) - name->length;
+    memcpy(field->name, name->data, name->length);
+    memcpy(SHM_FIELD_VALUE_PTR(field), data, length);
+    memset(SHM_FIELD_VALUE_PTR(field) + length, 0, field->capacity - length);
+    return size;
+}
+
+int shm_field_get(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *name,
+        struct shmcache_value_info *value)
+{
+    int result;
+    int length;
+    struct shm_field *field;
+
+    if ((result=shm_ht_get(context, key, value)) != 0) {
+        return result;
+    }
+    if (value->options != SHMCACHE_SERIALIZER_HASH) {
+        return EINVAL;
+    }
+    if ((field=shm_field_find(value->data, value->length, name)) == NULL) {
+        return ENOENT;
+    }
+
+    length = field->value_len;
+    if (length < 0 || length > field->capacity) {
+        return ENOENT;
+    }
+    value->data = SHM_FIELD_VALUE_PTR(field);
+    value->length = length;
+    value->options = SHMCACHE_SERIALIZER_STRING;
+    return 0;
+}
+
+//find the field of the valid hash, field is NULL when not exist
+static int shm_field_lookup(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *name,
+        struct shm_hash_entry **entry, int64_t *entry_offset,
+        struct shm_field **field)
+{
+    *field = NULL;
+    if ((*entry=shm_ht_find_valid(context, key, entry_offset)) == NULL) {
+        return ENOENT;
+    }
+    if ((*entry)->value.options != SHMCACHE_SERIALIZER_HASH) {
+        logError("file: "__FILE__", line: %d, "
+                "key: %.*s, the value is not a hash, serializer: %s",
+                __LINE__, key->length, key->data,
+                shmcache_get_serializer_label((*entry)->value.options));
+        return EINVAL;
+    }
+
+    *field = shm_field_find(shm_get_value_ptr(context, *entry),
+            (*entry)->value.length, name);
+    return 0;
+}
+
+static int shm_field_create(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *name,
+        const char *data, const int length, const int ttl)
+{
+    int result;
+    struct shmcache_value_info value;
+    char *buff;
+
+    value.length = SHM_FIELD_RECORD_SIZE(name->length, length);
+    if ((buff=(char *)malloc(value.length)) == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, value.length);
+        return ENOMEM;
+    }
+
+    shm_field_build(buff, name, data, length);
+    value.data = buff;
+    value.options = SHMCACHE_SERIALIZER_HASH;
+    value.expires = HT_CALC_EXPIRES(get_current_time(), ttl);
+    result = shm_ht_set(context, key, &value);
+    free(buff);
+    return result;
+}
+
+//append the field record in place, the entry should have slack
+static int shm_field_append(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *name,
+        const char *data, const int length, bool *in_place)
+{
+    int result;
+    int size;
+    char *buff;
+
+    size = SHM_FIELD_RECORD_SIZE(name->length, length);
+    if ((buff=(char *)malloc(size)) == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, size);
+        return ENOMEM;
+    }
+
+    shm_field_build(buff, name, data, length);
+    result = shm_ht_write_range(context, key, HT_RANGE_APPEND,
+            0, buff, size, in_place);
+    free(buff);
+    return result;
+}
+
+//copy the hash without the deleted fields and the old field,
+//then append the field
+static int shm_field_copy_on_write(struct shmcache_context *context,
+        const struct shmcache_key_info *key, struct shm_hash_entry *entry,
+        struct shm_field *old_field, const struct shmcache_key_info *name,
+        const char *data, const int length)
+{
+    int result;
+    int size;
+    int total;
+    struct shm_field *field;
+    char *hvalue;
+    char *end;
+    char *buff;
+    char *p;
+    char *q;
+
+    total = entry->value.length + SHM_FIELD_RECORD_SIZE(name->length, length);
+    if ((buff=(char *)malloc(total)) == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, total);
+        return ENOMEM;
+    }
+
+    hvalue = shm_get_value_ptr(context, entry);
+    end = hvalue + entry->value.length;
+    p = buff;
+    q = hvalue;
+    while (end - q >= (int)sizeof(struct shm_field)) {
+        field = (struct shm_field *)q;
+        size = SHM_FIELD_RECORD_SIZE(field->name_len, field->capacity);
+        if (field->capacity < 0 || end - q < size) {
+            break;
+        }
+        if (field != old_field &&
+                (field->flags & SHM_FIELD_FLAG_DELETED) == 0)
+        {
+            memcpy(p, field, size);
+            p += size;
+        }
+        q += size;
+    }
+    p += shm_field_build(p, name, data, length);
+
+    result = shm_ht_replace(context, key, entry, buff, p - buff);
+    free(buff);
+    return result;
+}
+
+int shm_field_set(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *name,
+        const char *data, const int length,
+        const int ttl, bool *in_place)
+{
+    int result;
+    int64_t entry_offset;
+    struct shm_hash_entry *entry;
+    struct shm_field *field;
+
+    *in_place = false;
+    if (name->length <= 0 || name->length > SHMCACHE_MAX_KEY_SIZE) {
+		logError("file: "__FILE__", line: %d, "
+                "invalid field name length: %d, should in [1, %d]",
+                __LINE__, name->length, SHMCACHE_MAX_KEY_SIZE);
+        return EINVAL;
+    }
+
+    result = shm_field_lookup(context, key, name, &entry,
+            &entry_offset, &field);
+    if (result == ENOENT) {
+        return shm_field_create(context, key, name, data, length, ttl);
+    } else if (result != 0) {
+        return result;
+    }
+
+    //the lock-free readers may read the old field, so never overwrite
+    //it, append the new one and delete the old one instead. the deleted
+    //fields are dropped when the hash is copied
+    if (entry->value.length + SHM_FIELD_RECORD_SIZE(name->length,
+                length) > shm_ht_value_capacity(entry))
+    {
+        return shm_field_copy_on_write(context, key, entry,
+                field, name, data, length);
+    }
+
+    if ((result=shm_field_append(context, key, name, data,
+                    length, in_place)) != 0 || field == NULL)
+    {
+        return result;
+    }
+    if (!*in_place) {  //relocated, delete the old one of the new entry
+        if ((result=shm_field_lookup(context, key, name, &entry,
+                        &entry_offset, &field)) != 0)
+        {
+            return result;
+        }
+    }
+    field->flags |= SHM_FIELD_FLAG_DELETED;
+    shm_checkpoint_mark_entry(context, entry_offset);
+    return 0;
+}
+
+int shm_field_incr(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *name,
+        const int64_t increment, const int ttl,
+        int64_t *new_value, bool *in_place)
+{
+    int result;
+    int length;
+    int64_t entry_offset;
+    struct shm_hash_entry *entry;
+    struct shm_field *field;
+    char *endptr;
+    char buff[24];
+
+    *in_place = false;
+    result = shm_field_lookup(context, key, name, &entry,
+            &entry_offset, &field);
+    if (result != 0 && result != ENOENT) {
+        return result;
+    }
+
+    if (field != NULL) {
+        if (field->value_len >= sizeof(buff)) {
+            logError("file: "__FILE__", line: %d, "
+                    "key: %.*s, field: %.*s, value length: %d exceeds %d",
+                    __LINE__, key->length, key->data, name->length,
+                    name->data, field->value_len, (int)sizeof(buff));
+            return EINVAL;
+        }
+        memcpy(buff, SHM_FIELD_VALUE_PTR(field), field->value_len);
+        buff[field->value_len] = '\0';
+        endptr = NULL;
+        *new_value = strtoll(buff, &endptr, 10);
+        if (endptr != NULL && *endptr != '\0') {
+            logError("file: "__FILE__", line: %d, "
+                    "key: %.*s, field: %.*s, value: %s "
+                    "is not a valid integer", __LINE__, key->length,
+                    key->data, name->length, name->data, buff);
+            return EINVAL;
+        }
+        *new_value += increment;
+    } else {
+        *new_value = increment;
+    }
+
+    length = sprintf(buff, "%"PRId64, *new_value);
+    return shm_field_set(context, key, name, buff, length, ttl, in_place);
+}
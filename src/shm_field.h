@@ -0,0 +1,85 @@
+//shm_field.h
+
+#ifndef _SHM_FIELD_H
+#define _SHM_FIELD_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "common_define.h"
+#include "shmcache_types.h"
+
+//the field is replaced by the new one appended after it
+#define SHM_FIELD_FLAG_DELETED  1
+
+#define SHM_FIELD_RECORD_SIZE(name_len, capacity) \
+    MEM_ALIGN(sizeof(struct shm_field) + (name_len) + (capacity))
+
+#define SHM_FIELD_VALUE_PTR(field) ((field)->name + (field)->name_len)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+get the field of the hash value without lock
+parameters:
+	context: the context pointer
+    key: the key
+    name: the field name
+    value: store the returned field value
+return error no, 0 for success, ENOENT for the key or the field not exist,
+    EINVAL for the value of the key is not a hash
+*/
+int shm_field_get(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *name,
+        struct shmcache_value_info *value);
+
+/**
+set the field of the hash value, the hash is created when the key not
+exist. the field is never overwritten for the lock-free readers: the new
+field is appended in place when the entry has slack and the old one is
+marked deleted, otherwise the hash is copied on write without the
+deleted fields. the caller should hold the lock
+parameters:
+	context: the context pointer
+    key: the key
+    name: the field name
+    data: the field value
+    length: the field value length
+    ttl: the time to live in seconds when the hash is created
+    in_place: return if updated in place
+return error no, 0 for success, EINVAL for the value is not a hash
+*/
+int shm_field_set(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *name,
+        const char *data, const int length,
+        const int ttl, bool *in_place);
+
+/**
+increase the integer field of the hash value, the caller should hold the lock
+parameters:
+	context: the context pointer
+    key: the key
+    name: the field name
+    increment: the incremental number
+    ttl: the time to live in seconds when the hash is created
+    new_value: return the new value
+    in_place: return if updated in place
+return error no, 0 for success, EINVAL for the value is not a hash
+    or the field is not an integer
+*/
+int shm_field_incr(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *name,
+        const int64_t increment, const int ttl,
+        int64_t *new_value, bool *in_place);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
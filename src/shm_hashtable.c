@@ -9,6 +9,11 @@
 #include "shm_lock.h"
 #include "shm_object_pool.h"
 #include "shm_striping_allocator.h"
+#include "shm_checkpoint.h"
+#include "shm_bloom.h"
+#include "shm_dedup.h"
+#include "shm_chain.h"
+#include "shm_compress.h"
 #include "shm_hashtable.h"
 
 int shm_ht_get_capacity(const int max_count)
@@ -25,27 +30,85 @@ void shm_ht_init(struct shmcache_context *context, const int capacity)
 {
     context->memory->hashtable.capacity = capacity;
     context->memory->hashtable.count = 0;
+    context->memory->hashtable.stale = 0;
+    context->memory->hashtable.version = 0;
+    memset(&context->memory->refreshes, 0, sizeof(context->memory->refreshes));
 }
 
-#define HT_GET_BUCKET_INDEX(context, key) \
-    ((unsigned int)context->config.hash_func(key->data, key->length) % context->memory->hashtable.capacity)
+//use the hash code computed by shmcache_key_hash when the key is hashed
+#define HT_GET_HASH_CODE(context, key) \
+    (key->hashed == SHMCACHE_KEY_HASHED ? key->hash_code : \
+     (unsigned int)context->config.hash_func(key->data, key->length))
 
-#define HT_KEY_EQUALS(hentry, pkey) (hentry->key_len == pkey->length && memcmp(hentry->key, pkey->data, pkey->length) == 0)
+//key_flags: 0 or SHM_HENTRY_FLAG_INT_KEY
+#define HT_GET_HASH_CODE_EX(context, key, key_flags) \
+    (key_flags == 0 ? HT_GET_HASH_CODE(context, key) : \
+     shm_ht_int_key_hash(*(int64_t *)key->data))
+
+#define HT_GET_BUCKET_INDEX(context, hash_code) \
+    ((hash_code) % context->memory->hashtable.capacity)
+
+#define HT_REFRESH_KEY_HASH(ns_index, hash_code) \
+    ((uint32_t)((hash_code) * 31 + (ns_index) + 1))
+
+#define HT_REFRESH_CLAIM(context, key_hash) \
+    (context->memory->refreshes.claims + (key_hash) % SHM_REFRESH_SLOT_COUNT)
+
+#define HT_KEY_EQUALS_EX(hentry, ns_index, pkey, key_flags) \
+        (hentry->key_len == pkey->length && hentry->ns == ns_index \
+        && (hentry->flags & SHM_HENTRY_FLAG_INT_KEY) == key_flags \
+        && memcmp(hentry->key, pkey->data, pkey->length) == 0)
+
+#define HT_KEY_EQUALS(hentry, ns_index, pkey) \
+    HT_KEY_EQUALS_EX(hentry, ns_index, pkey, 0)
 
 #define HT_VALUE_EQUALS(hvalue, hv_len, pvalue) (hv_len == pvalue->length \
         && memcmp(hvalue, pvalue->data, pvalue->length) == 0)
 
-int shm_ht_set(struct shmcache_context *context, const struct shmcache_key_info *key, const struct shmcache_value_info *value)
+//free the refresh claim of the key when the value refreshed
+static void shm_ht_clear_refresh_claim(struct shmcache_context *context,
+        const int ns_index, const unsigned int hash_code)
+{
+    volatile uint64_t *slot;
+    uint64_t claim;
+    uint32_t key_hash;
+
+    key_hash = HT_REFRESH_KEY_HASH(ns_index, hash_code);
+    slot = HT_REFRESH_CLAIM(context, key_hash);
+    claim = *slot;
+    if (claim != 0 && (uint32_t)(claim >> 32) == key_hash) {
+        __sync_bool_compare_and_swap(slot, claim, 0);
+    }
+}
+
+//entry_flags: SHM_HENTRY_FLAG_INT_KEY for the 8 bytes integer key,
+//    SHM_HENTRY_FLAG_TOMBSTONE for the negative entry
+//capacity: the value capacity to reserve for growing in place
+static int shm_ht_do_set(struct shmcache_context *context, const int ns_index,
+        const struct shmcache_key_info *key, const int entry_flags,
+        const struct shmcache_value_info *value, const int64_t soft_expires,
+        const uint32_t *tag_slots, const int tag_count, const int capacity)
 {
     int result;
+    int size;
+    int flags;
+    int key_flags;
+    int grow_capacity;
+    struct shm_namespace *ns;
+    unsigned int hash_code;
     unsigned int index;
     int64_t old_offset;
     int64_t new_offset;
+    int64_t previous_offset;
     struct shm_hash_entry *old_entry;
     struct shm_hash_entry *new_entry;
     struct shm_hash_entry *previous;
+    struct shm_dedup_ref ref;
+    struct shm_chain_ref chain;
+    struct shmcache_value_info shared;
     char *hvalue;
     bool found;
+    bool recycled;
 
     if (key->length > SHMCACHE_MAX_KEY_SIZE) {
 		logError("file: "__FILE__", line: %d, "
@@ -61,6 +124,13 @@ int shm_ht_set(struct shmcache_context *context, const struct shmcache_key_info
         return EINVAL;
     }
 
+    if (tag_count > SHMCACHE_MAX_TAGS) {
+		logError("file: "__FILE__", line: %d, "
+                "invalid tag count: %d exceeds %d", __LINE__,
+                tag_count, SHMCACHE_MAX_TAGS);
+        return EINVAL;
+    }
+
     if (context->memory->hashtable.count >= context->config.max_key_count) {
         //淘汰删除一些 过旧的key（按FIFO策略 删除entry空间）
         if ((result=shm_value_allocator_recycle(context, &context->memory->stats.memory.recycle.key, context->config.recycle_key_once)) != 0)
@@ -73,32 +143,117 @@ int shm_ht_set(struct shmcache_context *context, const struct shmcache_key_info
         g_current_time = time(NULL);
     }
 
-    //从 striping_allocator中分配一个可用的entry空间
-    if ((new_entry=shm_value_allocator_alloc(context, key->length, value->length)) == NULL)
+    if (context->memory->hashtable.stale > 0) {
+        shm_ht_reap(context, HT_REAP_STALE_ONCE);
+    }
+
+    //evict the oldest entries of the namespace when exceeds its quota
+    ns = SHM_NS_PTR(context, ns_index);
+    key_flags = entry_flags & SHM_HENTRY_FLAG_INT_KEY;
+    flags = entry_flags;
+    //the soft expires is useless when not before the hard expires
+    if (soft_expires != 0 && (value->expires == SHMCACHE_NEVER_EXPIRED ||
+                soft_expires < value->expires))
     {
-       return result;
+        flags |= SHM_HENTRY_FLAG_SOFT_TTL;
+    }
+    if (tag_count > 0) {
+        flags |= SHM_HENTRY_FLAG_TAGGED;
+    }
+    grow_capacity = capacity;
+    chain.size = 0;
+    //the value to grow in place is not shared
+    if (capacity == 0 && shm_dedup_accept(context, value)) {
+        if ((result=shm_dedup_acquire(context, value, &ref)) != 0) {
+            return result;
+        }
+        shared = *value;
+        shared.data = (char *)&ref;
+        shared.length = sizeof(ref);
+        shared.options |= SHMCACHE_OPTIONS_DEDUP;
+        value = &shared;
+    } else if (shm_chain_accept(context, value)) {
+        if ((result=shm_chain_alloc(context, value, &chain)) != 0) {
+            return result;
+        }
+        shared = *value;
+        shared.data = (char *)&chain;
+        shared.length = sizeof(chain);
+        shared.options |= SHMCACHE_OPTIONS_CHAINED;
+        value = &shared;
+        grow_capacity = 0;
+    } else if (context->memory->chain.part_size > 0) {
+        //the entry must fit in the striping sized by the part size
+        if (value->length > context->memory->chain.part_size) {
+            logError("file: "__FILE__", line: %d, "
+                    "invalid value length: %d exceeds the part size: %d, "
+                    "the value of options: 0x%x can't be chained",
+                    __LINE__, value->length, context->memory->chain.
+                    part_size, value->options);
+            return EINVAL;
+        }
+        if (grow_capacity > context->memory->chain.part_size) {
+            grow_capacity = context->memory->chain.part_size;
+        }
+    }
+    if ((flags & (SHM_HENTRY_FLAG_SOFT_TTL | SHM_HENTRY_FLAG_TAGGED)) == 0) {
+        //the slack follows the value, see shm_ht_value_capacity
+        size = shm_value_allocator_entry_size(key->length,
+                grow_capacity > value->length ? grow_capacity :
+                value->length);
+    } else {
+        size = shm_value_allocator_entry_size(key->length, value->length);
+        if ((flags & SHM_HENTRY_FLAG_SOFT_TTL) != 0) {
+            size += sizeof(struct shm_soft_ttl);
+        }
+        if ((flags & SHM_HENTRY_FLAG_TAGGED) != 0) {
+            size += SHM_TAG_REFS_SIZE(tag_count);
+        }
+    }
+    //the parts are charged to the namespace of the entry
+    if ((result=shm_ns_reserve(context, ns_index, size + chain.size)) == 0) {
+        //从 striping_allocator中分配一个可用的entry空间
+        if ((new_entry=shm_value_allocator_alloc(context, size,
+                        &new_offset)) == NULL)
+        {
+            result = ENOMEM;
+        }
+    }
+    if (result != 0) {
+        if (value == &shared) {
+            recycled = false;
+            if ((shared.options & SHMCACHE_OPTIONS_CHAINED) != 0) {
+                shm_chain_release(context, &chain, &recycled);
+            } else {
+                shm_dedup_release(context, ref.blob_offset, &recycled);
+            }
+        }
+        return result;
     }
 
     //从hashtable中 查下 是否已存在这个key
     previous = NULL;   //遍历过程中 记录上一个entry
+    previous_offset = 0;
     old_entry = NULL;
     found = false;
-    index = HT_GET_BUCKET_INDEX(context, key);
+    hash_code = HT_GET_HASH_CODE_EX(context, key, key_flags);
+    index = HT_GET_BUCKET_INDEX(context, hash_code);
     old_offset = context->memory->hashtable.buckets[index];
     while (old_offset > 0)
     {
         old_entry = shm_get_hentry_ptr(context, old_offset);
-        if (HT_KEY_EQUALS(old_entry, key)) {
+        if (HT_KEY_EQUALS_EX(old_entry, ns_index, key, key_flags)) {
             found = true;
             break;
         }
 
+        previous_offset = old_offset;
         old_offset = old_entry->ht_next;
         previous = old_entry;
     }
 
     if (found) {   //如果找到了，则 修改new_entry->next，并释放old_entry 在striping_allocator中的空间
-        bool recycled = false;
+        recycled = false;
         new_entry->ht_next = old_entry->ht_next;
         //这里会 真实清空old_entry的数据吗？如果是的话，另一个读者在读的时候，会产生错误！
         //不会真实清空，会循环利用striping_allocator空间.
@@ -108,20 +263,37 @@ int shm_ht_set(struct shmcache_context *context, const struct shmcache_key_info
         new_entry->ht_next = 0;   //加入 作为链表的最后一个结点
     }
 
-    new_offset = shm_get_hentry_offset(new_entry);
     //copy key data
     memcpy(new_entry->key, key->data, key->length);
     new_entry->key_len = key->length;
+    new_entry->ns = ns_index;
     //copy value data
     hvalue = shm_get_value_ptr(context, new_entry);
     memcpy(hvalue, value->data, value->length);
     new_entry->value.length = value->length;
     new_entry->value.options = value->options;
-    new_entry->expires = value->expires;
+    new_entry->expires = shm_ht_relative_expires(context, value->expires);
+    new_entry->generation = ns->generation;
+    new_entry->version = ++context->memory->hashtable.version;
+    new_entry->flags = flags;
+    if ((flags & SHM_HENTRY_FLAG_SOFT_TTL) != 0) {
+        struct shm_soft_ttl *soft;
+        soft = shm_ht_get_soft_ttl(context, new_entry);
+        soft->expires = shm_ht_relative_expires(context, soft_expires);
+        shm_ht_clear_refresh_claim(context, ns_index, hash_code);
+    }
+    if ((flags & SHM_HENTRY_FLAG_TAGGED) != 0) {
+        shm_tag_set_refs(context, new_entry, tag_slots, tag_count);
+    }
+
+    if (!found) {
+        shm_bloom_add(context, hash_code);
+    }
 
     //将entry加入到桶链表中
     if (previous != NULL) {  //add to tail
         previous->ht_next = new_offset;    //加入作为链表的 最后一个结点(这样在并发读的时候，不会影响读者遍历链表)
+        shm_checkpoint_mark_entry(context, previous_offset);
     } else {
         context->memory->hashtable.buckets[index] = new_offset;  //加入作为链表的第一个结点  这里应该用原子操作吧？？？
     }
@@ -130,92 +302,540 @@ int shm_ht_set(struct shmcache_context *context, const struct shmcache_key_info
     context->memory->hashtable.count++;
     context->memory->usage.used.value += value->length;
     context->memory->usage.used.key += new_entry->key_len;
-    shm_list_add_tail(context, new_offset);  //插入到context->list中
+    ns->count++;
+    ns->used += new_entry->size + chain.size;
+    shm_list_add_tail(context, &ns->head, new_offset);  //插入到namespace的链表中
 
     return 0;
 }
 
-int shm_ht_get(struct shmcache_context *context,
+//elect one reader to refresh the soft expired value without lock,
+//the slot is taken until the claim timeout or the key set again
+static int shm_ht_elect_refresher(struct shmcache_context *context,
+        const unsigned int hash_code, const time_t current_time)
+{
+    volatile uint64_t *slot;
+    uint64_t claim;
+    uint32_t key_hash;
+    uint32_t now;
+
+    key_hash = HT_REFRESH_KEY_HASH(context->ns_index, hash_code);
+    slot = HT_REFRESH_CLAIM(context, key_hash);
+    now = shm_ht_relative_expires(context, current_time);
+    claim = *slot;
+    if ((claim == 0 || (uint32_t)claim + HT_SOFT_TTL_REFRESH_TIMEOUT <= now)
+            && __sync_bool_compare_and_swap(slot, claim,
+                ((uint64_t)key_hash << 32) | now))
+    {
+        return SHMCACHE_VALUE_STALE_REFRESH;
+    }
+    return SHMCACHE_VALUE_STALE;
+}
+
+int shm_ht_set_ex(struct shmcache_context *context, const int ns_index,
         const struct shmcache_key_info *key,
-        struct shmcache_value_info *value)
+        const struct shmcache_value_info *value, const int64_t soft_expires,
+        const uint32_t *tag_slots, const int tag_count)
 {
-    unsigned int index;
+    return shm_ht_do_set(context, ns_index, key, 0, value, soft_expires,
+            tag_slots, tag_count, 0);
+}
+
+int shm_ht_set_tombstone(struct shmcache_context *context,
+        const struct shmcache_key_info *key, const int64_t expires)
+{
+    struct shmcache_value_info value;
+
+    value.data = "";
+    value.length = 0;
+    value.options = 0;
+    value.expires = expires;
+    return shm_ht_do_set(context, context->ns_index, key,
+            SHM_HENTRY_FLAG_TOMBSTONE, &value, 0, NULL, 0, 0);
+}
+
+int shm_ht_get_ex(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        struct shmcache_value_info *value, const bool elect_refresher)
+{
+    unsigned int hash_code;
     int64_t entry_offset;
     struct shm_hash_entry *entry;
+    struct shm_soft_ttl *soft;
+    time_t current_time;
+    int result;
 
-    index = HT_GET_BUCKET_INDEX(context, key);
-    entry_offset = context->memory->hashtable.buckets[index];
+    hash_code = HT_GET_HASH_CODE(context, key);
+    if (!shm_bloom_may_contain(context, hash_code)) {
+        __sync_add_and_fetch(&context->memory->bloom.stats.reject, 1);
+        return ENOENT;
+    }
+
+    entry_offset = context->memory->hashtable.buckets[
+        HT_GET_BUCKET_INDEX(context, hash_code)];
     while (entry_offset > 0)
     {
         entry = shm_get_hentry_ptr(context, entry_offset);
-        if (HT_KEY_EQUALS(entry, key))  //如果是这个entry
+        if (HT_KEY_EQUALS(entry, context->ns_index, key))  //如果是这个entry
         {
+            if (!(HT_ENTRY_IS_CURRENT(context, entry) &&
+                        shm_tag_entry_is_valid(context, entry)))
+            {
+                return ENOENT;   //cleared or the tag invalidated
+            }
             value->data = shm_get_value_ptr(context, entry);
             value->length = entry->value.length;
             value->options = entry->value.options;
-            value->expires = entry->expires;
-            if (HT_ENTRY_IS_VALID(entry, get_current_time()))
+            value->expires = HT_ENTRY_EXPIRES(context, entry);
+            value->version = entry->version;
+            value->stale = SHMCACHE_VALUE_FRESH;
+            if ((value->options & SHMCACHE_OPTIONS_DEDUP) != 0 &&
+                    shm_dedup_resolve(context, value) != 0)
             {
-                return 0;
+                return ENOENT;
             }
-            else
+            if ((value->options & SHMCACHE_OPTIONS_CHAINED) != 0 &&
+                    (result=shm_chain_assemble(context, value)) != 0)
+            {
+                return result;
+            }
+            current_time = get_current_time();
+            //the expired tombstone is not found, never served as stale
+            if ((entry->flags & SHM_HENTRY_FLAG_TOMBSTONE) != 0) {
+                return HT_ENTRY_IS_VALID(context, entry, current_time) ?
+                    ENODATA : ENOENT;
+            }
+            if (!HT_ENTRY_IS_VALID(context, entry, current_time))
             {
-                return ETIMEDOUT;
+                return ETIMEDOUT;   //past the hard expires
+            }
+
+            if ((entry->flags & SHM_HENTRY_FLAG_SOFT_TTL) != 0) {
+                soft = shm_ht_get_soft_ttl(context, entry);
+                if (context->memory->init_time + soft->expires <
+                        current_time)
+                {
+                    value->stale = elect_refresher ? shm_ht_elect_refresher(
+                            context, hash_code, current_time) :
+                        SHMCACHE_VALUE_STALE;
+                }
             }
+            return 0;
         }
 
         entry_offset = entry->ht_next;
     }
 
+    if (context->memory->bloom.block_count > 0) {
+        __sync_add_and_fetch(&context->memory->bloom.stats.
+                false_positive, 1);
+    }
     return ENOENT;
 }
 
+struct shm_hash_entry *shm_ht_find(struct shmcache_context *context,
+        const int ns_index, const struct shmcache_key_info *key,
+        int64_t *entry_offset)
+{
+    unsigned int index;
+    int64_t offset;
+    struct shm_hash_entry *entry;
+
+    index = HT_GET_BUCKET_INDEX(context, HT_GET_HASH_CODE(context, key));
+    offset = context->memory->hashtable.buckets[index];
+    while (offset > 0)
+    {
+        entry = shm_get_hentry_ptr(context, offset);
+        if (HT_KEY_EQUALS(entry, ns_index, key)) {
+            *entry_offset = offset;
+            return entry;
+        }
+        offset = entry->ht_next;
+    }
+
+    return NULL;
+}
+
+struct shm_hash_entry *shm_ht_find_valid(struct shmcache_context *context,
+        const struct shmcache_key_info *key, int64_t *entry_offset)
+{
+    struct shm_hash_entry *entry;
+
+    entry = shm_ht_find(context, context->ns_index, key, entry_offset);
+    if (entry == NULL || (entry->flags & SHM_HENTRY_FLAG_TOMBSTONE) != 0 ||
+            !(HT_ENTRY_IS_CURRENT(context, entry) &&
+                HT_ENTRY_IS_VALID(context, entry, get_current_time()) &&
+                shm_tag_entry_is_valid(context, entry)))
+    {
+        return NULL;
+    }
+    return entry;
+}
+
+int shm_ht_touch(struct shmcache_context *context,
+        const struct shmcache_key_info *key, const int64_t expires)
+{
+    int64_t entry_offset;
+    struct shm_hash_entry *entry;
+
+    if ((entry=shm_ht_find_valid(context, key, &entry_offset)) == NULL) {
+        return ENOENT;
+    }
+
+    //the readers load the 32 bits expires atomically
+    entry->expires = shm_ht_relative_expires(context, expires);
+    shm_checkpoint_mark_entry(context, entry_offset);
+    return 0;
+}
+
+//the compressed value never grows in place, so no slack for it
+static int shm_ht_replace_value(struct shmcache_context *context,
+        const struct shmcache_key_info *key, struct shm_hash_entry *entry,
+        const char *data, const int length, const int options)
+{
+    int capacity;
+    int tag_count;
+    int i;
+    int64_t soft_expires;
+    uint32_t tag_slots[SHMCACHE_MAX_TAGS];
+    struct shm_tag_refs *refs;
+    struct shmcache_value_info value;
+
+    value.data = (char *)data;
+    value.length = length;
+    value.options = options;
+    value.expires = HT_ENTRY_EXPIRES(context, entry);
+    if ((entry->flags & SHM_HENTRY_FLAG_SOFT_TTL) != 0) {
+        soft_expires = context->memory->init_time +
+            shm_ht_get_soft_ttl(context, entry)->expires;
+    } else {
+        soft_expires = 0;
+    }
+    tag_count = 0;
+    if ((entry->flags & SHM_HENTRY_FLAG_TAGGED) != 0) {
+        refs = shm_tag_get_refs(context, entry);
+        for (i=0; i<refs->count && i<SHMCACHE_MAX_TAGS; i++) {
+            tag_slots[tag_count++] = refs->items[i].slot;
+        }
+    }
+
+    if ((options & SHMCACHE_OPTIONS_COMPRESSED) != 0) {
+        capacity = 0;
+    } else {
+        capacity = HT_VALUE_GROW_CAPACITY(length);
+        if (capacity > context->config.max_value_size) {
+            capacity = context->config.max_value_size;
+        }
+    }
+    return shm_ht_do_set(context, context->ns_index, key, 0, &value,
+            soft_expires, tag_slots, tag_count, capacity);
+}
+
+int shm_ht_replace(struct shmcache_context *context,
+        const struct shmcache_key_info *key, struct shm_hash_entry *entry,
+        const char *data, const int length)
+{
+    return shm_ht_replace_value(context, key, entry, data, length,
+            entry->value.options & ~(SHMCACHE_OPTIONS_DEDUP |
+                SHMCACHE_OPTIONS_CHAINED));
+}
+
+//the stored bytes of the entry, the chained one is copied to the buffer
+static char *shm_ht_get_stored_value(struct shmcache_context *context,
+        struct shm_hash_entry *entry, char **buff, int *length)
+{
+    struct shm_chain_ref *ref;
+
+    *buff = NULL;
+    if ((entry->value.options & SHMCACHE_OPTIONS_CHAINED) == 0) {
+        return shm_dedup_entry_value(context, entry, length);
+    }
+
+    ref = shm_chain_get_ref(context, entry);
+    if ((*buff=(char *)malloc(ref->length)) == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, ref->length);
+        return NULL;
+    }
+    if ((*length=shm_chain_copy(context, ref, *buff, ref->length)) < 0) {
+        free(*buff);
+        *buff = NULL;
+        return NULL;
+    }
+    return *buff;
+}
+
+//the value length, the original length for the compressed value
+static int shm_ht_get_value_length(struct shmcache_context *context,
+        struct shm_hash_entry *entry)
+{
+    struct shm_chain_ref *ref;
+    char *hvalue;
+    int length;
+    int original;
+
+    if ((entry->value.options & SHMCACHE_OPTIONS_CHAINED) != 0) {
+        ref = shm_chain_get_ref(context, entry);
+        length = ref->length;
+        hvalue = shm_get_value_ptr(context, shm_get_hentry_ptr(
+                    context, ref->first_offset));
+    } else {
+        hvalue = shm_dedup_entry_value(context, entry, &length);
+    }
+
+    if ((entry->value.options & SHMCACHE_OPTIONS_COMPRESSED) == 0) {
+        return length;
+    }
+    original = 0;
+    if (length >= SHM_COMPRESS_HEADER_SIZE) {
+        memcpy(&original, hvalue, SHM_COMPRESS_HEADER_SIZE);
+    }
+    return original;
+}
+
+//uncompress the value of the entry to dest, the length should be
+//the original length
+static int shm_ht_uncompress_entry(struct shmcache_context *context,
+        const struct shmcache_key_info *key, struct shm_hash_entry *entry,
+        char *dest, const int length)
+{
+    int result;
+    int stored_len;
+    char *stored;
+    char *buff;
+
+    if ((stored=shm_ht_get_stored_value(context, entry,
+                    &buff, &stored_len)) == NULL)
+    {
+        return ENOENT;
+    }
+
+    if (length <= 0 || stored_len < SHM_COMPRESS_HEADER_SIZE ||
+            shm_uncompress_block(stored + SHM_COMPRESS_HEADER_SIZE,
+                stored_len - SHM_COMPRESS_HEADER_SIZE, dest,
+                length) != length)
+    {
+		logError("file: "__FILE__", line: %d, "
+                "key: %.*s, the compressed value is corrupted",
+                __LINE__, key->length, key->data);
+        result = EBADMSG;
+    } else {
+        result = 0;
+    }
+
+    if (buff != NULL) {
+        free(buff);
+    }
+    return result;
+}
+
+//compose the new value and replace the entry, the compressed value
+//is uncompressed to compose and compressed again
+static int shm_ht_relocate(struct shmcache_context *context,
+        const struct shmcache_key_info *key, struct shm_hash_entry *entry,
+        const int op, const int start, const char *data,
+        const int length, const int old_length, const int new_length)
+{
+    int result;
+    int value_len;
+    char *hvalue;
+    char *buff;
+    char *dest;
+    struct shmcache_value_info value;
+    struct shmcache_value_info stored;
+
+    //the old entry may be recycled when alloc, so copy to the buffer
+    buff = (char *)malloc(new_length > 0 ? new_length : 1);
+    if (buff == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, new_length);
+        return ENOMEM;
+    }
+
+    dest = (op == HT_RANGE_PREPEND) ? buff + length : buff;
+    if ((entry->value.options & SHMCACHE_OPTIONS_COMPRESSED) != 0) {
+        if ((result=shm_ht_uncompress_entry(context, key, entry,
+                        dest, old_length)) != 0)
+        {
+            free(buff);
+            return result;
+        }
+    } else if ((entry->value.options & SHMCACHE_OPTIONS_CHAINED) != 0) {
+        if ((result=shm_chain_copy(context, shm_chain_get_ref(
+                            context, entry), dest, old_length)) < 0)
+        {
+            free(buff);
+            return -result;
+        }
+    } else {
+        hvalue = shm_dedup_entry_value(context, entry, &value_len);
+        memcpy(dest, hvalue, value_len);
+    }
+    if (op == HT_RANGE_PREPEND) {
+        memcpy(buff, data, length);
+    } else {
+        if (start > old_length) {
+            memset(buff + old_length, 0, start - old_length);
+        }
+        memcpy(buff + start, data, length);
+    }
+
+    if ((entry->value.options & SHMCACHE_OPTIONS_COMPRESSED) != 0) {
+        value.data = buff;
+        value.length = new_length;
+        value.options = entry->value.options & ~(SHMCACHE_OPTIONS_DEDUP |
+                SHMCACHE_OPTIONS_CHAINED | SHMCACHE_OPTIONS_COMPRESSED);
+        if ((result=shm_compress_value(context, &value, &stored)) == 0) {
+            result = shm_ht_replace_value(context, key, entry,
+                    stored.data, stored.length, stored.options);
+        }
+    } else {
+        result = shm_ht_replace(context, key, entry, buff, new_length);
+    }
+    free(buff);
+    return result;
+}
+
+int shm_ht_write_range(struct shmcache_context *context,
+        const struct shmcache_key_info *key, const int op,
+        const int offset, const char *data, const int length,
+        bool *in_place)
+{
+    int64_t entry_offset;
+    struct shm_hash_entry *entry;
+    char *hvalue;
+    int old_length;
+    int64_t new_length;
+    int start;
+
+    *in_place = false;
+    if ((entry=shm_ht_find_valid(context, key, &entry_offset)) == NULL) {
+        return ENOENT;
+    }
+
+    old_length = shm_ht_get_value_length(context, entry);
+    switch (op) {
+        case HT_RANGE_APPEND:
+            start = old_length;
+            new_length = old_length + length;
+            break;
+        case HT_RANGE_PREPEND:
+            start = 0;
+            new_length = old_length + length;
+            break;
+        default:
+            start = offset;
+            new_length = (int64_t)offset + length > old_length ?
+                (int64_t)offset + length : old_length;
+            break;
+    }
+    if (new_length > context->config.max_value_size) {
+		logError("file: "__FILE__", line: %d, "
+                "invalid value length: %"PRId64" exceeds %d", __LINE__,
+                new_length, context->config.max_value_size);
+        return EINVAL;
+    }
+
+    //only write after the value in place, the lock-free readers see
+    //the old value until the length is changed. the shared, the chained
+    //and the compressed values are always relocated
+    if (op != HT_RANGE_PREPEND && start >= old_length &&
+            (entry->value.options & (SHMCACHE_OPTIONS_DEDUP |
+                                     SHMCACHE_OPTIONS_CHAINED |
+                                     SHMCACHE_OPTIONS_COMPRESSED)) == 0 &&
+            new_length <= shm_ht_value_capacity(entry))
+    {
+        hvalue = shm_get_value_ptr(context, entry);
+        if (start > old_length) {
+            memset(hvalue + old_length, 0, start - old_length);
+        }
+        memcpy(hvalue + start, data, length);
+        __sync_synchronize();
+        entry->value.length = new_length;
+        entry->version = ++context->memory->hashtable.version;
+        context->memory->usage.used.value += new_length - old_length;
+        shm_checkpoint_mark_entry(context, entry_offset);
+        *in_place = true;
+        return 0;
+    }
+
+    return shm_ht_relocate(context, key, entry, op, start,
+            data, length, old_length, new_length);
+}
+
 //释放hash entry在shm中的空间
 void shm_ht_free_entry(struct shmcache_context *context,
         struct shm_hash_entry *entry, const int64_t entry_offset,
         bool *recycled)
 {
+    struct shm_namespace *ns;
+
+    ns = SHM_NS_PTR(context, entry->ns);
     context->memory->hashtable.count--;
+    ns->count--;
+    if (!HT_ENTRY_IS_CURRENT(context, entry)) {
+        context->memory->hashtable.stale--;
+        ns->stale--;
+    }
     context->memory->usage.used.value -= entry->value.length;
     context->memory->usage.used.key -= entry->key_len;
-    shm_list_delete(context, entry_offset);
-    shm_value_allocator_free(context, entry, recycled);
+    ns->used -= entry->size;
+    shm_list_delete(context, &ns->head, entry_offset);
+    if ((entry->value.options & SHMCACHE_OPTIONS_DEDUP) != 0) {
+        shm_dedup_release(context, ((struct shm_dedup_ref *)
+                    shm_get_value_ptr(context, entry))->blob_offset,
+                recycled);
+    } else if ((entry->value.options & SHMCACHE_OPTIONS_CHAINED) != 0) {
+        ns->used -= shm_chain_get_ref(context, entry)->size;
+        shm_chain_release(context, shm_chain_get_ref(context, entry),
+                recycled);
+    }
+    shm_value_allocator_free(context, entry, entry_offset, recycled);
     entry->ht_next = 0;
+    shm_checkpoint_mark_entry(context, entry_offset);
 }
 
-//delete the key for internal usage
-int shm_ht_delete_ex(struct shmcache_context *context, const struct shmcache_key_info *key, bool *recycled)
+static int shm_ht_do_delete(struct shmcache_context *context,
+        const int ns_index, const struct shmcache_key_info *key,
+        const int key_flags, bool *recycled)
 {
     int result;
+    unsigned int hash_code;
     unsigned int index;
     int64_t entry_offset;
+    int64_t previous_offset;
     struct shm_hash_entry *entry;
     struct shm_hash_entry *previous;
 
     previous = NULL;
+    previous_offset = 0;
     result = ENOENT;
-    index = HT_GET_BUCKET_INDEX(context, key);
+    hash_code = HT_GET_HASH_CODE_EX(context, key, key_flags);
+    index = HT_GET_BUCKET_INDEX(context, hash_code);
     entry_offset = context->memory->hashtable.buckets[index];
     while (entry_offset > 0)
     {
         entry = shm_get_hentry_ptr(context, entry_offset);
         //如果找到这个key对应的entry，则将它从 桶链表中删除.
-        if (HT_KEY_EQUALS(entry, key))
+        if (HT_KEY_EQUALS_EX(entry, ns_index, key, key_flags))
         {
             if (previous != NULL)
             {
                 previous->ht_next = entry->ht_next;
+                shm_checkpoint_mark_entry(context, previous_offset);
             }
             else
             {
                 context->memory->hashtable.buckets[index] = entry->ht_next;
             }
 
+            shm_bloom_remove(context, hash_code);
             shm_ht_free_entry(context, entry, entry_offset, recycled);
             result = 0;
             break;
         }
 
+        previous_offset = entry_offset;
         entry_offset = entry->ht_next;
         previous = entry;
     }
@@ -223,20 +843,139 @@ int shm_ht_delete_ex(struct shmcache_context *context, const struct shmcache_key
     return result;
 }
 
+//delete the key for internal usage
+int shm_ht_delete_ex(struct shmcache_context *context,
+        const struct shmcache_key_info *key, bool *recycled)
+{
+    return shm_ht_do_delete(context, context->ns_index, key, 0, recycled);
+}
+
+int shm_ht_set_int(struct shmcache_context *context, const int ns_index,
+        const int64_t key, const struct shmcache_value_info *value)
+{
+    struct shmcache_key_info k;
+
+    k.data = (char *)&key;
+    k.length = sizeof(key);
+    k.hashed = 0;
+    return shm_ht_do_set(context, ns_index, &k, SHM_HENTRY_FLAG_INT_KEY,
+            value, 0, NULL, 0, 0);
+}
+
+int shm_ht_get_int(struct shmcache_context *context, const int64_t key,
+        struct shmcache_value_info *value)
+{
+    unsigned int hash_code;
+    int64_t entry_offset;
+    struct shm_hash_entry *entry;
+    int result;
+
+    hash_code = shm_ht_int_key_hash(key);
+    if (!shm_bloom_may_contain(context, hash_code)) {
+        __sync_add_and_fetch(&context->memory->bloom.stats.reject, 1);
+        return ENOENT;
+    }
+
+    entry_offset = context->memory->hashtable.buckets[
+        HT_GET_BUCKET_INDEX(context, hash_code)];
+    while (entry_offset > 0)
+    {
+        entry = shm_get_hentry_ptr(context, entry_offset);
+        if ((entry->flags & SHM_HENTRY_FLAG_INT_KEY) != 0
+                && *(int64_t *)entry->key == key
+                && entry->ns == context->ns_index)
+        {
+            if (!HT_ENTRY_IS_CURRENT(context, entry)) {
+                return ENOENT;
+            }
+            value->data = shm_get_value_ptr(context, entry);
+            value->length = entry->value.length;
+            value->options = entry->value.options;
+            value->expires = HT_ENTRY_EXPIRES(context, entry);
+            value->version = entry->version;
+            value->stale = SHMCACHE_VALUE_FRESH;
+            if ((value->options & SHMCACHE_OPTIONS_DEDUP) != 0 &&
+                    shm_dedup_resolve(context, value) != 0)
+            {
+                return ENOENT;
+            }
+            if ((value->options & SHMCACHE_OPTIONS_CHAINED) != 0 &&
+                    (result=shm_chain_assemble(context, value)) != 0)
+            {
+                return result;
+            }
+            return HT_ENTRY_IS_VALID(context, entry, get_current_time()) ?
+                0 : ETIMEDOUT;
+        }
+
+        entry_offset = entry->ht_next;
+    }
+
+    if (context->memory->bloom.block_count > 0) {
+        __sync_add_and_fetch(&context->memory->bloom.stats.
+                false_positive, 1);
+    }
+    return ENOENT;
+}
+
+int shm_ht_delete_int(struct shmcache_context *context, const int64_t key,
+        bool *recycled)
+{
+    struct shmcache_key_info k;
+
+    k.data = (char *)&key;
+    k.length = sizeof(key);
+    k.hashed = 0;
+    return shm_ht_do_delete(context, context->ns_index, &k,
+            SHM_HENTRY_FLAG_INT_KEY, recycled);
+}
+
+void shm_ht_delete_entry(struct shmcache_context *context,
+        struct shm_hash_entry *entry, const int64_t entry_offset,
+        bool *recycled)
+{
+    struct shmcache_key_info key;
+
+    key.data = entry->key;
+    key.length = entry->key_len;
+    key.hashed = 0;
+    if (shm_ht_do_delete(context, entry->ns, &key,
+                entry->flags & SHM_HENTRY_FLAG_INT_KEY, recycled) != 0)
+    {
+        logError("file: "__FILE__", line: %d, "
+                "delete entry fail, namespace: %d, "
+                "entry offset: %"PRId64", key: %.*s", __LINE__,
+                entry->ns, entry_offset, entry->key_len, entry->key);
+        shm_ht_free_entry(context, entry, entry_offset, recycled);
+    }
+}
+
 int shm_ht_clear(struct shmcache_context *context)
 {
     struct shm_striping_allocator *allocator;
     struct shm_striping_allocator *end;
+    struct shm_namespace *ns;
     int64_t allocator_offset;
     int ht_count;
+    int i;
 
     context->memory->stats.hashtable.last_clear_time =
         context->memory->stats.last.calc_time = get_current_time();
     ht_count = context->memory->hashtable.count;
-    memset(context->memory->hashtable.buckets, 0, sizeof(int64_t) *
+    memset(context->memory->hashtable.buckets, 0, sizeof(uint32_t) *
             context->memory->hashtable.capacity);
+    shm_bloom_clear(context);
+    shm_dedup_clear(context);
+    shm_chain_clear(context);
     context->memory->hashtable.count = 0;
-    shm_list_init(context);
+    context->memory->hashtable.stale = 0;
+    for (i=0; i<context->memory->namespaces.count; i++) {
+        ns = SHM_NS_PTR(context, i);
+        shm_list_init(&ns->head);
+        ns->count = 0;
+        ns->stale = 0;
+        ns->used = 0;
+    }
 
     shm_object_pool_init_empty(&context->value_allocator.doing);
     shm_object_pool_init_empty(&context->value_allocator.done);
@@ -257,3 +996,113 @@ int shm_ht_clear(struct shmcache_context *context)
             __LINE__, context->pid, ht_count);
     return ht_count;
 }
+
+//remove all entries of the namespace at once
+static int shm_ht_purge_ns(struct shmcache_context *context,
+        const int ns_index)
+{
+    struct shm_namespace *ns;
+    int64_t entry_offset;
+    struct shm_hash_entry *entry;
+    bool recycled;
+    int count;
+
+    ns = SHM_NS_PTR(context, ns_index);
+    count = 0;
+    while ((entry_offset=shm_list_first(&ns->head)) > 0) {
+        entry = shm_get_hentry_ptr(context, entry_offset);
+        recycled = false;
+        shm_ht_delete_entry(context, entry, entry_offset, &recycled);
+        count++;
+    }
+    return count;
+}
+
+int shm_ht_flush_ns(struct shmcache_context *context, const int ns_index)
+{
+    struct shm_namespace *ns;
+    int64_t entry_offset;
+    struct shm_hash_entry *entry;
+    uint32_t generation;
+    int ht_count;
+
+    ns = SHM_NS_PTR(context, ns_index);
+    ns->stats.last_clear_time = get_current_time();
+    generation = (ns->generation + 1) & HT_GENERATION_MASK;
+    if ((entry_offset=shm_list_first(&ns->head)) > 0) {
+        entry = shm_get_hentry_ptr(context, entry_offset);
+        if (entry != NULL && entry->generation == generation) {
+            //the generation wraps around before the oldest entry reaped
+            ht_count = ns->count - ns->stale;
+            shm_ht_purge_ns(context, ns_index);
+            return ht_count;
+        }
+    }
+
+    ht_count = ns->count - ns->stale;
+    context->memory->hashtable.stale += ht_count;
+    ns->stale = ns->count;
+    ns->generation = generation;
+
+    logInfo("file: "__FILE__", line: %d, pid: %d, "
+            "flush namespace: %s, generation: %u, %d entries be cleared, "
+            "%d stale entries to reap", __LINE__, context->pid, ns->name,
+            generation, ht_count, ns->stale);
+    return ht_count;
+}
+
+int shm_ht_flush(struct shmcache_context *context)
+{
+    int ht_count;
+    int i;
+
+    context->memory->stats.hashtable.last_clear_time =
+        context->memory->stats.last.calc_time = get_current_time();
+    ht_count = 0;
+    for (i=0; i<context->memory->namespaces.count; i++) {
+        ht_count += shm_ht_flush_ns(context, i);
+    }
+    return ht_count;
+}
+
+int shm_ht_reap(struct shmcache_context *context, const int max_count)
+{
+    struct shm_namespace *ns;
+    int64_t entry_offset;
+    struct shm_hash_entry *entry;
+    bool recycled;
+    int count;
+    int i;
+
+    count = 0;
+    for (i=0; i<context->memory->namespaces.count &&
+            count < max_count; i++)
+    {
+        ns = SHM_NS_PTR(context, i);
+        while (count < max_count && ns->stale > 0) {
+            //the stale entries are older than the current entries
+            if ((entry_offset=shm_list_first(&ns->head)) <= 0) {
+                break;
+            }
+            entry = shm_get_hentry_ptr(context, entry_offset);
+            if (entry == NULL) {
+                break;
+            }
+            if (HT_ENTRY_IS_CURRENT(context, entry)) {
+                logWarning("file: "__FILE__", line: %d, "
+                        "namespace: %s, the oldest entry is current, "
+                        "but stale count: %d, reset stale count to 0",
+                        __LINE__, ns->name, ns->stale);
+                context->memory->hashtable.stale -= ns->stale;
+                ns->stale = 0;
+                break;
+            }
+
+            recycled = false;
+            shm_ht_delete_entry(context, entry, entry_offset, &recycled);
+            count++;
+        }
+    }
+
+    return count;
+}
@@ -13,20 +13,103 @@
 #include "shmcache_types.h"
 #include "shm_list.h"
 #include "shm_value_allocator.h"
+#include "shm_namespace.h"
+#include "shm_tag.h"
 
 #define HT_CALC_EXPIRES(current_time, ttl) \
     (ttl == SHMCACHE_NEVER_EXPIRED ? 0 : current_time + ttl)
 
-#define HT_ENTRY_IS_VALID(entry, current_time) \
-    (entry->expires == 0 || entry->expires >= current_time)
+#define HT_EXPIRES_IS_VALID(expires, current_time) \
+    (expires == 0 || expires >= current_time)
+
+//the entry expires is relative to memory->init_time
+#define HT_ENTRY_EXPIRES(context, entry) \
+    (entry->expires == 0 ? 0 : context->memory->init_time + entry->expires)
+
+#define HT_ENTRY_IS_VALID(context, entry, current_time) \
+    (entry->expires == 0 || HT_ENTRY_EXPIRES(context, entry) >= current_time)
+
+//the entry generation is 16 bits
+#define HT_GENERATION_MASK  0xFFFF
+
+//the entries of the old generations of its namespace are stale (cleared)
+#define HT_ENTRY_IS_CURRENT(context, entry) \
+    (entry->generation == SHM_NS_PTR(context, entry->ns)->generation)
+
+//reap stale entries once when set
+#define HT_REAP_STALE_ONCE  16
+
+//the range operations of shm_ht_write_range
+#define HT_RANGE_APPEND   1
+#define HT_RANGE_PREPEND  2
+#define HT_RANGE_SET      3
+
+//the value capacity when relocated for range write, the slack is
+//for the following appends in place
+#define HT_VALUE_GROW_CAPACITY(length) ((length) + (length) / 2)
+
+//another reader is elected when the refresher does not set in time
+#define HT_SOFT_TTL_REFRESH_TIMEOUT  10
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+//convert the unix timestamp to the relative expires of the entry
+static inline uint32_t shm_ht_relative_expires(
+        struct shmcache_context *context, const int64_t expires)
+{
+    int64_t relative;
+
+    if (expires == SHMCACHE_NEVER_EXPIRED) {
+        return 0;
+    }
+    relative = expires - context->memory->init_time;
+    if (relative <= 0) {
+        return 1;  //already expired
+    } else if (relative > UINT32_MAX) {
+        return UINT32_MAX;
+    }
+    return relative;
+}
+
+//the hash of the integer key, the finalizer of MurmurHash3
+static inline unsigned int shm_ht_int_key_hash(const int64_t key)
+{
+    uint64_t h;
+
+    h = (uint64_t)key;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return (unsigned int)h;
+}
+
+//the soft ttl follows the value of the entry
+static inline struct shm_soft_ttl *shm_ht_get_soft_ttl(
+        struct shmcache_context *context, struct shm_hash_entry *entry)
+{
+    return (struct shm_soft_ttl *)(shm_get_value_ptr(context, entry) +
+            MEM_ALIGN(entry->value.length));
+}
+
+//the value can grow in place within the capacity, the soft ttl and
+//the tag refs follow the aligned value, so no slack for them
+static inline int shm_ht_value_capacity(struct shm_hash_entry *entry)
+{
+    if (entry->flags != 0) {
+        return MEM_ALIGN(entry->value.length);
+    }
+    return entry->size - sizeof(struct shm_hash_entry) -
+        MEM_ALIGN(entry->key_len);
+}
+
+//the bucket stores the 32 bits entry offset, keep the next area aligned
 static inline int64_t shm_ht_get_memory_size(const int capacity)
 {
-    return sizeof(int64_t) * (int64_t)capacity;
+    return MEM_ALIGN(sizeof(uint32_t) * (int64_t)capacity);
 }
 
 /**
@@ -47,29 +130,195 @@ return none
 void shm_ht_init(struct shmcache_context *context, const int capacity);
 
 /**
-set value
+set value to the namespace
+parameters:
+	context: the context pointer
+    ns_index: the namespace index
+    key: the key
+    value: the value, include expires field (the hard expires)
+    soft_expires: the soft expire time, 0 for none
+    tag_slots: the tag slots, can be NULL
+    tag_count: the tag count, <= SHMCACHE_MAX_TAGS
+return error no, 0 for success, != 0 for fail
+*/
+int shm_ht_set_ex(struct shmcache_context *context, const int ns_index,
+        const struct shmcache_key_info *key,
+        const struct shmcache_value_info *value, const int64_t soft_expires,
+        const uint32_t *tag_slots, const int tag_count);
+
+/**
+set value to the namespace in use
 parameters:
 	context: the context pointer
     key: the key
     value: the value, include expires field
 return error no, 0 for success, != 0 for fail
 */
-int shm_ht_set(struct shmcache_context *context,
+static inline int shm_ht_set(struct shmcache_context *context,
         const struct shmcache_key_info *key,
-        const struct shmcache_value_info *value);
+        const struct shmcache_value_info *value)
+{
+    return shm_ht_set_ex(context, context->ns_index, key, value, 0, NULL, 0);
+}
 
 /**
-get value
+set the tombstone (negative entry) of the key to the namespace in use,
+the tombstone has no value bytes and replaces the old value
+parameters:
+	context: the context pointer
+    key: the key
+    expires: the expire time of the tombstone
+return error no, 0 for success, != 0 for fail
+*/
+int shm_ht_set_tombstone(struct shmcache_context *context,
+        const struct shmcache_key_info *key, const int64_t expires);
+
+/**
+get value, the value between the soft and the hard expires is returned
+with value->stale set, the chained value is assembled in the buffer of
+the calling thread, see shm_chain_assemble
+parameters:
+	context: the context pointer
+    key: the key
+    value: store the returned value
+    elect_refresher: if elect the caller to refresh the soft expired value,
+        only one caller is elected in HT_SOFT_TTL_REFRESH_TIMEOUT seconds
+return error no, 0 for success, ENODATA for the tombstone,
+    ENOENT for the expired tombstone, ETIMEDOUT for the expired value,
+    != 0 for fail
+*/
+int shm_ht_get_ex(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        struct shmcache_value_info *value, const bool elect_refresher);
+
+/**
+get value for internal usage, never elect the refresher
 parameters:
 	context: the context pointer
     key: the key
     value: store the returned value
 return error no, 0 for success, != 0 for fail
 */
-int shm_ht_get(struct shmcache_context *context,
+static inline int shm_ht_get(struct shmcache_context *context,
         const struct shmcache_key_info *key,
+        struct shmcache_value_info *value)
+{
+    return shm_ht_get_ex(context, key, value, false);
+}
+
+/**
+set value of the integer key to the namespace, the key is stored as
+8 bytes and compared at once
+parameters:
+	context: the context pointer
+    ns_index: the namespace index
+    key: the integer key
+    value: the value, include expires field
+return error no, 0 for success, != 0 for fail
+*/
+int shm_ht_set_int(struct shmcache_context *context, const int ns_index,
+        const int64_t key, const struct shmcache_value_info *value);
+
+/**
+get value of the integer key without lock
+parameters:
+	context: the context pointer
+    key: the integer key
+    value: store the returned value
+return error no, 0 for success, != 0 for fail
+*/
+int shm_ht_get_int(struct shmcache_context *context, const int64_t key,
         struct shmcache_value_info *value);
 
+/**
+delete the integer key
+parameters:
+	context: the context pointer
+    key: the integer key
+    recycled: if recycled
+return error no, 0 for success, != 0 for fail
+*/
+int shm_ht_delete_int(struct shmcache_context *context, const int64_t key,
+        bool *recycled);
+
+/**
+find the entry of the key in the namespace, for internal usage
+parameters:
+	context: the context pointer
+    ns_index: the namespace index
+    key: the key
+    entry_offset: return the entry offset
+return the entry, NULL for not exist,
+    the caller should check if the entry is valid
+*/
+struct shm_hash_entry *shm_ht_find(struct shmcache_context *context,
+        const int ns_index, const struct shmcache_key_info *key,
+        int64_t *entry_offset);
+
+/**
+find the valid entry of the key in the namespace in use: not cleared,
+not expired, no tag invalidated and not a tombstone, for internal usage
+parameters:
+	context: the context pointer
+    key: the key
+    entry_offset: return the entry offset
+return the entry, NULL for not exist or invalid
+*/
+struct shm_hash_entry *shm_ht_find_valid(struct shmcache_context *context,
+        const struct shmcache_key_info *key, int64_t *entry_offset);
+
+/**
+update the expires of the key in place without realloc,
+the caller should hold the lock
+parameters:
+	context: the context pointer
+    key: the key
+    expires: the new expire time (the hard expires),
+        the soft expires is not changed
+return error no, 0 for success, ENOENT for not exist or expired
+*/
+int shm_ht_touch(struct shmcache_context *context,
+        const struct shmcache_key_info *key, const int64_t expires);
+
+/**
+replace the value of the entry by a new entry with slack, keep the
+options, the expires, the soft ttl and the tags of the old entry,
+the caller should hold the lock
+parameters:
+	context: the context pointer
+    key: the key of the entry in the namespace in use
+    entry: the old entry
+    data: the new value, should NOT point to the share memory because
+        the old entry may be recycled when alloc
+    length: the new value length
+return error no, 0 for success, != 0 for fail
+*/
+int shm_ht_replace(struct shmcache_context *context,
+        const struct shmcache_key_info *key, struct shm_hash_entry *entry,
+        const char *data, const int length);
+
+/**
+append, prepend or overwrite the value of the key, grow in place when
+the entry has slack and only write after the value, relocate otherwise.
+the compressed value is uncompressed, written and compressed again by
+relocation. the caller should hold the lock
+parameters:
+	context: the context pointer
+    key: the key
+    op: HT_RANGE_APPEND, HT_RANGE_PREPEND or HT_RANGE_SET
+    offset: the offset to write for HT_RANGE_SET, the gap after
+        the value is filled with zero
+    data: the data to write
+    length: the data length
+    in_place: return if written in place
+return error no, 0 for success, ENOENT for not exist or expired,
+    EBADMSG for the corrupted compressed value
+*/
+int shm_ht_write_range(struct shmcache_context *context,
+        const struct shmcache_key_info *key, const int op,
+        const int offset, const char *data, const int length,
+        bool *in_place);
+
 /**
 delete the key for internal usage
 parameters:
@@ -96,7 +345,21 @@ static inline int shm_ht_delete(struct shmcache_context *context,
 }
 
 /**
-free hashtable entry
+remove the entry from the hashtable and free it, for internal usage
+parameters:
+	context: the context pointer
+    entry: the hashtable entry
+    entry_offset: the entry offset
+    recycled: if recycled
+return none
+*/
+void shm_ht_delete_entry(struct shmcache_context *context,
+        struct shm_hash_entry *entry, const int64_t entry_offset,
+        bool *recycled);
+
+/**
+free hashtable entry, the shared value is released by the refcount
+and the parts of the chained value are freed
 parameters:
 	context: the context pointer
     entry: the hashtable entry
@@ -116,9 +379,36 @@ return cleared entries count
 */
 int shm_ht_clear(struct shmcache_context *context);
 
+/**
+remove all entries of the namespace in O(1) by increasing its generation,
+the stale entries are reaped lazily
+parameters:
+	context: the context pointer
+    ns_index: the namespace index
+return cleared entries count
+*/
+int shm_ht_flush_ns(struct shmcache_context *context, const int ns_index);
+
+/**
+remove all hashtable entries of all namespaces in O(1)
+parameters:
+	context: the context pointer
+return cleared entries count
+*/
+int shm_ht_flush(struct shmcache_context *context);
+
+/**
+reap the stale entries from the oldest
+parameters:
+	context: the context pointer
+    max_count: max entries to reap
+return reaped entries count
+*/
+int shm_ht_reap(struct shmcache_context *context, const int max_count);
+
 static inline int shm_ht_count(struct shmcache_context *context)
 {
-    return context->memory->hashtable.count;
+    return context->memory->hashtable.count - context->memory->hashtable.stale;
 }
 
 #ifdef __cplusplus
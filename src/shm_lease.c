@@ -0,0 +1,111 @@
+//shm_lease.c
+
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "logger.h"
+#include "shared_func.h"
+#include "hash.h"
+#include "shm_lease.h"
+
+#define SHM_LEASE_KEY_HASH(ns_index, key) \
+    ((uint32_t)simple_hash_ex(key->data, key->length, ns_index + 1))
+
+#define SHM_LEASE_SLOT(context, key_hash) \
+    (context->memory->leases.slots + (key_hash) % SHM_LEASE_SLOT_COUNT)
+
+void shm_lease_init(struct shmcache_context *context)
+{
+    memset(&context->memory->leases, 0, sizeof(context->memory->leases));
+}
+
+static inline bool shm_lease_is_free(struct shmcache_context *context,
+        struct shm_lease *lease, const int64_t current_ms)
+{
+    if (lease->token == 0) {
+        return true;
+    }
+
+    //expired or the owner died without release
+    if (lease->expires_ms <= current_ms || (kill(lease->pid, 0) != 0
+                && errno == ESRCH))
+    {
+        context->memory->leases.stats.expire++;
+        return true;
+    }
+    return false;
+}
+
+static void shm_lease_wake(struct shm_lease *lease)
+{
+    __sync_add_and_fetch(&lease->wake_seq, 1);
+    syscall(SYS_futex, &lease->wake_seq, FUTEX_WAKE, INT_MAX,
+            NULL, NULL, 0);
+}
+
+int shm_lease_acquire(struct shmcache_context *context, const int ns_index,
+        const struct shmcache_key_info *key, const int lease_ms,
+        int64_t *token, uint32_t *wake_seq, int64_t *expires_ms)
+{
+    struct shm_lease *lease;
+    uint32_t key_hash;
+    int64_t current_ms;
+
+    key_hash = SHM_LEASE_KEY_HASH(ns_index, key);
+    lease = SHM_LEASE_SLOT(context, key_hash);
+    current_ms = get_current_time_ms();
+    if (!shm_lease_is_free(context, lease, current_ms)) {
+        if (lease->key_hash == key_hash && lease->ns == ns_index) {
+            *wake_seq = lease->wake_seq;
+            *expires_ms = lease->expires_ms;
+            return EINPROGRESS;
+        }
+        return EBUSY;
+    }
+
+    if (lease->token != 0) {  //wake up the waiters of the expired lease
+        shm_lease_wake(lease);
+    }
+    lease->pid = context->pid;
+    lease->key_hash = key_hash;
+    lease->ns = ns_index;
+    lease->expires_ms = current_ms + lease_ms;
+    lease->token = *token = ++context->memory->leases.token_seq;
+    context->memory->leases.stats.grant++;
+    return 0;
+}
+
+int shm_lease_release(struct shmcache_context *context, const int ns_index,
+        const struct shmcache_key_info *key, const int64_t token)
+{
+    struct shm_lease *lease;
+
+    lease = SHM_LEASE_SLOT(context, SHM_LEASE_KEY_HASH(ns_index, key));
+    if (token == 0 || lease->token != token) {
+        return EAGAIN;
+    }
+
+    lease->token = 0;
+    lease->pid = 0;
+    shm_lease_wake(lease);
+    return 0;
+}
+
+void shm_lease_wait(struct shmcache_context *context, const int ns_index,
+        const struct shmcache_key_info *key, const uint32_t wake_seq,
+        const int timeout_ms)
+{
+    struct shm_lease *lease;
+    struct timespec ts;
+
+    lease = SHM_LEASE_SLOT(context, SHM_LEASE_KEY_HASH(ns_index, key));
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000 * 1000;
+
+    //the futex of the share memory is NOT private
+    syscall(SYS_futex, &lease->wake_seq, FUTEX_WAIT, wake_seq,
+            &ts, NULL, 0);
+}
@@ -0,0 +1,75 @@
+//shm_lease.h
+
+#ifndef _SHM_LEASE_H
+#define _SHM_LEASE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "common_define.h"
+#include "shmcache_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+leases init when the share memory created
+parameters:
+	context: the context pointer
+return none
+*/
+void shm_lease_init(struct shmcache_context *context);
+
+/**
+acquire the fill lease of the key, the caller should hold the lock
+parameters:
+	context: the context pointer
+    ns_index: the namespace index
+    key: the key
+    lease_ms: the lease time in milliseconds
+    token: return the fill token when granted
+    wake_seq: return the wake sequence to wait when filling by others
+    expires_ms: return the lease expire time when filling by others
+return error no:
+    0 for the lease granted,
+    EINPROGRESS for the key is filling by another process,
+    EBUSY for the lease slot is used by another key
+*/
+int shm_lease_acquire(struct shmcache_context *context, const int ns_index,
+        const struct shmcache_key_info *key, const int lease_ms,
+        int64_t *token, uint32_t *wake_seq, int64_t *expires_ms);
+
+/**
+release the lease and wake up the waiters, the caller should hold the lock
+parameters:
+	context: the context pointer
+    ns_index: the namespace index
+    key: the key
+    token: the fill token
+return error no, 0 for success, EAGAIN for the lease is lost
+    (expired and acquired by another process)
+*/
+int shm_lease_release(struct shmcache_context *context, const int ns_index,
+        const struct shmcache_key_info *key, const int64_t token);
+
+/**
+wait for the lease released without lock
+parameters:
+	context: the context pointer
+    ns_index: the namespace index
+    key: the key
+    wake_seq: the wake sequence returned by shm_lease_acquire
+    timeout_ms: the wait timeout in milliseconds
+return none
+*/
+void shm_lease_wait(struct shmcache_context *context, const int ns_index,
+        const struct shmcache_key_info *key, const uint32_t wake_seq,
+        const int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
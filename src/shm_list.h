@@ -11,87 +11,92 @@
 #include "logger.h"
 #include "shmcache_types.h"
 #include "shm_value_allocator.h"
+#include "shm_checkpoint.h"
+
+//the offset of the list head, the entry offsets are not 0
+#define SHM_LIST_HEAD_OFFSET  0
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 static inline struct shm_list *shm_list_ptr(struct shmcache_context *context,
-        int64_t obj_offset)
+        struct shm_list *head, int64_t obj_offset)
 {
-    if (obj_offset == context->list.head.offset) {
-        return context->list.head.ptr;
+    if (obj_offset == SHM_LIST_HEAD_OFFSET) {
+        return head;
     } else {
         return (struct shm_list *)shm_get_hentry_ptr(context, obj_offset);
     }
 }
 
-#define SHM_LIST_TYPE_PTR(context, type, offset) ((type *)shm_list_ptr(context, offset))
+#define SHM_LIST_TYPE_PTR(context, head, type, offset) \
+    ((type *)shm_list_ptr(context, head, offset))
 
-/**
-list set
-parameters:
-	list: the list
-return none
-*/
-static inline void shm_list_set(struct shmcache_context *context,
-        char *base, struct shm_list *head)
+//mark the striping of the entry node modified for checkpoint
+static inline void shm_list_mark_dirty(struct shmcache_context *context,
+        const int64_t obj_offset)
 {
-    union shm_hentry_offset conv;
-    conv.segment.index = -1;
-    conv.segment.offset = (char *)head - base;
-
-    context->list.head.ptr = head;
-    context->list.head.offset = conv.offset;
+    if (obj_offset != SHM_LIST_HEAD_OFFSET) {
+        shm_checkpoint_mark_entry(context, obj_offset);
+    }
 }
 
 /**
 init list to empty
 parameters:
-	list: the list
+	head: the list head
 return none
 */
-static inline void shm_list_init(struct shmcache_context *context)
+static inline void shm_list_init(struct shm_list *head)
 {
-    context->list.head.ptr->prev = context->list.head.offset;
-    context->list.head.ptr->next = context->list.head.offset;
+    head->prev = SHM_LIST_HEAD_OFFSET;
+    head->next = SHM_LIST_HEAD_OFFSET;
 }
 
-#define SHM_LIST_ADD_TO_TAIL(context, node, obj_offset) \
+#define SHM_LIST_ADD_TO_TAIL(context, head, node, obj_offset) \
     do { \
-        node->next = context->list.head.offset;    \
-        node->prev = context->list.head.ptr->prev; \
-        shm_list_ptr(context, context->list.head.ptr->prev)->next = obj_offset; \
-        context->list.head.ptr->prev = obj_offset; \
+        int64_t tail_offset;                       \
+        tail_offset = (head)->prev;                \
+        node->next = SHM_LIST_HEAD_OFFSET;         \
+        node->prev = tail_offset;                  \
+        shm_list_ptr(context, head, tail_offset)->next = obj_offset; \
+        (head)->prev = obj_offset;                 \
+        shm_list_mark_dirty(context, obj_offset);  \
+        shm_list_mark_dirty(context, tail_offset); \
     } while (0)
 
 /**
 add an element to list tail
 parameters:
-	list: the list
+	context: the context pointer
+	head: the list head
     obj_offset: the object offset
 return none
 */
-static inline void shm_list_add_tail(struct shmcache_context *context, int64_t obj_offset)
+static inline void shm_list_add_tail(struct shmcache_context *context,
+        struct shm_list *head, int64_t obj_offset)
 {
     struct shm_list *node;
 
-    node = shm_list_ptr(context, obj_offset);
-    SHM_LIST_ADD_TO_TAIL(context, node, obj_offset);
+    node = shm_list_ptr(context, head, obj_offset);
+    SHM_LIST_ADD_TO_TAIL(context, head, node, obj_offset);
 }
 
 /**
 remove an element from list
 parameters:
-	list: the list
+	context: the context pointer
+	head: the list head
     obj_offset: the object offset
 return none
 */
-static inline void shm_list_delete(struct shmcache_context *context, int64_t obj_offset)
+static inline void shm_list_delete(struct shmcache_context *context,
+        struct shm_list *head, int64_t obj_offset)
 {
     struct shm_list *node;
 
-    node = shm_list_ptr(context, obj_offset);
+    node = shm_list_ptr(context, head, obj_offset);
     if (node->next == obj_offset) {
         logError("file: " __FILE__", line: %d, "
                 "do NOT need remove from list, obj: %" PRId64,
@@ -99,67 +104,76 @@ static inline void shm_list_delete(struct shmcache_context *context, int64_t obj
         return;
     }
 
-    shm_list_ptr(context, node->prev)->next = node->next;
-    shm_list_ptr(context, node->next)->prev = node->prev;
+    shm_list_ptr(context, head, node->prev)->next = node->next;
+    shm_list_ptr(context, head, node->next)->prev = node->prev;
+    shm_list_mark_dirty(context, node->prev);
+    shm_list_mark_dirty(context, node->next);
     node->prev = node->next = obj_offset;
+    shm_list_mark_dirty(context, obj_offset);
 }
 
 /**
 move an element to tail
 parameters:
-	list: the list
+	context: the context pointer
+	head: the list head
     obj_offset: the object offset
 return none
 */
-static inline void shm_list_move_tail(struct shmcache_context *context, int64_t obj_offset)
+static inline void shm_list_move_tail(struct shmcache_context *context,
+        struct shm_list *head, int64_t obj_offset)
 {
     struct shm_list *node;
 
-    node = shm_list_ptr(context, obj_offset);
-    shm_list_ptr(context, node->prev)->next = node->next;
-    shm_list_ptr(context, node->next)->prev = node->prev;
+    node = shm_list_ptr(context, head, obj_offset);
+    shm_list_ptr(context, head, node->prev)->next = node->next;
+    shm_list_ptr(context, head, node->next)->prev = node->prev;
+    shm_list_mark_dirty(context, node->prev);
+    shm_list_mark_dirty(context, node->next);
 
-    SHM_LIST_ADD_TO_TAIL(context, node, obj_offset);
+    SHM_LIST_ADD_TO_TAIL(context, head, node, obj_offset);
 }
 
 /**
 is empty
 parameters:
-	list: the list
+	head: the list head
 return true for empty, false for NOT empty
 */
-static inline bool shm_list_empty(struct shmcache_context *context)
+static inline bool shm_list_empty(struct shm_list *head)
 {
-    return (context->list.head.ptr->next == context->list.head.offset);
+    return (head->next == SHM_LIST_HEAD_OFFSET);
 }
 
 /**
 get first element
 parameters:
-	list: the list
+	head: the list head
 return first object offset
 */
-static inline int64_t shm_list_first(struct shmcache_context *context)
+static inline int64_t shm_list_first(struct shm_list *head)
 {
-    if (context->list.head.ptr->next == context->list.head.offset) {  //empty
+    if (head->next == SHM_LIST_HEAD_OFFSET) {  //empty
         return -1;
     }
 
-    return context->list.head.ptr->next;
+    return head->next;
 }
 
 /**
 get next element
 parameters:
-	list: the list
+	context: the context pointer
+	head: the list head
+    current_offset: the current object offset
 return next object offset
 */
 static inline int64_t shm_list_next(struct shmcache_context *context,
-        const int64_t current_offset)
+        struct shm_list *head, const int64_t current_offset)
 {
     struct shm_list *node;
-    node = shm_list_ptr(context, current_offset);
-    if (node->next == context->list.head.offset) {
+    node = shm_list_ptr(context, head, current_offset);
+    if (node->next == SHM_LIST_HEAD_OFFSET) {
         return -1;
     }
     return node->next;
@@ -168,29 +182,31 @@ static inline int64_t shm_list_next(struct shmcache_context *context,
 /**
 get count
 parameters:
-	list: the list
+	context: the context pointer
+	head: the list head
 return count
 */
-static inline int shm_list_count(struct shmcache_context *context)
+static inline int shm_list_count(struct shmcache_context *context,
+        struct shm_list *head)
 {
     int64_t offset;
     int count;
 
     count = 0;
-    offset = context->list.head.ptr->next;
-    while (offset != context->list.head.offset) {
+    offset = head->next;
+    while (offset != SHM_LIST_HEAD_OFFSET) {
         count++;
-        offset = shm_list_ptr(context, offset)->next;
+        offset = shm_list_ptr(context, head, offset)->next;
     }
 
     return count;
 }
 
-#define SHM_LIST_FOR_EACH(context, current, member) \
-    for (current=SHM_LIST_TYPE_PTR(context, typeof(*current),    \
-                context->list.head.ptr->next);                      \
-            &current->member != context->list.head.ptr;             \
-            current=SHM_LIST_TYPE_PTR(context, typeof(*current), \
+#define SHM_LIST_FOR_EACH(context, head, current, member) \
+    for (current=SHM_LIST_TYPE_PTR(context, head, typeof(*current), \
+                (head)->next);                                      \
+            &current->member != (head);                             \
+            current=SHM_LIST_TYPE_PTR(context, head, typeof(*current), \
                 current->member.next))
 
 #ifdef __cplusplus
@@ -198,4 +214,3 @@ static inline int shm_list_count(struct shmcache_context *context)
 #endif
 
 #endif
-
@@ -8,6 +8,7 @@
 #include "shared_func.h"
 #include "sched_thread.h"
 #include "shm_hashtable.h"
+#include "shm_checkpoint.h"
 #include "shm_lock.h"
 
 int shm_lock_init(struct shmcache_context *context)
@@ -105,6 +106,7 @@ static int shm_detect_deadlock(struct shmcache_context *context,
 
     if (last_pid == context->memory->lock.pid) {
         context->memory->lock.pid = 0;
+        shm_checkpoint_before_write(context);
         if (shm_ht_clear(context) > 0) {
             if (context->config.va_policy.sleep_us_when_recycle_valid_entries > 0) {
                 usleep(context->config.va_policy.sleep_us_when_recycle_valid_entries);
@@ -159,6 +161,7 @@ int shm_lock(struct shmcache_context *context)
     }
     if (result == 0) {
         context->memory->lock.pid = context->pid;
+        shm_checkpoint_before_write(context);
     } else {
         logError("file: "__FILE__", line: %d, "
                 "call pthread_mutex_trylock fail, "
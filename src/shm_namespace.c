@@ -0,0 +1,142 @@
+//shm_namespace.c
+
+#include <errno.h>
+#include "logger.h"
+#include "shared_func.h"
+#include "sched_thread.h"
+#include "shm_list.h"
+#include "shm_hashtable.h"
+#include "shm_namespace.h"
+
+static void shm_ns_init_item(struct shm_namespace *ns,
+        const char *name, const int64_t quota)
+{
+    memset(ns, 0, sizeof(*ns));
+    snprintf(ns->name, sizeof(ns->name), "%s", name);
+    ns->quota = quota;
+    shm_list_init(&ns->head);
+}
+
+void shm_ns_init(struct shmcache_context *context)
+{
+    memset(&context->memory->namespaces, 0,
+            sizeof(context->memory->namespaces));
+    shm_ns_init_item(SHM_NS_PTR(context, SHM_NS_DEFAULT_INDEX),
+            SHMCACHE_DEFAULT_NAMESPACE, 0);
+    context->memory->namespaces.count = 1;
+}
+
+int shm_ns_find(struct shmcache_context *context, const char *name)
+{
+    int i;
+
+    for (i=0; i<context->memory->namespaces.count; i++) {
+        if (strcmp(SHM_NS_PTR(context, i)->name, name) == 0) {
+            return i;
+        }
+    }
+    return -ENOENT;
+}
+
+int shm_ns_sync_config(struct shmcache_context *context)
+{
+    int i;
+    int ns_index;
+    struct shm_namespace *ns;
+
+    for (i=0; i<context->config.namespaces.count; i++) {
+        ns_index = shm_ns_find(context, context->config.namespaces.items[i].name);
+        if (ns_index >= 0) {
+            ns = SHM_NS_PTR(context, ns_index);
+            if (ns->quota != context->config.namespaces.items[i].quota) {
+                logInfo("file: "__FILE__", line: %d, pid: %d, "
+                        "namespace: %s, change quota from %"PRId64
+                        " to %"PRId64, __LINE__, context->pid, ns->name,
+                        ns->quota, context->config.namespaces.items[i].quota);
+                ns->quota = context->config.namespaces.items[i].quota;
+            }
+            continue;
+        }
+
+        if (context->memory->namespaces.count >= SHMCACHE_MAX_NAMESPACES) {
+            logError("file: "__FILE__", line: %d, "
+                    "create namespace: %s fail, "
+                    "exceeds max namespace count: %d", __LINE__,
+                    context->config.namespaces.items[i].name,
+                    SHMCACHE_MAX_NAMESPACES);
+            return ENOSPC;
+        }
+
+        ns = SHM_NS_PTR(context, context->memory->namespaces.count);
+        shm_ns_init_item(ns, context->config.namespaces.items[i].name,
+                context->config.namespaces.items[i].quota);
+        context->memory->namespaces.count++;
+        logInfo("file: "__FILE__", line: %d, pid: %d, "
+                "create namespace #%d: %s, quota: %"PRId64, __LINE__,
+                context->pid, context->memory->namespaces.count - 1,
+                ns->name, ns->quota);
+    }
+
+    return 0;
+}
+
+int shm_ns_reserve(struct shmcache_context *context,
+        const int ns_index, const int size)
+{
+    struct shm_namespace *ns;
+    int64_t entry_offset;
+    struct shm_hash_entry *entry;
+    bool recycled;
+
+    ns = SHM_NS_PTR(context, ns_index);
+    if (ns->quota <= 0 || ns->used + size <= ns->quota) {
+        return 0;
+    }
+    if (size > ns->quota) {
+        logError("file: "__FILE__", line: %d, "
+                "namespace: %s, entry size: %d exceeds the quota: %"PRId64,
+                __LINE__, ns->name, size, ns->quota);
+        return ENOSPC;
+    }
+
+    //FIFO eviction inside the namespace, other namespaces are not touched
+    while (ns->used + size > ns->quota &&
+            (entry_offset=shm_list_first(&ns->head)) > 0)
+    {
+        entry = shm_get_hentry_ptr(context, entry_offset);
+        recycled = false;
+        shm_ht_delete_entry(context, entry, entry_offset, &recycled);
+        ns->stats.recycle++;
+    }
+
+    return 0;
+}
+
+int shm_ns_get_victim(struct shmcache_context *context)
+{
+    struct shm_namespace *ns;
+    struct shm_hash_entry *entry;
+    int64_t entry_offset;
+    int64_t min_version;
+    int victim;
+    int i;
+
+    //the entries are allocated from the stripings in the order of the
+    //versions (renewed by the in-place write), so the oldest head is
+    //the first one to empty a striping
+    victim = -1;
+    min_version = 0;
+    for (i=0; i<context->memory->namespaces.count; i++) {
+        ns = SHM_NS_PTR(context, i);
+        if ((entry_offset=shm_list_first(&ns->head)) <= 0) {
+            continue;
+        }
+        entry = shm_get_hentry_ptr(context, entry_offset);
+        if (victim < 0 || entry->version < min_version) {
+            min_version = entry->version;
+            victim = i;
+        }
+    }
+
+    return victim;
+}
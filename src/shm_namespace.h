@@ -0,0 +1,79 @@
+//shm_namespace.h
+
+#ifndef _SHM_NAMESPACE_H
+#define _SHM_NAMESPACE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "common_define.h"
+#include "shmcache_types.h"
+
+//the index of the default namespace
+#define SHM_NS_DEFAULT_INDEX  0
+
+#define SHM_NS_PTR(context, ns_index) \
+    (context->memory->namespaces.items + (ns_index))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+init the namespace table with the default namespace when the share
+memory created, the caller should hold the lock
+parameters:
+	context: the context pointer
+return none
+*/
+void shm_ns_init(struct shmcache_context *context);
+
+/**
+create the namespaces of the config or update their quotas,
+the caller should hold the lock
+parameters:
+	context: the context pointer
+return error no, 0 for success, != 0 for fail
+*/
+int shm_ns_sync_config(struct shmcache_context *context);
+
+/**
+find the namespace by name
+parameters:
+	context: the context pointer
+    name: the namespace name
+return the namespace index, < 0 for not exist
+*/
+int shm_ns_find(struct shmcache_context *context, const char *name);
+
+/**
+evict the oldest entries of the namespace until the new entry fits the
+quota, the caller should hold the lock.
+the quota only bounds the alloc size of the live entries of the
+namespace, the memory of the evicted entries is reused only when the
+whole striping is recycled
+parameters:
+	context: the context pointer
+    ns_index: the namespace index
+    size: the alloc size of the new entry
+return error no, 0 for success, ENOSPC for the entry exceeds the quota
+*/
+int shm_ns_reserve(struct shmcache_context *context,
+        const int ns_index, const int size);
+
+/**
+get the namespace to evict entries from when the whole memory or the
+keys reach the limit, the namespace whose oldest entry is the oldest
+of all namespaces, so the stripings are recycled in the FIFO order
+parameters:
+	context: the context pointer
+return the namespace index, < 0 for all namespaces are empty
+*/
+int shm_ns_get_victim(struct shmcache_context *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,243 @@
+//shm_numa.c
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "logger.h"
+#include "shared_func.h"
+#include "shm_numa.h"
+
+#define SHM_NUMA_ONLINE_FILENAME  "/sys/devices/system/node/online"
+
+//the max sampled pages of one segment for placement
+#define SHM_NUMA_MAX_SAMPLE_PAGES  1024
+
+static long shm_numa_sys_mbind(void *addr, unsigned long len,
+        int mode, const unsigned long *nodemask, unsigned long maxnode,
+        unsigned int flags)
+{
+#ifdef SYS_mbind
+    return syscall(SYS_mbind, addr, len, mode, nodemask, maxnode, flags);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+shm_numa_mbind_func g_shm_numa_mbind = shm_numa_sys_mbind;
+
+int shm_numa_parse_policy(const char *name)
+{
+    if (name == NULL || *name == '\0' || strcasecmp(name, "none") == 0) {
+        return SHMCACHE_NUMA_POLICY_NONE;
+    } else if (strcasecmp(name, "interleave") == 0) {
+        return SHMCACHE_NUMA_POLICY_INTERLEAVE;
+    } else if (strcasecmp(name, "preferred") == 0) {
+        return SHMCACHE_NUMA_POLICY_PREFERRED;
+    } else if (strcasecmp(name, "round_robin") == 0 ||
+            strcasecmp(name, "round-robin") == 0)
+    {
+        return SHMCACHE_NUMA_POLICY_ROUND_ROBIN;
+    } else {
+        return -EINVAL;
+    }
+}
+
+const char *shm_numa_get_policy_name(const int policy)
+{
+    switch (policy) {
+        case SHMCACHE_NUMA_POLICY_INTERLEAVE:
+            return "interleave";
+        case SHMCACHE_NUMA_POLICY_PREFERRED:
+            return "preferred";
+        case SHMCACHE_NUMA_POLICY_ROUND_ROBIN:
+            return "round_robin";
+        default:
+            return "none";
+    }
+}
+
+int shm_numa_parse_nodes(const char *str, short *nodes, int *node_count)
+{
+    char buff[256];
+    char *p;
+    char *end;
+    long start;
+    long last;
+    long node;
+
+    *node_count = 0;
+    if (str == NULL || *str == '\0') {
+        FILE *fp;
+
+        //the content such as: 0-1, the file size of sysfs is not real
+        if ((fp=fopen(SHM_NUMA_ONLINE_FILENAME, "r")) == NULL) {
+            nodes[(*node_count)++] = 0;
+            return 0;
+        }
+        if (fgets(buff, sizeof(buff), fp) == NULL) {
+            *buff = '\0';
+        }
+        fclose(fp);
+    } else {
+        snprintf(buff, sizeof(buff), "%s", str);
+    }
+
+    p = buff;
+    while (*p != '\0') {
+        while (*p == ' ' || *p == ',' || *p == '\n') {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+
+        start = strtol(p, &end, 10);
+        if (end == p) {
+            logError("file: "__FILE__", line: %d, "
+                    "invalid NUMA nodes: %s", __LINE__, buff);
+            return EINVAL;
+        }
+        p = end;
+        last = start;
+        if (*p == '-') {
+            p++;
+            last = strtol(p, &end, 10);
+            if (end == p) {
+                logError("file: "__FILE__", line: %d, "
+                        "invalid NUMA nodes: %s", __LINE__, buff);
+                return EINVAL;
+            }
+            p = end;
+        }
+
+        if (start < 0 || last < start || last >= SHMCACHE_MAX_NUMA_NODES) {
+            logError("file: "__FILE__", line: %d, "
+                    "invalid NUMA nodes: %s, node should in [0, %d)",
+                    __LINE__, buff, SHMCACHE_MAX_NUMA_NODES);
+            return EINVAL;
+        }
+        for (node=start; node<=last; node++) {
+            if (*node_count >= SHMCACHE_MAX_NUMA_NODES) {
+                return 0;
+            }
+            nodes[(*node_count)++] = node;
+        }
+    }
+
+    if (*node_count == 0) {
+        nodes[(*node_count)++] = 0;
+    }
+    return 0;
+}
+
+int shm_numa_apply_policy(struct shmcache_context *context,
+        const int segment_index, void *addr, const int64_t size)
+{
+    int result;
+    int mode;
+    int i;
+    int node;
+    unsigned long nodemask[SHM_NUMA_MASK_LONGS];
+
+    if (context->config.numa.policy == SHMCACHE_NUMA_POLICY_NONE ||
+            context->config.numa.node_count <= 0)
+    {
+        return 0;
+    }
+
+    memset(nodemask, 0, sizeof(nodemask));
+    if (context->config.numa.policy == SHMCACHE_NUMA_POLICY_INTERLEAVE ||
+            (context->config.numa.policy == SHMCACHE_NUMA_POLICY_ROUND_ROBIN
+             && segment_index == SHM_NUMA_HASHTABLE_SEGMENT))
+    {
+        //the hashtable is accessed by all nodes
+        mode = SHM_NUMA_MPOL_INTERLEAVE;
+        for (i=0; i<context->config.numa.node_count; i++) {
+            node = context->config.numa.nodes[i];
+            nodemask[node / (8 * sizeof(long))] |=
+                1UL << (node % (8 * sizeof(long)));
+        }
+    } else {
+        mode = SHM_NUMA_MPOL_PREFERRED;
+        if (context->config.numa.policy == SHMCACHE_NUMA_POLICY_ROUND_ROBIN) {
+            node = context->config.numa.nodes[segment_index %
+                context->config.numa.node_count];
+        } else {
+            node = context->config.numa.nodes[0];
+        }
+        nodemask[node / (8 * sizeof(long))] |=
+            1UL << (node % (8 * sizeof(long)));
+    }
+
+    //the kernel ignores the last bit of maxnode
+    if (g_shm_numa_mbind(addr, size, mode, nodemask,
+                SHMCACHE_MAX_NUMA_NODES + 1, 0) != 0)
+    {
+        result = errno != 0 ? errno : EPERM;
+        logWarning("file: "__FILE__", line: %d, pid: %d, "
+                "mbind segment #%d (0 for hashtable), size: %"PRId64", "
+                "policy: %s fail, errno: %d, error info: %s", __LINE__,
+                context->pid, segment_index + 1, size, shm_numa_get_policy_name(
+                    context->config.numa.policy), result, STRERROR(result));
+        return result;
+    }
+
+    logDebug("file: "__FILE__", line: %d, pid: %d, "
+            "mbind segment #%d (0 for hashtable), size: %"PRId64", "
+            "policy: %s, mode: %d, "
+            "nodemask: %lx", __LINE__, context->pid, segment_index + 1,
+            size, shm_numa_get_policy_name(context->config.numa.policy),
+            mode, nodemask[0]);
+    return 0;
+}
+
+int shm_numa_get_placement(void *addr, const int64_t size,
+        struct shmcache_numa_placement *placement)
+{
+#ifdef SYS_move_pages
+    int result;
+    int count;
+    int i;
+    int64_t step;
+    int page_size;
+    void *pages[SHM_NUMA_MAX_SAMPLE_PAGES];
+    int status[SHM_NUMA_MAX_SAMPLE_PAGES];
+
+    memset(placement, 0, sizeof(*placement));
+    page_size = getpagesize();
+    step = size / SHM_NUMA_MAX_SAMPLE_PAGES;
+    step = (step + page_size - 1) / page_size * page_size;
+    if (step < page_size) {
+        step = page_size;
+    }
+
+    count = 0;
+    while (count < SHM_NUMA_MAX_SAMPLE_PAGES && count * step < size) {
+        pages[count] = (char *)addr + count * step;
+        count++;
+    }
+
+    //query the nodes only, do NOT move the pages
+    if (syscall(SYS_move_pages, 0, count, pages, NULL, status, 0) != 0) {
+        result = errno != 0 ? errno : EPERM;
+        logError("file: "__FILE__", line: %d, "
+                "move_pages fail, errno: %d, error info: %s",
+                __LINE__, result, STRERROR(result));
+        return result;
+    }
+
+    placement->sampled = count;
+    for (i=0; i<count; i++) {
+        if (status[i] >= 0 && status[i] < SHMCACHE_MAX_NUMA_NODES) {
+            placement->pages[status[i]]++;
+        } else {
+            placement->absent++;
+        }
+    }
+    return 0;
+#else
+    memset(placement, 0, sizeof(*placement));
+    return EOPNOTSUPP;
+#endif
+}
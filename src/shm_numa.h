@@ -0,0 +1,91 @@
+//shm_numa.h
+
+#ifndef _SHM_NUMA_H
+#define _SHM_NUMA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "common_define.h"
+#include "shmcache_types.h"
+
+//the segment index of the hashtable segment
+#define SHM_NUMA_HASHTABLE_SEGMENT  -1
+
+//the memory policy modes, same as linux/mempolicy.h
+#define SHM_NUMA_MPOL_DEFAULT     0
+#define SHM_NUMA_MPOL_PREFERRED   1
+#define SHM_NUMA_MPOL_BIND        2
+#define SHM_NUMA_MPOL_INTERLEAVE  3
+
+#define SHM_NUMA_MASK_LONGS ((SHMCACHE_MAX_NUMA_NODES + 8 * sizeof(long) - 1) \
+        / (8 * sizeof(long)))
+
+//the signature of mbind(2)
+typedef long (*shm_numa_mbind_func)(void *addr, unsigned long len,
+        int mode, const unsigned long *nodemask, unsigned long maxnode,
+        unsigned int flags);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//the mbind function, can be replaced for testing
+extern shm_numa_mbind_func g_shm_numa_mbind;
+
+/**
+parse the NUMA policy name
+parameters:
+	name: the policy name: none, interleave, preferred or round_robin
+return the policy, < 0 for invalid name
+*/
+int shm_numa_parse_policy(const char *name);
+
+/**
+get the NUMA policy name
+parameters:
+	policy: the policy
+return the policy name
+*/
+const char *shm_numa_get_policy_name(const int policy);
+
+/**
+parse the node list such as "0,1" or "0-3", get the online nodes
+when the node list is empty
+parameters:
+	str: the node list, can be NULL
+    nodes: return the nodes
+    node_count: return the node count
+return error no, 0 for success, != 0 for fail
+*/
+int shm_numa_parse_nodes(const char *str, short *nodes, int *node_count);
+
+/**
+apply the NUMA policy to the new created segment before touching it
+parameters:
+	context: the context pointer
+    segment_index: the value segment index or SHM_NUMA_HASHTABLE_SEGMENT
+    addr: the segment base address
+    size: the segment size
+return error no, 0 for success, != 0 for fail
+*/
+int shm_numa_apply_policy(struct shmcache_context *context,
+        const int segment_index, void *addr, const int64_t size);
+
+/**
+get the node placement of the segment by sampling pages
+parameters:
+    addr: the segment base address
+    size: the segment size
+    placement: return the placement
+return error no, 0 for success, != 0 for fail
+*/
+int shm_numa_get_placement(void *addr, const int64_t size,
+        struct shmcache_numa_placement *placement);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,933 @@
+//shm_snapshot.c
+
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "logger.h"
+#include "shared_func.h"
+#include "pthread_func.h"
+#include "sched_thread.h"
+#include "hash.h"
+#include "shm_list.h"
+#include "shm_lock.h"
+#include "shm_hashtable.h"
+#include "shm_namespace.h"
+#include "shm_dedup.h"
+#include "shm_chain.h"
+#include "shm_snapshot.h"
+
+#define SHM_SNAPSHOT_MAX_BLOCK_SIZE  (1024 * 1024 * 1024)
+
+struct shm_snapshot_buffer {
+    char *data;
+    int size;    //buffer size
+    int length;  //data length
+    int count;   //record count
+};
+
+struct shm_snapshot_record {
+    int ns_index;  //the local namespace index, < 0 for not exist
+    int tag_count;
+    uint32_t tag_slots[SHMCACHE_MAX_TAGS];
+    int64_t soft_expires;
+    int64_t int_key;  //the int64 key when is_int_key
+    bool is_int_key;
+    struct shmcache_key_info key;
+    struct shmcache_value_info value;
+};
+
+struct shm_snapshot_loader {
+    struct shmcache_context *context;
+    const char *filename;
+    FILE *fp;
+    pthread_mutex_t lock;  //for read block from file
+    time_t current_time;
+    bool done;             //the last block has been read
+    int result;            //the first error
+    int64_t record_count;  //the total record count in the last block
+    int ns_count;          //the namespace count of the file
+    int ns_map[SHMCACHE_MAX_NAMESPACES];  //file index -> local index
+    struct shmcache_snapshot_stats stats;
+};
+
+static int shm_snapshot_check_buffer(struct shm_snapshot_buffer *buffer,
+        const int size)
+{
+    char *data;
+    int alloc_size;
+
+    if (buffer->size >= size) {
+        return 0;
+    }
+
+    alloc_size = buffer->size > 0 ? buffer->size : SHM_SNAPSHOT_BLOCK_SIZE;
+    while (alloc_size < size) {
+        alloc_size *= 2;
+    }
+    data = (char *)realloc(buffer->data, alloc_size);
+    if (data == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, alloc_size);
+        return ENOMEM;
+    }
+    buffer->data = data;
+    buffer->size = alloc_size;
+    return 0;
+}
+
+static int shm_snapshot_write(FILE *fp, const char *filename,
+        const char *data, const int length)
+{
+    int result;
+
+    if (fwrite(data, 1, length, fp) != length) {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "write to file: %s fail, "
+                "errno: %d, error info: %s", __LINE__,
+                filename, result, strerror(result));
+        return result;
+    }
+    return 0;
+}
+
+static int shm_snapshot_flush_block(FILE *fp, const char *filename,
+        struct shm_snapshot_buffer *buffer)
+{
+    int result;
+    char header[SHM_SNAPSHOT_BLOCK_HEADER_SIZE];
+
+    int2buff(buffer->count, header);
+    int2buff(buffer->length, header + 4);
+    int2buff(CRC32(buffer->data, buffer->length), header + 8);
+    if ((result=shm_snapshot_write(fp, filename, header,
+                    sizeof(header))) != 0)
+    {
+        return result;
+    }
+    if ((result=shm_snapshot_write(fp, filename, buffer->data,
+                    buffer->length)) != 0)
+    {
+        return result;
+    }
+
+    buffer->length = 0;
+    buffer->count = 0;
+    return 0;
+}
+
+//the entry collected under the lock
+struct shm_snapshot_dump_entry {
+    int64_t offset;
+    int64_t version;  //changed when the entry is rewritten or reused
+};
+
+//the entries collected under the lock, copied block by block
+struct shm_snapshot_dumper {
+    struct shm_snapshot_dump_entry *entries;
+    int count;
+    int index;    //the next entry to copy
+};
+
+static int shm_snapshot_collect_entries(struct shmcache_context *context,
+        struct shm_snapshot_dumper *dumper)
+{
+    int64_t offset;
+    int alloc_count;
+    int ns_index;
+    struct shm_namespace *ns;
+    struct shm_hash_entry *entry;
+
+    dumper->count = dumper->index = 0;
+    alloc_count = context->memory->hashtable.count;
+    if (alloc_count == 0) {
+        return 0;
+    }
+    dumper->entries = (struct shm_snapshot_dump_entry *)malloc(
+            sizeof(struct shm_snapshot_dump_entry) * alloc_count);
+    if (dumper->entries == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, (int)sizeof(
+                    struct shm_snapshot_dump_entry) * alloc_count);
+        return ENOMEM;
+    }
+
+    for (ns_index=0; ns_index<context->memory->namespaces.count;
+            ns_index++)
+    {
+        ns = SHM_NS_PTR(context, ns_index);
+        offset = ns->head.next;
+        while (offset != SHM_LIST_HEAD_OFFSET &&
+                dumper->count < alloc_count)
+        {
+            entry = shm_get_hentry_ptr(context, offset);
+            dumper->entries[dumper->count].offset = offset;
+            dumper->entries[dumper->count].version = entry->version;
+            dumper->count++;
+            offset = entry->list.next;
+        }
+    }
+    return 0;
+}
+
+//the entry is the collected one and still in the namespace list,
+//the offset maybe freed and reused by another entry or the value
+//of another entry since collected
+static bool shm_snapshot_entry_is_linked(struct shmcache_context *context,
+        struct shm_hash_entry *entry,
+        const struct shm_snapshot_dump_entry *collected)
+{
+    int64_t prev;
+
+    //rewritten, removed or reused since collected
+    if (entry->version != collected->version) {
+        return false;
+    }
+    if (entry->ns >= context->memory->namespaces.count ||
+            entry->key_len == 0 || entry->list.next == collected->offset)
+    {
+        return false;
+    }
+
+    prev = entry->list.prev;
+    if (prev != SHM_LIST_HEAD_OFFSET && (shm_get_hentry_segment(prev) < 0 ||
+                shm_get_hentry_segment_offset(prev) + sizeof(
+                    struct shm_hash_entry) > context->memory->
+                vm_info.segment.size || shm_get_hentry_ptr(
+                    context, prev) == NULL))
+    {
+        return false;
+    }
+    return shm_list_ptr(context, &SHM_NS_PTR(context, entry->ns)->head,
+            prev)->next == collected->offset;
+}
+
+//copy the entry to the buffer, return 0 for success, ENOENT for skipped
+static int shm_snapshot_copy_entry(struct shmcache_context *context,
+        struct shm_hash_entry *entry, struct shm_snapshot_buffer *buffer,
+        struct shmcache_snapshot_stats *stats, const time_t current_time)
+{
+    int result;
+    int record_size;
+    int value_len;
+    int tag_count;
+    int i;
+    struct shm_tag_refs *refs;
+    struct shmcache_value_info chained;
+    char *value;
+    char *p;
+
+    if (!(HT_ENTRY_IS_CURRENT(context, entry) &&
+                HT_ENTRY_IS_VALID(context, entry, current_time) &&
+                shm_tag_entry_is_valid(context, entry)))
+    {
+        stats->expired++;
+        return ENOENT;
+    }
+    //the tombstones are short-lived, not dumped
+    if ((entry->flags & SHM_HENTRY_FLAG_TOMBSTONE) != 0) {
+        stats->expired++;
+        return ENOENT;
+    }
+    //the shared value is dumped as the value of every entry
+    if ((entry->value.options & SHMCACHE_OPTIONS_CHAINED) != 0) {
+        chained.data = shm_get_value_ptr(context, entry);
+        chained.length = entry->value.length;
+        chained.options = entry->value.options;
+        if (shm_chain_assemble(context, &chained) != 0) {
+            stats->fail++;
+            return ENOENT;
+        }
+        value = chained.data;
+        value_len = chained.length;
+    } else if ((value=shm_dedup_entry_value(context, entry,
+                    &value_len)) == NULL)
+    {
+        stats->fail++;
+        return ENOENT;
+    }
+
+    if ((entry->flags & SHM_HENTRY_FLAG_TAGGED) != 0) {
+        refs = shm_tag_get_refs(context, entry);
+        tag_count = refs->count;
+    } else {
+        refs = NULL;
+        tag_count = 0;
+    }
+    record_size = SHM_SNAPSHOT_RECORD_HEADER_SIZE +
+        entry->key_len + value_len + 4 * tag_count;
+    if ((result=shm_snapshot_check_buffer(buffer,
+                    buffer->length + record_size)) != 0)
+    {
+        return result;
+    }
+
+    p = buffer->data + buffer->length;
+    *p++ = entry->key_len | ((entry->flags & SHM_HENTRY_FLAG_INT_KEY) != 0 ?
+            SHM_SNAPSHOT_INT_KEY_FLAG : 0);
+    *p++ = entry->ns;
+    *p++ = tag_count;
+    int2buff(entry->value.options & ~(SHMCACHE_OPTIONS_DEDUP |
+                SHMCACHE_OPTIONS_CHAINED), p);
+    p += 4;
+    int2buff(value_len, p);
+    p += 4;
+    long2buff(HT_ENTRY_EXPIRES(context, entry), p);
+    p += 8;
+    long2buff((entry->flags & SHM_HENTRY_FLAG_SOFT_TTL) != 0 ?
+            context->memory->init_time + shm_ht_get_soft_ttl(
+                context, entry)->expires : 0, p);
+    p += 8;
+    if ((entry->flags & SHM_HENTRY_FLAG_INT_KEY) != 0) {
+        long2buff(*(int64_t *)entry->key, p);
+    } else {
+        memcpy(p, entry->key, entry->key_len);
+    }
+    p += entry->key_len;
+    memcpy(p, value, value_len);
+    p += value_len;
+    for (i=0; i<tag_count; i++) {
+        int2buff(refs->items[i].slot, p);
+        p += 4;
+    }
+
+    buffer->length = p - buffer->data;
+    buffer->count++;
+    stats->success++;
+    return 0;
+}
+
+//copy the entries to the buffer until the block is full under the lock
+static int shm_snapshot_copy_block(struct shmcache_context *context,
+        struct shm_snapshot_dumper *dumper, struct shm_snapshot_buffer *buffer,
+        struct shmcache_snapshot_stats *stats)
+{
+    int result;
+    time_t current_time;
+    struct shm_snapshot_dump_entry *collected;
+    struct shm_hash_entry *entry;
+
+    if ((result=shm_lock(context)) != 0) {
+        return result;
+    }
+
+    current_time = get_current_time();
+    while (dumper->index < dumper->count &&
+            buffer->length < SHM_SNAPSHOT_BLOCK_SIZE)
+    {
+        collected = dumper->entries + dumper->index++;
+        stats->total++;
+        entry = shm_get_hentry_ptr(context, collected->offset);
+        if (!shm_snapshot_entry_is_linked(context, entry, collected)) {
+            stats->expired++;   //changed or removed since collected
+            continue;
+        }
+        result = shm_snapshot_copy_entry(context, entry, buffer,
+                stats, current_time);
+        if (!(result == 0 || result == ENOENT)) {
+            break;
+        }
+        result = 0;
+    }
+
+    shm_unlock(context);
+    return result;
+}
+
+static int shm_snapshot_dump_entries(struct shmcache_context *context,
+        FILE *fp, const char *filename, struct shm_snapshot_dumper *dumper,
+        struct shm_snapshot_buffer *buffer,
+        struct shmcache_snapshot_stats *stats)
+{
+    int result;
+
+    //the file is written without the lock
+    while (dumper->index < dumper->count) {
+        if ((result=shm_snapshot_copy_block(context, dumper,
+                        buffer, stats)) != 0)
+        {
+            return result;
+        }
+        if (buffer->count > 0) {
+            if ((result=shm_snapshot_flush_block(fp, filename,
+                            buffer)) != 0)
+            {
+                return result;
+            }
+        }
+    }
+
+    //the last block
+    long2buff(stats->success, buffer->data);
+    buffer->length = 8;
+    buffer->count = 0;
+    return shm_snapshot_flush_block(fp, filename, buffer);
+}
+
+static int shm_snapshot_dump_namespaces(struct shmcache_context *context,
+        struct shm_snapshot_buffer *buffer)
+{
+    struct shm_namespace *ns;
+    char *p;
+    int len;
+    int i;
+
+    p = buffer->data;
+    int2buff(context->memory->namespaces.count, p);
+    p += 4;
+    for (i=0; i<context->memory->namespaces.count; i++) {
+        ns = SHM_NS_PTR(context, i);
+        len = strlen(ns->name);
+        *p++ = len;
+        memcpy(p, ns->name, len);
+        p += len;
+    }
+    buffer->length = p - buffer->data;
+    return 0;
+}
+
+//collect the entries and copy the namespaces under the lock
+static int shm_snapshot_dump_prepare(struct shmcache_context *context,
+        struct shm_snapshot_dumper *dumper, struct shm_snapshot_buffer *buffer)
+{
+    int result;
+
+    if ((result=shm_lock(context)) != 0) {
+        return result;
+    }
+    if ((result=shm_snapshot_collect_entries(context, dumper)) == 0) {
+        result = shm_snapshot_dump_namespaces(context, buffer);
+    }
+    shm_unlock(context);
+    return result;
+}
+
+int shm_snapshot_dump(struct shmcache_context *context,
+        const char *filename, struct shmcache_snapshot_stats *stats)
+{
+    int result;
+    FILE *fp;
+    struct shm_snapshot_dumper dumper;
+    struct shm_snapshot_buffer buffer;
+    char tmp_filename[MAX_PATH_SIZE];
+    char header[SHM_SNAPSHOT_FILE_HEADER_SIZE];
+
+    memset(stats, 0, sizeof(*stats));
+    snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+    if ((fp=fopen(tmp_filename, "wb")) == NULL) {
+        result = errno != 0 ? errno : EPERM;
+        logError("file: "__FILE__", line: %d, "
+                "open file: %s fail, "
+                "errno: %d, error info: %s", __LINE__,
+                tmp_filename, result, strerror(result));
+        return result;
+    }
+
+    memset(&dumper, 0, sizeof(dumper));
+    memset(&buffer, 0, sizeof(buffer));
+    memcpy(header, SHM_SNAPSHOT_MAGIC_STR, SHM_SNAPSHOT_MAGIC_LEN);
+    int2buff(SHM_SNAPSHOT_VERSION, header + 8);
+    int2buff(0, header + 12);
+    long2buff(get_current_time(), header + 16);
+    do {
+        if ((result=shm_snapshot_check_buffer(&buffer,
+                        SHM_SNAPSHOT_BLOCK_SIZE)) != 0)
+        {
+            break;
+        }
+        if ((result=shm_snapshot_dump_prepare(context, &dumper,
+                        &buffer)) != 0)
+        {
+            break;
+        }
+        if ((result=shm_snapshot_write(fp, tmp_filename, header,
+                        sizeof(header))) != 0)
+        {
+            break;
+        }
+        if ((result=shm_snapshot_write(fp, tmp_filename, buffer.data,
+                        buffer.length)) != 0)
+        {
+            break;
+        }
+        buffer.length = 0;
+        if ((result=shm_snapshot_dump_entries(context, fp, tmp_filename,
+                        &dumper, &buffer, stats)) != 0)
+        {
+            break;
+        }
+        if (fflush(fp) != 0 || fsync(fileno(fp)) != 0) {
+            result = errno != 0 ? errno : EIO;
+            logError("file: "__FILE__", line: %d, "
+                    "sync file: %s fail, "
+                    "errno: %d, error info: %s", __LINE__,
+                    tmp_filename, result, strerror(result));
+        }
+    } while (0);
+
+    fclose(fp);
+    if (dumper.entries != NULL) {
+        free(dumper.entries);
+    }
+    if (buffer.data != NULL) {
+        free(buffer.data);
+    }
+
+    if (result == 0 && rename(tmp_filename, filename) != 0) {
+        result = errno != 0 ? errno : EPERM;
+        logError("file: "__FILE__", line: %d, "
+                "rename file: %s to %s fail, "
+                "errno: %d, error info: %s", __LINE__,
+                tmp_filename, filename, result, strerror(result));
+    }
+    if (result != 0) {
+        unlink(tmp_filename);
+    }
+    return result;
+}
+
+static int shm_snapshot_read(struct shm_snapshot_loader *loader,
+        char *buff, const int length)
+{
+    int result;
+
+    if (fread(buff, 1, length, loader->fp) == length) {
+        return 0;
+    }
+
+    if (ferror(loader->fp)) {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "read from file: %s fail, "
+                "errno: %d, error info: %s", __LINE__,
+                loader->filename, result, strerror(result));
+    } else {
+        result = EINVAL;
+        logError("file: "__FILE__", line: %d, "
+                "snapshot file: %s is truncated",
+                __LINE__, loader->filename);
+    }
+    return result;
+}
+
+//read one block under the loader lock, return ENOENT when no more block
+static int shm_snapshot_read_block(struct shm_snapshot_loader *loader,
+        struct shm_snapshot_buffer *buffer, int *crc32)
+{
+    int result;
+    char header[SHM_SNAPSHOT_BLOCK_HEADER_SIZE];
+
+    pthread_mutex_lock(&loader->lock);
+    do {
+        if (loader->done || loader->result != 0) {
+            result = ENOENT;
+            break;
+        }
+
+        if ((result=shm_snapshot_read(loader, header,
+                        sizeof(header))) != 0)
+        {
+            break;
+        }
+        buffer->count = buff2int(header);
+        buffer->length = buff2int(header + 4);
+        *crc32 = buff2int(header + 8);
+        if (buffer->count < 0 || buffer->length < 0 || buffer->length >
+                SHM_SNAPSHOT_MAX_BLOCK_SIZE || (buffer->count == 0 &&
+                    buffer->length != 8))
+        {
+            logError("file: "__FILE__", line: %d, "
+                    "snapshot file: %s, invalid block, record count: %d, "
+                    "data length: %d", __LINE__, loader->filename,
+                    buffer->count, buffer->length);
+            result = EINVAL;
+            break;
+        }
+
+        if ((result=shm_snapshot_check_buffer(buffer,
+                        buffer->length)) != 0)
+        {
+            break;
+        }
+        if ((result=shm_snapshot_read(loader, buffer->data,
+                        buffer->length)) != 0)
+        {
+            break;
+        }
+        if (buffer->count == 0) {
+            loader->done = true;
+        }
+    } while (0);
+
+    if (!(result == 0 || result == ENOENT) && loader->result == 0) {
+        loader->result = result;
+    }
+    pthread_mutex_unlock(&loader->lock);
+    return result;
+}
+
+static int shm_snapshot_parse_block(struct shm_snapshot_loader *loader,
+        struct shm_snapshot_buffer *buffer,
+        struct shm_snapshot_record *records, int *count,
+        struct shmcache_snapshot_stats *stats)
+{
+    int i;
+    char *p;
+    char *end;
+    struct shm_snapshot_record *record;
+    int ns_index;
+    int k;
+
+    *count = 0;
+    record = records;
+    p = buffer->data;
+    end = buffer->data + buffer->length;
+    for (i=0; i<buffer->count; i++) {
+        if (end - p < SHM_SNAPSHOT_RECORD_HEADER_SIZE) {
+            break;
+        }
+        record->key.length = (unsigned char)*p++;
+        record->is_int_key = (record->key.length &
+                SHM_SNAPSHOT_INT_KEY_FLAG) != 0;
+        record->key.length &= ~SHM_SNAPSHOT_INT_KEY_FLAG;
+        if (record->is_int_key && record->key.length != 8) {
+            break;
+        }
+        ns_index = (unsigned char)*p++;
+        if (ns_index >= loader->ns_count) {
+            break;
+        }
+        record->ns_index = loader->ns_map[ns_index];
+        record->tag_count = (unsigned char)*p++;
+        if (record->tag_count > SHMCACHE_MAX_TAGS) {
+            break;
+        }
+        record->value.options = buff2int(p);
+        p += 4;
+        record->value.length = buff2int(p);
+        p += 4;
+        record->value.expires = buff2long(p);
+        p += 8;
+        record->soft_expires = buff2long(p);
+        p += 8;
+        if (record->value.length < 0 || end - p < record->key.length +
+                record->value.length + 4 * record->tag_count)
+        {
+            break;
+        }
+        record->key.data = p;
+        record->key.hashed = 0;
+        if (record->is_int_key) {
+            record->int_key = buff2long(p);
+        }
+        p += record->key.length;
+        record->value.data = p;
+        p += record->value.length;
+        for (k=0; k<record->tag_count; k++) {
+            record->tag_slots[k] = (uint32_t)buff2int(p) %
+                SHM_TAG_SLOT_COUNT;
+            p += 4;
+        }
+
+        stats->total++;
+        if (!HT_EXPIRES_IS_VALID(record->value.expires,
+                    loader->current_time))
+        {
+            stats->expired++;
+            continue;
+        }
+        record++;
+    }
+
+    if (i < buffer->count || p != end) {
+        logError("file: "__FILE__", line: %d, "
+                "snapshot file: %s, invalid block data, "
+                "record index: %d, record count: %d", __LINE__,
+                loader->filename, i, buffer->count);
+        return EINVAL;
+    }
+
+    *count = record - records;
+    return 0;
+}
+
+static int shm_snapshot_set_records(struct shm_snapshot_loader *loader,
+        struct shm_snapshot_record *records, const int count,
+        struct shmcache_snapshot_stats *stats)
+{
+    int result;
+    struct shmcache_context *context;
+    struct shm_snapshot_record *record;
+    struct shm_snapshot_record *end;
+
+    context = loader->context;
+    if ((result=shm_lock(context)) != 0) {
+        return result;
+    }
+
+    end = records + count;
+    for (record=records; record<end; record++) {
+        if (record->ns_index < 0) {
+            stats->fail++;
+            continue;
+        }
+        context->memory->stats.hashtable.set.total++;
+        SHM_NS_PTR(context, record->ns_index)->stats.set.total++;
+        if (record->is_int_key) {
+            result = shm_ht_set_int(context, record->ns_index,
+                    record->int_key, &record->value);
+        } else {
+            result = shm_ht_set_ex(context, record->ns_index, &record->key,
+                    &record->value, record->soft_expires, record->tag_slots,
+                    record->tag_count);
+        }
+        if (result == 0) {
+            context->memory->stats.hashtable.set.success++;
+            SHM_NS_PTR(context, record->ns_index)->stats.set.success++;
+            stats->success++;
+        } else {
+            stats->fail++;
+        }
+    }
+
+    shm_unlock(context);
+    return 0;
+}
+
+static void *shm_snapshot_load_thread(void *arg)
+{
+    struct shm_snapshot_loader *loader;
+    struct shm_snapshot_buffer buffer;
+    struct shm_snapshot_record *records;
+    struct shmcache_snapshot_stats stats;
+    int records_alloc;
+    int count;
+    int crc32;
+    int result;
+
+    loader = (struct shm_snapshot_loader *)arg;
+    memset(&buffer, 0, sizeof(buffer));
+    memset(&stats, 0, sizeof(stats));
+    records = NULL;
+    records_alloc = 0;
+    while ((result=shm_snapshot_read_block(loader, &buffer, &crc32)) == 0) {
+        if (CRC32(buffer.data, buffer.length) != crc32) {
+            logError("file: "__FILE__", line: %d, "
+                    "snapshot file: %s, block crc32 checksum fail, "
+                    "record count: %d, data length: %d", __LINE__,
+                    loader->filename, buffer.count, buffer.length);
+            result = EINVAL;
+            break;
+        }
+
+        if (buffer.count == 0) {  //the last block
+            loader->record_count = buff2long(buffer.data);
+            continue;
+        }
+
+        if (buffer.count > records_alloc) {
+            struct shm_snapshot_record *new_records;
+            new_records = (struct shm_snapshot_record *)realloc(records,
+                    sizeof(struct shm_snapshot_record) * buffer.count);
+            if (new_records == NULL) {
+                logError("file: "__FILE__", line: %d, "
+                        "malloc %d bytes fail", __LINE__, (int)sizeof(
+                            struct shm_snapshot_record) * buffer.count);
+                result = ENOMEM;
+                break;
+            }
+            records = new_records;
+            records_alloc = buffer.count;
+        }
+
+        if ((result=shm_snapshot_parse_block(loader, &buffer, records,
+                        &count, &stats)) != 0)
+        {
+            break;
+        }
+        if (count > 0 && (result=shm_snapshot_set_records(loader,
+                        records, count, &stats)) != 0)
+        {
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&loader->lock);
+    if (!(result == 0 || result == ENOENT) && loader->result == 0) {
+        loader->result = result;
+    }
+    loader->stats.total += stats.total;
+    loader->stats.success += stats.success;
+    loader->stats.expired += stats.expired;
+    loader->stats.fail += stats.fail;
+    pthread_mutex_unlock(&loader->lock);
+
+    if (records != NULL) {
+        free(records);
+    }
+    if (buffer.data != NULL) {
+        free(buffer.data);
+    }
+    return NULL;
+}
+
+//map the namespaces of the file to the local namespaces by name
+static int shm_snapshot_read_namespaces(struct shm_snapshot_loader *loader)
+{
+    int result;
+    int len;
+    int i;
+    char buff[4];
+    char name[SHMCACHE_MAX_NAMESPACE_SIZE];
+
+    if ((result=shm_snapshot_read(loader, buff, 4)) != 0) {
+        return result;
+    }
+    loader->ns_count = buff2int(buff);
+    if (loader->ns_count <= 0 || loader->ns_count > SHMCACHE_MAX_NAMESPACES) {
+        logError("file: "__FILE__", line: %d, "
+                "snapshot file: %s, invalid namespace count: %d",
+                __LINE__, loader->filename, loader->ns_count);
+        return EINVAL;
+    }
+
+    for (i=0; i<loader->ns_count; i++) {
+        if ((result=shm_snapshot_read(loader, buff, 1)) != 0) {
+            return result;
+        }
+        len = (unsigned char)*buff;
+        if (len >= SHMCACHE_MAX_NAMESPACE_SIZE) {
+            logError("file: "__FILE__", line: %d, "
+                    "snapshot file: %s, invalid namespace length: %d",
+                    __LINE__, loader->filename, len);
+            return EINVAL;
+        }
+        if ((result=shm_snapshot_read(loader, name, len)) != 0) {
+            return result;
+        }
+        name[len] = '\0';
+
+        loader->ns_map[i] = shm_ns_find(loader->context, name);
+        if (loader->ns_map[i] < 0) {
+            logWarning("file: "__FILE__", line: %d, "
+                    "snapshot file: %s, namespace: %s not exist, "
+                    "the entries of it are skipped", __LINE__,
+                    loader->filename, name);
+        }
+    }
+    return 0;
+}
+
+static int shm_snapshot_check_header(struct shm_snapshot_loader *loader)
+{
+    int result;
+    int version;
+    char header[SHM_SNAPSHOT_FILE_HEADER_SIZE];
+
+    if ((result=shm_snapshot_read(loader, header, sizeof(header))) != 0) {
+        return result;
+    }
+    if (memcmp(header, SHM_SNAPSHOT_MAGIC_STR,
+                SHM_SNAPSHOT_MAGIC_LEN) != 0)
+    {
+        logError("file: "__FILE__", line: %d, "
+                "file: %s is not a shmcache snapshot file",
+                __LINE__, loader->filename);
+        return EINVAL;
+    }
+    version = buff2int(header + 8);
+    if (version != SHM_SNAPSHOT_VERSION) {
+        logError("file: "__FILE__", line: %d, "
+                "snapshot file: %s, version: %d != %d",
+                __LINE__, loader->filename, version,
+                SHM_SNAPSHOT_VERSION);
+        return EINVAL;
+    }
+    return shm_snapshot_read_namespaces(loader);
+}
+
+int shm_snapshot_load(struct shmcache_context *context,
+        const char *filename, const int thread_count,
+        struct shmcache_snapshot_stats *stats)
+{
+    int result;
+    int i;
+    int count;
+    int err_no;
+    pthread_t *tids;
+    struct shm_snapshot_loader loader;
+
+    memset(&loader, 0, sizeof(loader));
+    loader.context = context;
+    loader.filename = filename;
+    loader.current_time = time(NULL);
+    loader.record_count = -1;
+    if ((loader.fp=fopen(filename, "rb")) == NULL) {
+        result = errno != 0 ? errno : ENOENT;
+        logError("file: "__FILE__", line: %d, "
+                "open file: %s fail, "
+                "errno: %d, error info: %s", __LINE__,
+                filename, result, strerror(result));
+        return result;
+    }
+
+    if ((result=shm_snapshot_check_header(&loader)) != 0) {
+        fclose(loader.fp);
+        return result;
+    }
+    if ((result=init_pthread_lock(&loader.lock)) != 0) {
+        fclose(loader.fp);
+        return result;
+    }
+
+    count = 0;
+    tids = NULL;
+    if (thread_count > 1) {
+        tids = (pthread_t *)malloc(sizeof(pthread_t) * thread_count);
+        if (tids != NULL) {
+            for (; count<thread_count; count++) {
+                if ((err_no=pthread_create(tids + count, NULL,
+                            shm_snapshot_load_thread, &loader)) != 0)
+                {
+                    logWarning("file: "__FILE__", line: %d, "
+                            "create thread fail, errno: %d, "
+                            "error info: %s", __LINE__,
+                            err_no, STRERROR(err_no));
+                    break;
+                }
+            }
+        }
+    }
+
+    if (count == 0) {
+        shm_snapshot_load_thread(&loader);
+    } else {
+        for (i=0; i<count; i++) {
+            pthread_join(tids[i], NULL);
+        }
+    }
+    if (tids != NULL) {
+        free(tids);
+    }
+
+    result = loader.result;
+    if (result == 0) {
+        if (!loader.done) {
+            logError("file: "__FILE__", line: %d, "
+                    "snapshot file: %s is truncated",
+                    __LINE__, filename);
+            result = EINVAL;
+        } else if (loader.record_count != loader.stats.total) {
+            logError("file: "__FILE__", line: %d, "
+                    "snapshot file: %s, record count: %"PRId64" != "
+                    "that of the last block: %"PRId64, __LINE__,
+                    filename, loader.stats.total, loader.record_count);
+            result = EINVAL;
+        }
+    }
+
+    *stats = loader.stats;
+    pthread_mutex_destroy(&loader.lock);
+    fclose(loader.fp);
+    return result;
+}
@@ -0,0 +1,79 @@
+//shm_snapshot.h
+
+#ifndef _SHM_SNAPSHOT_H
+#define _SHM_SNAPSHOT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "common_define.h"
+#include "shmcache_types.h"
+
+/* snapshot file format, all integers are big endian:
+ *   file header:  magic (8 bytes) + version (4 bytes) + reserved (4 bytes)
+ *                 + create time (8 bytes)
+ *   namespaces:   namespace count (4 bytes)
+ *                 + [name length (1 byte) + name] * namespace count
+ *   blocks:       record count (4 bytes) + data length (4 bytes)
+ *                 + crc32 of data (4 bytes) + data
+ *   record:       key length (1 byte, | 0x80 for the int64 key)
+ *                 + namespace index (1 byte)
+ *                 + tag count (1 byte) + options (4 bytes)
+ *                 + value length (4 bytes) + expires (8 bytes)
+ *                 + soft expires (8 bytes, 0 for none)
+ *                 + key (the int64 key is 8 bytes big endian)
+ *                 + value + tag slots (4 bytes * tag count, seeded with
+ *                   the namespace name, independent of the index)
+ *   the last block: record count is 0 and the data is
+ *                   the total record count (8 bytes)
+ */
+
+#define SHM_SNAPSHOT_MAGIC_STR       "SHMCDUMP"
+#define SHM_SNAPSHOT_MAGIC_LEN       8
+#define SHM_SNAPSHOT_VERSION         4
+
+#define SHM_SNAPSHOT_FILE_HEADER_SIZE   24
+#define SHM_SNAPSHOT_BLOCK_HEADER_SIZE  12
+#define SHM_SNAPSHOT_RECORD_HEADER_SIZE 27
+#define SHM_SNAPSHOT_INT_KEY_FLAG       0x80
+
+//records are flushed when the block reach this size
+#define SHM_SNAPSHOT_BLOCK_SIZE      (1024 * 1024)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+dump all valid entries to the snapshot file in insertion order,
+the entries are copied block by block under the lock and the file is
+written without the lock, the entries rewritten or removed since the
+dump began are skipped, the caller should NOT hold the lock
+parameters:
+	context: the context pointer
+    filename: the snapshot filename
+    stats: return the dump stats
+return error no, 0 for success, != 0 for fail
+*/
+int shm_snapshot_dump(struct shmcache_context *context,
+        const char *filename, struct shmcache_snapshot_stats *stats);
+
+/**
+load entries from the snapshot file, every block is set under one lock
+parameters:
+	context: the context pointer
+    filename: the snapshot filename
+    thread_count: the thread count to load blocks in parallel
+    stats: return the load stats
+return error no, 0 for success, != 0 for fail
+*/
+int shm_snapshot_load(struct shmcache_context *context,
+        const char *filename, const int thread_count,
+        struct shmcache_snapshot_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
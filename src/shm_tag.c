@@ -0,0 +1,34 @@
+//shm_tag.c
+
+#include <errno.h>
+#include "logger.h"
+#include "hash.h"
+#include "shm_namespace.h"
+#include "shm_tag.h"
+
+void shm_tag_init(struct shmcache_context *context)
+{
+    memset(&context->memory->tags, 0, sizeof(context->memory->tags));
+}
+
+uint32_t shm_tag_get_slot(struct shmcache_context *context,
+        const int ns_index, const struct shmcache_key_info *tag)
+{
+    //the slot must be stable across instances for the snapshot,
+    //so do NOT use the configurable hash function, and seed with the
+    //namespace name because the namespace index may differ
+    const char *ns_name;
+    int hash_code;
+
+    ns_name = SHM_NS_PTR(context, ns_index)->name;
+    hash_code = simple_hash_ex(tag->data, tag->length,
+            simple_hash(ns_name, strlen(ns_name)));
+    return (uint32_t)hash_code % SHM_TAG_SLOT_COUNT;
+}
+
+void shm_tag_invalidate(struct shmcache_context *context, const uint32_t slot)
+{
+    //the readers compare the version without lock
+    __sync_add_and_fetch(&context->memory->tags.versions[slot], 1);
+    context->memory->tags.invalidate_count++;
+}
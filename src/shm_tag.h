@@ -0,0 +1,108 @@
+//shm_tag.h
+
+#ifndef _SHM_TAG_H
+#define _SHM_TAG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "common_define.h"
+#include "shmcache_types.h"
+#include "shm_value_allocator.h"
+
+#define SHM_TAG_REFS_SIZE(count) (sizeof(struct shm_tag_refs) + \
+        sizeof(struct shm_tag_ref) * (count))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+tags init when the share memory created
+parameters:
+	context: the context pointer
+return none
+*/
+void shm_tag_init(struct shmcache_context *context);
+
+/**
+get the slot of the tag, the tags of different namespaces are independent,
+the slot depends on the namespace name only, NOT the namespace index
+parameters:
+	context: the context pointer
+    ns_index: the namespace index
+    tag: the tag
+return the slot index
+*/
+uint32_t shm_tag_get_slot(struct shmcache_context *context,
+        const int ns_index, const struct shmcache_key_info *tag);
+
+/**
+invalidate all entries with the tag by increasing the slot version,
+the caller should hold the lock
+parameters:
+	context: the context pointer
+    slot: the tag slot index
+return none
+*/
+void shm_tag_invalidate(struct shmcache_context *context, const uint32_t slot);
+
+//the tag refs follow the value (and the soft ttl) of the tagged entry
+static inline struct shm_tag_refs *shm_tag_get_refs(
+        struct shmcache_context *context, struct shm_hash_entry *entry)
+{
+    char *p;
+
+    p = shm_get_value_ptr(context, entry) + MEM_ALIGN(entry->value.length);
+    if ((entry->flags & SHM_HENTRY_FLAG_SOFT_TTL) != 0) {
+        p += sizeof(struct shm_soft_ttl);
+    }
+    return (struct shm_tag_refs *)p;
+}
+
+//record the current slot versions to the entry
+static inline void shm_tag_set_refs(struct shmcache_context *context,
+        struct shm_hash_entry *entry, const uint32_t *slots,
+        const int count)
+{
+    struct shm_tag_refs *refs;
+    int i;
+
+    refs = shm_tag_get_refs(context, entry);
+    refs->count = count;
+    refs->reserved = 0;
+    for (i=0; i<count; i++) {
+        refs->items[i].slot = slots[i];
+        refs->items[i].version = context->memory->tags.versions[slots[i]];
+    }
+}
+
+//if none of the tags of the entry is invalidated, for lock-free readers
+static inline bool shm_tag_entry_is_valid(struct shmcache_context *context,
+        struct shm_hash_entry *entry)
+{
+    struct shm_tag_refs *refs;
+    uint32_t i;
+
+    if ((entry->flags & SHM_HENTRY_FLAG_TAGGED) == 0) {
+        return true;
+    }
+
+    refs = shm_tag_get_refs(context, entry);
+    for (i=0; i<refs->count && i<SHMCACHE_MAX_TAGS; i++) {
+        if (refs->items[i].slot >= SHM_TAG_SLOT_COUNT ||
+                refs->items[i].version != context->memory->
+                tags.versions[refs->items[i].slot])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -8,12 +8,14 @@
 #include "shm_list.h"
 #include "shmopt.h"
 #include "shm_hashtable.h"
+#include "shm_checkpoint.h"
 #include "shm_value_allocator.h"
 
 //从striping_allocator对象空间 中 分配一个entry空间
 static struct shm_hash_entry *shm_value_striping_alloc(
         struct shmcache_context *context,
-        struct shm_striping_allocator *allocator, const int size)
+        struct shm_striping_allocator *allocator, const int size,
+        int64_t *entry_offset)
 {
     int64_t offset;
     char *base;
@@ -29,15 +31,16 @@ static struct shm_hash_entry *shm_value_striping_alloc(
     }
 
     entry = (struct shm_hash_entry *)(base + offset);
-    entry->memory.offset = offset;
-    entry->memory.index = allocator->index;
-    entry->memory.size = size;
+    entry->size = size;
+    *entry_offset = shm_make_hentry_offset(allocator->index.segment, offset);
+    shm_checkpoint_mark_striping(context, allocator->index.striping);
     return entry;
 }
 
 //从现有的striping_allocator对象的空间中，分配一个entry空间
 //返回NULL，表示分配失败
-static struct shm_hash_entry *shm_value_allocator_do_alloc(struct shmcache_context *context, const int size)
+static struct shm_hash_entry *shm_value_allocator_do_alloc(struct shmcache_context *context,
+        const int size, int64_t *entry_offset)
 {
     int64_t allocator_offset;
     int64_t removed_offset;
@@ -50,7 +53,7 @@ static struct shm_hash_entry *shm_value_allocator_do_alloc(struct shmcache_conte
     {
         allocator = (struct shm_striping_allocator *)(context->segments.hashtable.base + allocator_offset);
         //从striping_allocator 中获取一个 entry
-        if ((entry=shm_value_striping_alloc(context, allocator, size)) != NULL)
+        if ((entry=shm_value_striping_alloc(context, allocator, size, entry_offset)) != NULL)
         {
             context->memory->usage.used.entry += size;
             return entry;
@@ -115,9 +118,10 @@ int shm_value_allocator_recycle(struct shmcache_context *context, struct shm_rec
     int64_t entry_offset;
     int64_t start_time;
     struct shm_hash_entry *entry;
-    struct shmcache_key_info key;
+    struct shm_namespace *ns;
     int result;
     int index;
+    int ns_index;
     int clear_count;
     int valid_count;
     bool valid;
@@ -131,24 +135,21 @@ int shm_value_allocator_recycle(struct shmcache_context *context, struct shm_rec
 
     //bzh: 为什么要按FIFO策略来淘汰key entry？
     //我猜想是因为 这里的任务是释放一个striping_allocator对象的空间，而一个 striping_allocator对象的空间是由 连续的几个key entry来瓜分的，所以需要释放连续的key entry.
-    while ((entry_offset=shm_list_first(context)) > 0)    //从头到尾 遍历链表中的结点
+    //the oldest entry of all namespaces is evicted first to keep FIFO,
+    //the quota of the namespaces is NOT considered here
+    while ((ns_index=shm_ns_get_victim(context)) >= 0)
     {
-        entry = shm_get_hentry_ptr(context, entry_offset);
-        index = entry->memory.index.striping;
-        key.data = entry->key;
-        key.length = entry->key_len;
-        valid = HT_ENTRY_IS_VALID(entry, g_current_time);
-        if (shm_ht_delete_ex(context, &key, &recycled) != 0)  //删除这个key对应的entry空间
-        {
-            logError("file: "__FILE__", line: %d, "
-                    "shm_ht_delete fail, index: %d, "
-                    "entry offset: %"PRId64", "
-                    "key: %.*s, key length: %d", __LINE__,
-                    index, entry_offset, entry->key_len,
-                    entry->key, entry->key_len);
-
-            shm_ht_free_entry(context, entry, entry_offset, &recycled);
+        ns = SHM_NS_PTR(context, ns_index);
+        if ((entry_offset=shm_list_first(&ns->head)) <= 0) {  //从头到尾 遍历链表中的结点
+            break;
         }
+        entry = shm_get_hentry_ptr(context, entry_offset);
+        index = shm_get_hentry_striping(context, entry_offset);
+        valid = HT_ENTRY_IS_CURRENT(context, entry) &&
+            HT_ENTRY_IS_VALID(context, entry, g_current_time) &&
+            shm_tag_entry_is_valid(context, entry);
+        shm_ht_delete_entry(context, entry, entry_offset, &recycled);  //删除这个key对应的entry空间
+        ns->stats.recycle++;
 
         clear_count++;
         if (valid)
@@ -214,17 +215,16 @@ int shm_value_allocator_recycle(struct shmcache_context *context, struct shm_rec
     return result;
 }
 
-struct shm_hash_entry *shm_value_allocator_alloc(struct shmcache_context *context, const int key_len, const int value_len)
+struct shm_hash_entry *shm_value_allocator_alloc(struct shmcache_context *context,
+        const int size, int64_t *entry_offset)
 {
     int result;
-    int size;
     bool recycle;  //是否需要 回收一个striping_allocator对象空间
     int64_t allocator_offset;
     struct shm_striping_allocator *allocator;
     struct shm_hash_entry *entry;
 
-    size = sizeof(struct shm_hash_entry) + MEM_ALIGN(key_len) + MEM_ALIGN(value_len);
-    if ((entry=shm_value_allocator_do_alloc(context, size)) != NULL) {
+    if ((entry=shm_value_allocator_do_alloc(context, size, entry_offset)) != NULL) {
         return entry;
     }
 
@@ -251,7 +251,7 @@ struct shm_hash_entry *shm_value_allocator_alloc(struct shmcache_context *contex
         result = shmopt_create_value_segment(context);      //分配一个shm segment
     }
     if (result == 0) {
-        entry  = shm_value_allocator_do_alloc(context, size);
+        entry  = shm_value_allocator_do_alloc(context, size, entry_offset);
     }
     if (entry == NULL) {
         logError("file: "__FILE__", line: %d, "
@@ -260,22 +260,25 @@ struct shm_hash_entry *shm_value_allocator_alloc(struct shmcache_context *contex
     return entry;
 }
 
-int shm_value_allocator_free(struct shmcache_context *context, struct shm_hash_entry *entry, bool *recycled)
+int shm_value_allocator_free(struct shmcache_context *context,
+        struct shm_hash_entry *entry, const int64_t entry_offset,
+        bool *recycled)
 {
     struct shm_striping_allocator *allocator;
     int64_t used;
 
-    allocator = context->value_allocator.allocators + entry->memory.index.striping;  //获取entry对应的 striping_allocator对象
-    used = shm_striping_allocator_free(allocator, entry->memory.size);
-    context->memory->usage.used.entry -= entry->memory.size;
+    allocator = context->value_allocator.allocators + shm_get_hentry_striping(context, entry_offset);  //获取entry对应的 striping_allocator对象
+    used = shm_striping_allocator_free(allocator, entry->size);
+    context->memory->usage.used.entry -= entry->size;
     if (used <= 0) {   //若此 striping_allocator已使用的空间为0，则将它 归还到context->value_allocator.doing
         if (used < 0) {
             logError("file: "__FILE__", line: %d, "
                     "striping used memory: %"PRId64" < 0, "
                     "segment: %d, striping: %d, offset: %"PRId64", size: %d",
-                    __LINE__, used, entry->memory.index.segment,
-                    entry->memory.index.striping, entry->memory.offset,
-                    entry->memory.size);
+                    __LINE__, used, shm_get_hentry_segment(entry_offset),
+                    allocator->index.striping,
+                    shm_get_hentry_segment_offset(entry_offset),
+                    entry->size);
         }
         *recycled = true;
         shm_striping_allocator_reset(allocator);
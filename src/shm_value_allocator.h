@@ -19,23 +19,25 @@ extern "C" {
 alloc memory from the allocator
 parameters:
 	context: the shm context
-    key_len: the key length
-    value_len: the value length
-return error no, 0 for success, != 0 fail
+    size: the alloc size of the entry, see shm_value_allocator_entry_size
+    entry_offset: return the entry offset
+return the entry, NULL for fail
 */
 struct shm_hash_entry *shm_value_allocator_alloc(struct shmcache_context *context,
-        const int key_len, const int value_len);
+        const int size, int64_t *entry_offset);
 
 /**
 free memory to the allocator
 parameters:
 	context: the shm context
-    value:  the value to free
+    entry:  the entry to free
+    entry_offset: the entry offset
     recycled: if recycled
 return error no, 0 for success, != 0 fail
 */
 int shm_value_allocator_free(struct shmcache_context *context,
-        struct shm_hash_entry *entry, bool *recycled);
+        struct shm_hash_entry *entry, const int64_t entry_offset,
+        bool *recycled);
 
 /**
 recycle oldest hashtable entries
@@ -49,41 +51,61 @@ return error no, 0 for success, != 0 fail
 int shm_value_allocator_recycle(struct shmcache_context *context,
         struct shm_recycle_stats *recycle_stats, const int recycle_key_once);
 
+//the alloc size of the entry include the key and the value
+static inline int shm_value_allocator_entry_size(const int key_len,
+        const int value_len)
+{
+    return sizeof(struct shm_hash_entry) + MEM_ALIGN(key_len) +
+        MEM_ALIGN(value_len);
+}
+
+static inline int64_t shm_make_hentry_offset(const int segment_index,
+        const int64_t segment_offset)
+{
+    return ((int64_t)(segment_index + 1) << SHM_HENTRY_OFFSET_BITS) |
+        (segment_offset >> SHM_HENTRY_ALIGN_BITS);
+}
+
+static inline int shm_get_hentry_segment(const int64_t offset)
+{
+    return (offset >> SHM_HENTRY_OFFSET_BITS) - 1;
+}
+
+static inline int64_t shm_get_hentry_segment_offset(const int64_t offset)
+{
+    return (offset & SHM_HENTRY_OFFSET_MASK) << SHM_HENTRY_ALIGN_BITS;
+}
+
+//the stripings are created in order and every segment has the same count
+static inline int shm_get_hentry_striping(struct shmcache_context *context,
+        const int64_t offset)
+{
+    return shm_get_hentry_segment(offset) * (context->memory->vm_info.
+            segment.size / context->memory->vm_info.striping.size) +
+        shm_get_hentry_segment_offset(offset) /
+        context->memory->vm_info.striping.size;
+}
+
+//the value follows the key
 static inline char *shm_get_value_ptr(struct shmcache_context *context, struct shm_hash_entry *entry)
 {
-    char *base;
-    base = shmopt_get_value_segment(context, entry->memory.index.segment);
-    if (base != NULL) {
-        return base + entry->memory.offset + sizeof(struct shm_hash_entry) + MEM_ALIGN(entry->key_len);
-    } else {
-        return NULL;
-    }
+    return (char *)entry + sizeof(struct shm_hash_entry) + MEM_ALIGN(entry->key_len);
 }
 
 //根据offset 获取它相应的hash_entry地址
 static inline struct shm_hash_entry *shm_get_hentry_ptr(struct shmcache_context *context, const int64_t offset)
 {
     char *base;
-    union shm_hentry_offset conv;
 
-    conv.offset = offset;
-    base = shmopt_get_value_segment(context, conv.segment.index & 0xFF);
+    base = shmopt_get_value_segment(context, shm_get_hentry_segment(offset));
     if (base != NULL) {
-        return (struct shm_hash_entry *)(base + conv.segment.offset);
+        return (struct shm_hash_entry *)(base +
+                shm_get_hentry_segment_offset(offset));
     } else {
         return NULL;
     }
 }
 
-static inline int64_t shm_get_hentry_offset(struct shm_hash_entry *entry)
-{
-    union shm_hentry_offset conv;
-    conv.segment.index = entry->memory.index.segment | 0x4000;
-    conv.segment.offset = entry->memory.offset;
-
-    return conv.offset;
-}
-
 #ifdef __cplusplus
 }
 #endif
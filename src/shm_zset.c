@@ -0,0 +1,557 @@
+//shm_zset.c
+
+#include <errno.h>
+#include "logger.h"
+#include "shared_func.h"
+#include "sched_thread.h"
+#include "hash.h"
+#include "shm_checkpoint.h"
+#include "shm_hashtable.h"
+#include "shmcache.h"
+#include "shm_zset.h"
+
+#define ZSET_HEADER(base)  ((struct shm_zset_header *)(base))
+#define ZSET_BUCKETS(base) ((int *)((base) + sizeof(struct shm_zset_header)))
+#define ZSET_NODE(base, offset) ((struct shm_zset_node *)((base) + (offset)))
+#define ZSET_HEAD(base) ZSET_NODE(base, ZSET_HEADER(base)->head)
+
+#define ZSET_MEMBER_PTR(node) \
+    ((char *)(node)->links + sizeof(struct shm_zset_link) * (node)->level)
+
+#define ZSET_NODE_SIZE(level, member_len) \
+    MEM_ALIGN(sizeof(struct shm_zset_node) + \
+            sizeof(struct shm_zset_link) * (level) + (member_len))
+
+#define ZSET_BUCKETS_SIZE(bucket_count) \
+    MEM_ALIGN(sizeof(int) * (bucket_count))
+
+#define ZSET_MIN_BUCKETS  16
+
+//the blob size to hold the nodes
+#define ZSET_BLOB_SIZE(bucket_count, nodes_size) \
+    (sizeof(struct shm_zset_header) + ZSET_BUCKETS_SIZE(bucket_count) + \
+     ZSET_NODE_SIZE(SHM_ZSET_MAX_LEVEL, 0) + (nodes_size))
+
+static inline int shm_zset_compare(const int64_t score,
+        const struct shmcache_key_info *member, struct shm_zset_node *node)
+{
+    int result;
+
+    if (score != node->score) {
+        return score < node->score ? -1 : 1;
+    }
+    result = memcmp(member->data, ZSET_MEMBER_PTR(node),
+            member->length < node->member_len ?
+            member->length : node->member_len);
+    if (result != 0) {
+        return result;
+    }
+    return member->length - node->member_len;
+}
+
+//the level of the new node, the probability of the next level is 1/4
+static int shm_zset_random_level()
+{
+    int level;
+
+    level = 1;
+    while (level < SHM_ZSET_MAX_LEVEL && (rand() & 3) == 0) {
+        level++;
+    }
+    return level;
+}
+
+static inline int *shm_zset_bucket(char *base,
+        const struct shmcache_key_info *member)
+{
+    return ZSET_BUCKETS(base) + (unsigned int)simple_hash(member->data,
+            member->length) % ZSET_HEADER(base)->bucket_count;
+}
+
+static int shm_zset_find_member(char *base,
+        const struct shmcache_key_info *member)
+{
+    int offset;
+    struct shm_zset_node *node;
+
+    offset = *shm_zset_bucket(base, member);
+    while (offset > 0) {
+        node = ZSET_NODE(base, offset);
+        if (node->member_len == member->length && memcmp(
+                    ZSET_MEMBER_PTR(node), member->data,
+                    member->length) == 0)
+        {
+            return offset;
+        }
+        offset = node->hnext;
+    }
+    return 0;
+}
+
+//insert the node at the offset, the space should be reserved
+static void shm_zset_insert(char *base, const int offset,
+        const struct shmcache_key_info *member, const int64_t score,
+        const int level)
+{
+    struct shm_zset_header *header;
+    struct shm_zset_node *head;
+    struct shm_zset_node *x;
+    struct shm_zset_node *node;
+    struct shm_zset_node *update[SHM_ZSET_MAX_LEVEL];
+    int rank[SHM_ZSET_MAX_LEVEL];
+    int *bucket;
+    int i;
+
+    header = ZSET_HEADER(base);
+    head = ZSET_HEAD(base);
+    x = head;
+    for (i=header->level-1; i>=0; i--) {
+        rank[i] = (i == header->level - 1) ? 0 : rank[i + 1];
+        while (x->links[i].next > 0 && shm_zset_compare(score, member,
+                    ZSET_NODE(base, x->links[i].next)) > 0)
+        {
+            rank[i] += x->links[i].span;
+            x = ZSET_NODE(base, x->links[i].next);
+        }
+        update[i] = x;
+    }
+
+    if (level > header->level) {
+        for (i=header->level; i<level; i++) {
+            rank[i] = 0;
+            update[i] = head;
+            head->links[i].span = header->count;
+        }
+        header->level = level;
+    }
+
+    node = ZSET_NODE(base, offset);
+    node->score = score;
+    node->level = level;
+    node->member_len = member->length;
+    node->reserved = 0;
+    node->padding = 0;
+    memcpy(ZSET_MEMBER_PTR(node), member->data, member->length);
+    for (i=0; i<level; i++) {
+        node->links[i].next = update[i]->links[i].next;
+        update[i]->links[i].next = offset;
+        node->links[i].span = update[i]->links[i].span - (rank[0] - rank[i]);
+        update[i]->links[i].span = (rank[0] - rank[i]) + 1;
+    }
+    for (i=level; i<header->level; i++) {
+        update[i]->links[i].span++;
+    }
+
+    node->prev = (update[0] == head) ? 0 : (char *)update[0] - base;
+    if (node->links[0].next > 0) {
+        ZSET_NODE(base, node->links[0].next)->prev = offset;
+    } else {
+        header->tail = offset;
+    }
+
+    bucket = shm_zset_bucket(base, member);
+    node->hnext = *bucket;
+    *bucket = offset;
+    header->count++;
+}
+
+static void shm_zset_delete(char *base, const int offset)
+{
+    struct shm_zset_header *header;
+    struct shm_zset_node *head;
+    struct shm_zset_node *x;
+    struct shm_zset_node *node;
+    struct shm_zset_node *update[SHM_ZSET_MAX_LEVEL];
+    struct shmcache_key_info member;
+    int *bucket;
+    int i;
+
+    header = ZSET_HEADER(base);
+    head = ZSET_HEAD(base);
+    node = ZSET_NODE(base, offset);
+    member.data = ZSET_MEMBER_PTR(node);
+    member.length = node->member_len;
+
+    x = head;
+    for (i=header->level-1; i>=0; i--) {
+        while (x->links[i].next > 0 && shm_zset_compare(node->score,
+                    &member, ZSET_NODE(base, x->links[i].next)) > 0)
+        {
+            x = ZSET_NODE(base, x->links[i].next);
+        }
+        update[i] = x;
+    }
+
+    for (i=0; i<header->level; i++) {
+        if (update[i]->links[i].next == offset) {
+            update[i]->links[i].span += node->links[i].span - 1;
+            update[i]->links[i].next = node->links[i].next;
+        } else {
+            update[i]->links[i].span--;
+        }
+    }
+    if (node->links[0].next > 0) {
+        ZSET_NODE(base, node->links[0].next)->prev = node->prev;
+    } else {
+        header->tail = node->prev;
+    }
+    while (header->level > 1 && head->links[header->level - 1].next == 0) {
+        header->level--;
+    }
+
+    bucket = shm_zset_bucket(base, &member);
+    while (*bucket != offset) {
+        bucket = &ZSET_NODE(base, *bucket)->hnext;
+    }
+    *bucket = node->hnext;
+
+    header->count--;
+    header->garbage += ZSET_NODE_SIZE(node->level, node->member_len);
+}
+
+//the node of the rank based 1
+static struct shm_zset_node *shm_zset_get_by_rank(char *base, const int rank)
+{
+    struct shm_zset_node *x;
+    int traversed;
+    int i;
+
+    traversed = 0;
+    x = ZSET_HEAD(base);
+    for (i=ZSET_HEADER(base)->level-1; i>=0; i--) {
+        while (x->links[i].next > 0 && traversed + x->links[i].span <= rank) {
+            traversed += x->links[i].span;
+            x = ZSET_NODE(base, x->links[i].next);
+        }
+        if (traversed == rank) {
+            return x;
+        }
+    }
+    return NULL;
+}
+
+/* rebuild the sorted set to the new buffer without the removed nodes,
+ * reserve extra bytes for the new node. build an empty one when
+ * old_base is NULL
+ */
+static int shm_zset_rebuild(struct shmcache_context *context,
+        char *old_base, const int extra, char **new_base, int *new_size)
+{
+    struct shm_zset_header *header;
+    struct shm_zset_node *head;
+    struct shm_zset_node *old_node;
+    struct shm_zset_node *node;
+    struct shm_zset_node *last[SHM_ZSET_MAX_LEVEL];
+    int last_rank[SHM_ZSET_MAX_LEVEL];
+    int old_count;
+    int nodes_size;
+    int bucket_count;
+    int64_t capacity;
+    int offset;
+    int old_offset;
+    int node_size;
+    int rank;
+    int *bucket;
+    int i;
+    char *base;
+    struct shmcache_key_info member;
+
+    if (old_base != NULL) {
+        old_count = ZSET_HEADER(old_base)->count;
+        nodes_size = ZSET_HEADER(old_base)->used - ZSET_HEADER(old_base)->
+            garbage - ((char *)ZSET_HEAD(old_base) - old_base) -
+            ZSET_NODE_SIZE(SHM_ZSET_MAX_LEVEL, 0);
+    } else {
+        old_count = 0;
+        nodes_size = 0;
+    }
+
+    bucket_count = (old_count + 1) * 2;
+    if (bucket_count < ZSET_MIN_BUCKETS) {
+        bucket_count = ZSET_MIN_BUCKETS;
+    }
+    capacity = ZSET_BLOB_SIZE(bucket_count, nodes_size + extra);
+    if (capacity > context->config.max_value_size) {
+        logError("file: "__FILE__", line: %d, "
+                "the sorted set size: %"PRId64" exceeds %d, "
+                "member count: %d", __LINE__, capacity,
+                context->config.max_value_size, old_count);
+        return ENOSPC;
+    }
+    capacity = MEM_ALIGN(HT_VALUE_GROW_CAPACITY(capacity));
+    if (capacity > context->config.max_value_size) {
+        capacity = context->config.max_value_size;
+    }
+
+    if ((base=(char *)malloc(capacity)) == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "malloc %d bytes fail", __LINE__, (int)capacity);
+        return ENOMEM;
+    }
+    memset(base, 0, ZSET_BLOB_SIZE(bucket_count, 0));
+
+    header = ZSET_HEADER(base);
+    header->level = 1;
+    header->bucket_count = bucket_count;
+    header->head = sizeof(struct shm_zset_header) +
+        ZSET_BUCKETS_SIZE(bucket_count);
+    head = ZSET_HEAD(base);
+    head->level = SHM_ZSET_MAX_LEVEL;
+    offset = header->head + ZSET_NODE_SIZE(SHM_ZSET_MAX_LEVEL, 0);
+    for (i=0; i<SHM_ZSET_MAX_LEVEL; i++) {
+        last[i] = head;
+        last_rank[i] = 0;
+    }
+
+    //copy the nodes in order and link them level by level
+    rank = 0;
+    old_offset = (old_base != NULL) ? ZSET_HEAD(old_base)->links[0].next : 0;
+    while (old_offset > 0) {
+        old_node = ZSET_NODE(old_base, old_offset);
+        node_size = ZSET_NODE_SIZE(old_node->level, old_node->member_len);
+        node = ZSET_NODE(base, offset);
+        memcpy(node, old_node, node_size);
+        rank++;
+        for (i=0; i<node->level; i++) {
+            last[i]->links[i].next = offset;
+            last[i]->links[i].span = rank - last_rank[i];
+            last[i] = node;
+            last_rank[i] = rank;
+            node->links[i].next = 0;
+        }
+        if (node->level > header->level) {
+            header->level = node->level;
+        }
+        node->prev = (rank == 1) ? 0 : header->tail;
+        header->tail = offset;
+
+        member.data = ZSET_MEMBER_PTR(node);
+        member.length = node->member_len;
+        bucket = shm_zset_bucket(base, &member);
+        node->hnext = *bucket;
+        *bucket = offset;
+
+        offset += node_size;
+        old_offset = old_node->links[0].next;
+    }
+    for (i=0; i<header->level; i++) {
+        last[i]->links[i].span = rank - last_rank[i];
+    }
+
+    header->count = rank;
+    header->used = offset;
+    header->garbage = 0;
+    *new_base = base;
+    *new_size = capacity;
+    return 0;
+}
+
+//find the valid sorted set, base is NULL when the key not exist
+static int shm_zset_lookup(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        struct shm_hash_entry **entry, int64_t *entry_offset, char **base)
+{
+    *base = NULL;
+    if ((*entry=shm_ht_find_valid(context, key, entry_offset)) == NULL) {
+        return ENOENT;
+    }
+    if ((*entry)->value.options != SHMCACHE_SERIALIZER_ZSET) {
+        logError("file: "__FILE__", line: %d, "
+                "key: %.*s, the value is not a sorted set, serializer: %s",
+                __LINE__, key->length, key->data,
+                shmcache_get_serializer_label((*entry)->value.options));
+        return EINVAL;
+    }
+
+    *base = shm_get_value_ptr(context, *entry);
+    return 0;
+}
+
+static inline void shm_zset_modified(struct shmcache_context *context,
+        struct shm_hash_entry *entry, const int64_t entry_offset)
+{
+    entry->version = ++context->memory->hashtable.version;
+    shm_checkpoint_mark_entry(context, entry_offset);
+}
+
+int shm_zset_add(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *member,
+        const int64_t score, const int ttl)
+{
+    int result;
+    int offset;
+    int level;
+    int node_size;
+    int new_size;
+    int64_t entry_offset;
+    struct shm_hash_entry *entry;
+    struct shmcache_value_info value;
+    char *base;
+    char *new_base;
+
+    if (member->length <= 0 || member->length >
+            SHMCACHE_MAX_ZSET_MEMBER_SIZE)
+    {
+		logError("file: "__FILE__", line: %d, "
+                "invalid member length: %d, should in [1, %d]",
+                __LINE__, member->length, SHMCACHE_MAX_ZSET_MEMBER_SIZE);
+        return EINVAL;
+    }
+
+    result = shm_zset_lookup(context, key, &entry, &entry_offset, &base);
+    if (result != 0 && result != ENOENT) {
+        return result;
+    }
+
+    level = shm_zset_random_level();
+    node_size = ZSET_NODE_SIZE(level, member->length);
+    if (base != NULL) {
+        offset = shm_zset_find_member(base, member);
+        if (offset > 0 && ZSET_NODE(base, offset)->score == score) {
+            return 0;
+        }
+
+        if (ZSET_HEADER(base)->used + node_size <= entry->value.length) {
+            if (offset > 0) {
+                shm_zset_delete(base, offset);
+            }
+            shm_zset_insert(base, ZSET_HEADER(base)->used, member,
+                    score, level);
+            ZSET_HEADER(base)->used += node_size;
+            shm_zset_modified(context, entry, entry_offset);
+            return 0;
+        }
+    }
+
+    //no room, rebuild to the new entry, keep the old one when fail
+    if ((result=shm_zset_rebuild(context, base, node_size,
+                    &new_base, &new_size)) != 0)
+    {
+        return result;
+    }
+    if (base != NULL && (offset=shm_zset_find_member(
+                    new_base, member)) > 0)
+    {
+        shm_zset_delete(new_base, offset);
+    }
+    shm_zset_insert(new_base, ZSET_HEADER(new_base)->used, member,
+            score, level);
+    ZSET_HEADER(new_base)->used += node_size;
+    if (base != NULL) {
+        result = shm_ht_replace(context, key, entry, new_base, new_size);
+    } else {
+        value.data = new_base;
+        value.length = new_size;
+        value.options = SHMCACHE_SERIALIZER_ZSET;
+        value.expires = HT_CALC_EXPIRES(get_current_time(), ttl);
+        result = shm_ht_set(context, key, &value);
+    }
+    free(new_base);
+    return result;
+}
+
+int shm_zset_remove(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *member)
+{
+    int result;
+    int offset;
+    int64_t entry_offset;
+    struct shm_hash_entry *entry;
+    char *base;
+
+    if ((result=shm_zset_lookup(context, key, &entry,
+                    &entry_offset, &base)) != 0)
+    {
+        return result;
+    }
+    if ((offset=shm_zset_find_member(base, member)) == 0) {
+        return ENOENT;
+    }
+
+    shm_zset_delete(base, offset);
+    shm_zset_modified(context, entry, entry_offset);
+    return 0;
+}
+
+int shm_zset_rank(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *member, const bool reverse,
+        int *rank, int64_t *score)
+{
+    int result;
+    int offset;
+    int traversed;
+    int i;
+    int64_t entry_offset;
+    struct shm_hash_entry *entry;
+    struct shm_zset_node *x;
+    struct shm_zset_node *node;
+    char *base;
+
+    if ((result=shm_zset_lookup(context, key, &entry,
+                    &entry_offset, &base)) != 0)
+    {
+        return result;
+    }
+    if ((offset=shm_zset_find_member(base, member)) == 0) {
+        return ENOENT;
+    }
+
+    node = ZSET_NODE(base, offset);
+    traversed = 0;
+    x = ZSET_HEAD(base);
+    for (i=ZSET_HEADER(base)->level-1; i>=0 && x != node; i--) {
+        while (x->links[i].next > 0 && shm_zset_compare(node->score,
+                    member, ZSET_NODE(base, x->links[i].next)) >= 0)
+        {
+            traversed += x->links[i].span;
+            x = ZSET_NODE(base, x->links[i].next);
+        }
+    }
+
+    *rank = reverse ? ZSET_HEADER(base)->count - traversed : traversed - 1;
+    *score = node->score;
+    return 0;
+}
+
+int shm_zset_range(struct shmcache_context *context,
+        const struct shmcache_key_info *key, const int start,
+        const bool reverse, struct shmcache_zset_item *items,
+        const int size, int *count)
+{
+    int result;
+    int64_t entry_offset;
+    struct shm_hash_entry *entry;
+    struct shm_zset_node *node;
+    char *base;
+
+    *count = 0;
+    if ((result=shm_zset_lookup(context, key, &entry,
+                    &entry_offset, &base)) != 0)
+    {
+        return result;
+    }
+    if (start < 0 || start >= ZSET_HEADER(base)->count) {
+        return 0;
+    }
+
+    node = shm_zset_get_by_rank(base, reverse ?
+            ZSET_HEADER(base)->count - start : start + 1);
+    while (node != NULL && *count < size) {
+        items[*count].score = node->score;
+        items[*count].member_len = node->member_len;
+        memcpy(items[*count].member, ZSET_MEMBER_PTR(node),
+                node->member_len);
+        (*count)++;
+
+        if (reverse) {
+            node = node->prev > 0 ? ZSET_NODE(base, node->prev) : NULL;
+        } else {
+            node = node->links[0].next > 0 ?
+                ZSET_NODE(base, node->links[0].next) : NULL;
+        }
+    }
+    return 0;
+}
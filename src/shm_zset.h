@@ -0,0 +1,85 @@
+//shm_zset.h
+
+#ifndef _SHM_ZSET_H
+#define _SHM_ZSET_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "common_define.h"
+#include "shmcache_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+add the member to the sorted set or update its score, the sorted set is
+created when the key not exist. the skiplist is updated in place when the
+blob has room, otherwise it is rebuilt without the removed nodes.
+the caller should hold the lock
+parameters:
+	context: the context pointer
+    key: the key
+    member: the member
+    score: the score
+    ttl: the time to live in seconds when the sorted set is created
+return error no, 0 for success, EINVAL for the value is not a sorted set,
+    ENOSPC for the sorted set exceeds the max value size
+*/
+int shm_zset_add(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *member,
+        const int64_t score, const int ttl);
+
+/**
+remove the member from the sorted set, the caller should hold the lock
+parameters:
+	context: the context pointer
+    key: the key
+    member: the member
+return error no, 0 for success, ENOENT for not exist
+*/
+int shm_zset_remove(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *member);
+
+/**
+get the rank of the member, the caller should hold the lock
+parameters:
+	context: the context pointer
+    key: the key
+    member: the member
+    reverse: if rank by the score descending
+    rank: return the rank based 0
+    score: return the score
+return error no, 0 for success, ENOENT for not exist
+*/
+int shm_zset_rank(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *member, const bool reverse,
+        int *rank, int64_t *score);
+
+/**
+get the members by rank, the caller should hold the lock
+parameters:
+	context: the context pointer
+    key: the key
+    start: the start rank based 0
+    reverse: if rank by the score descending
+    items: store the members
+    size: the max count of the items
+    count: return the item count
+return error no, 0 for success, ENOENT for the key not exist
+*/
+int shm_zset_range(struct shmcache_context *context,
+        const struct shmcache_key_info *key, const int start,
+        const bool reverse, struct shmcache_zset_item *items,
+        const int size, int *count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -10,6 +10,7 @@
 #include "logger.h"
 #include "shared_func.h"
 #include "ini_file_reader.h"
+#include "system_info.h"
 #include "sched_thread.h"
 #include "shm_object_pool.h"
 #include "shm_striping_allocator.h"
@@ -17,17 +18,31 @@
 #include "shmopt.h"
 #include "shm_list.h"
 #include "shm_lock.h"
+#include "shm_snapshot.h"
+#include "shm_checkpoint.h"
+#include "shm_numa.h"
+#include "shm_namespace.h"
+#include "shm_tag.h"
+#include "shm_lease.h"
+#include "shm_bloom.h"
+#include "shm_compress.h"
+#include "shm_dedup.h"
+#include "shm_chain.h"
+#include "shm_field.h"
+#include "shm_zset.h"
 #include "shmcache.h"
 
 #define SHMCACE_MEM_ALIGN(x, align)  (((x) + (align - 1)) & (~(align - 1)))
 
 //HT for HashTable, VA for Value Allocator
 #define OFFSETS_INDEX_HT_BUCKETS            0　　　//size(shm_memory_info)
-#define OFFSETS_INDEX_HT_POOL_QUEUE         1     //size(shm_memory_info) + 8*max_key_count
-#define OFFSETS_INDEX_VA_POOL_QUEUE_DOING   2     //size(shm_memory_info) + 8*max_key_count + 8*max_key_count
-#define OFFSETS_INDEX_VA_POOL_QUEUE_DONE    3     //size(shm_memory_info) + 8*max_key_count + 8*max_key_count + striping个数 *8
-#define OFFSETS_INDEX_VA_POOL_OBJECT        4     //size(shm_memory_info) + 8*max_key_count + 8*max_key_count + striping个数 *8 + striping个数 *8
-#define OFFSETS_COUNT                       5
+#define OFFSETS_INDEX_HT_POOL_QUEUE         1     //size(shm_memory_info) + 4*ht_capacity
+#define OFFSETS_INDEX_VA_POOL_QUEUE_DOING   2     //size(shm_memory_info) + 4*ht_capacity + 8*max_key_count
+#define OFFSETS_INDEX_VA_POOL_QUEUE_DONE    3     //size(shm_memory_info) + 4*ht_capacity + 8*max_key_count + striping个数 *8
+#define OFFSETS_INDEX_VA_POOL_OBJECT        4     //size(shm_memory_info) + 4*ht_capacity + 8*max_key_count + striping个数 *8 + striping个数 *8
+#define OFFSETS_INDEX_HT_BLOOM              5     //after the striping allocators, aligned by the cache line
+#define OFFSETS_INDEX_HT_DEDUP              6     //the blob buckets after the bloom filter
+#define OFFSETS_COUNT                       7
 
 #define SHM_HASH_TABLE_PROJ_ID      1
 
@@ -73,8 +88,8 @@ static void get_value_striping_count_size(
     }
 
     striping->size = mb_count * 1024 * 1024;
-    if (striping->size < config->max_value_size * 2) {
-        striping->size = config->max_value_size * 2;
+    if (striping->size < shm_chain_get_max_alloc_value_size(config) * 2) {
+        striping->size = shm_chain_get_max_alloc_value_size(config) * 2;
     }
     striping->size = SHMCACE_MEM_ALIGN(striping->size, page_size);
     if (striping->size > segment->size) {
@@ -84,6 +99,19 @@ static void get_value_striping_count_size(
     striping->count.current = 0;
 }
 
+static void shmcache_calc_value_max_count(const int64_t value_max_memory,
+        struct shm_value_size_info *segment,
+        struct shm_value_size_info *striping)
+{
+    segment->count.max = value_max_memory / segment->size;
+    if (segment->count.max == 0) {
+        segment->count.max = 1;
+    } else if (segment->count.max > segment->count.limit) {
+        segment->count.max = segment->count.limit;
+    }
+    striping->count.max = segment->count.max * (segment->size / striping->size);
+}
+
 static int64_t shmcache_get_ht_segment_size(struct shmcache_context *context,
         struct shm_value_size_info *segment,
         struct shm_value_size_info *striping,
@@ -92,8 +120,9 @@ static int64_t shmcache_get_ht_segment_size(struct shmcache_context *context,
     int64_t total_size;
     int64_t va_pool_queue_memory_size;
 
-    get_value_striping_count_size(&context->config, context->config.max_memory,
-            segment, striping);
+    //the allocator metadata is sized for max_memory_limit
+    get_value_striping_count_size(&context->config,
+            context->config.max_memory_limit, segment, striping);
 
     *ht_capacity = shm_ht_get_capacity(context->config.max_key_count + 1);
     total_size = sizeof(struct shm_memory_info);
@@ -120,7 +149,20 @@ static int64_t shmcache_get_ht_segment_size(struct shmcache_context *context,
     ht_offsets[OFFSETS_INDEX_VA_POOL_OBJECT] = total_size;
     total_size += shm_object_pool_get_object_memory_size(sizeof(struct shm_striping_allocator), striping->count.max);
 
-    get_value_striping_count_size(&context->config, context->config.max_memory - total_size,
+    total_size = SHMCACE_MEM_ALIGN(total_size, SHM_BLOOM_BLOCK_SIZE);
+    ht_offsets[OFFSETS_INDEX_HT_BLOOM] = total_size;
+    total_size += (int64_t)SHM_BLOOM_BLOCK_SIZE *
+        shm_bloom_get_block_count(&context->config);
+
+    ht_offsets[OFFSETS_INDEX_HT_DEDUP] = total_size;
+    total_size += shm_dedup_get_memory_size(
+            shm_dedup_get_capacity(&context->config));
+
+    get_value_striping_count_size(&context->config, context->config.max_memory_limit - total_size,
+            segment, striping);
+    segment->count.limit = segment->count.max;
+    striping->count.limit = striping->count.max;
+    shmcache_calc_value_max_count(context->config.max_memory - total_size,
             segment, striping);
     return total_size;
 }
@@ -159,7 +201,7 @@ static int shmcache_do_init(struct shmcache_context *context,
             &context->memory->value_allocator.doing,
             sizeof(struct shm_striping_allocator),
             ht_offsets[OFFSETS_INDEX_VA_POOL_OBJECT],
-            context->memory->vm_info.striping.count.max + 1,
+            context->memory->vm_info.striping.count.limit + 1,
             queue_base, false);
 
     queue_base = (int64_t *)(context->segments.hashtable.base + ht_offsets[OFFSETS_INDEX_VA_POOL_QUEUE_DONE]);
@@ -167,7 +209,7 @@ static int shmcache_do_init(struct shmcache_context *context,
             &context->memory->value_allocator.done,
             sizeof(struct shm_striping_allocator),
             ht_offsets[OFFSETS_INDEX_VA_POOL_OBJECT],
-            context->memory->vm_info.striping.count.max + 1,
+            context->memory->vm_info.striping.count.limit + 1,
             queue_base, false);
 
 	return 0;
@@ -193,10 +235,21 @@ static int shmcache_do_lock_init(struct shmcache_context *context,
         context->memory->vm_info.striping = *striping;
 
         shm_ht_init(context, ht_capacity);
-        shm_list_init(context);
+        shm_ns_init(context);
+        shm_tag_init(context);
+        shm_lease_init(context);
+        shm_bloom_init(context, shm_bloom_get_block_count(&context->config),
+                ht_offsets[OFFSETS_INDEX_HT_BLOOM],
+                context->config.bloom_filter.counters_per_key);
+        shm_dedup_init(context, shm_dedup_get_capacity(&context->config),
+                ht_offsets[OFFSETS_INDEX_HT_DEDUP]);
+        shm_chain_init(context, context->config.chain.part_size);
         if ((result=shmcache_do_init(context, ht_offsets)) != 0) {
             break;
         }
+        if ((result=shm_checkpoint_init(context)) != 0) {
+            break;
+        }
 
         context->memory->init_time = context->memory->stats.init_time = context->memory->stats.last.calc_time = get_current_time();
         context->memory->usage.alloced = context->segments.hashtable.size;
@@ -286,18 +339,18 @@ static int shmcache_check_segement(struct shm_value_size_info *shm,
     if (shm->size != cfg->size) {
         logError("file: "__FILE__", line: %d, "
                 "shm %s size: %"PRId64" != calculated by "
-                "config: %"PRId64", maybe config max_memory "
+                "config: %"PRId64", maybe config max_memory_limit "
                 "or segment_size changed", __LINE__, label,
                 shm->size, cfg->size);
         return EINVAL;
     }
 
-    if (shm->count.max != cfg->count.max) {
+    if (shm->count.limit != cfg->count.limit) {
         logError("file: "__FILE__", line: %d, "
-                "shm %s max count: %d !=  calculated by "
-                "config count: %d, maybe config max_memory "
+                "shm %s limit count: %d !=  calculated by "
+                "config count: %d, maybe config max_memory_limit "
                 "or segment_size changed", __LINE__, label,
-                shm->count.max, cfg->count.max);
+                shm->count.limit, cfg->count.limit);
         return EINVAL;
     }
     return 0;
@@ -333,6 +386,38 @@ static int shmcache_check(struct shmcache_context *context,
         return EINVAL;
     }
 
+    if (context->memory->bloom.block_count != shm_bloom_get_block_count(
+                &context->config))
+    {
+        logError("file: "__FILE__", line: %d, "
+                "shm bloom filter block count: %d != calculated by "
+                "config: %d, maybe config bloom_filter.enabled or "
+                "bloom_filter.counters_per_key changed", __LINE__,
+                context->memory->bloom.block_count,
+                shm_bloom_get_block_count(&context->config));
+        return EINVAL;
+    }
+
+    if (context->memory->dedup.capacity != shm_dedup_get_capacity(
+                &context->config))
+    {
+        logError("file: "__FILE__", line: %d, "
+                "shm dedup capacity: %d != calculated by config: %d, "
+                "maybe config dedup.threshold enabled or disabled",
+                __LINE__, context->memory->dedup.capacity,
+                shm_dedup_get_capacity(&context->config));
+        return EINVAL;
+    }
+
+    if (context->memory->chain.part_size != context->config.chain.part_size) {
+        logError("file: "__FILE__", line: %d, "
+                "shm chain part size: %d != config: %d, "
+                "maybe config chain.part_size changed", __LINE__,
+                context->memory->chain.part_size,
+                context->config.chain.part_size);
+        return EINVAL;
+    }
+
     if ((result=shmcache_check_segement(&context->memory->vm_info.segment,
                     segment, "segment")) != 0)
     {
@@ -347,6 +432,85 @@ static int shmcache_check(struct shmcache_context *context,
     return 0;
 }
 
+//raise the max segment count in shm, the new value segments are
+//created on demand and opened by other processes lazily
+static int shmcache_grow_value_memory(struct shmcache_context *context,
+        struct shm_value_size_info *segment,
+        struct shm_value_size_info *striping)
+{
+    int result;
+    int old_max;
+
+    if (segment->count.max <= context->memory->vm_info.segment.count.max) {
+        if (segment->count.max < context->memory->vm_info.segment.count.max) {
+            logWarning("file: "__FILE__", line: %d, "
+                    "shm max segment count: %d > calculated by config "
+                    "max_memory: %d, decrease max_memory online "
+                    "is not supported", __LINE__,
+                    context->memory->vm_info.segment.count.max,
+                    segment->count.max);
+        }
+        return 0;
+    }
+
+    if ((result=shm_lock(context)) != 0) {
+        return result;
+    }
+    old_max = context->memory->vm_info.segment.count.max;
+    if (segment->count.max > old_max) {
+        context->memory->vm_info.segment.count.max = segment->count.max;
+        context->memory->vm_info.striping.count.max = striping->count.max;
+    }
+    shm_unlock(context);
+
+    if (segment->count.max > old_max) {
+        logInfo("file: "__FILE__", line: %d, pid: %d, "
+                "max value segment count grow from %d to %d, "
+                "max memory: %"PRId64" MB", __LINE__, context->pid,
+                old_max, segment->count.max, (context->segments.
+                    hashtable.size + segment->size * segment->
+                    count.max) / (1024 * 1024));
+    }
+    return 0;
+}
+
+//the segment index of the entry offset is 8 bits, at most 255 segments,
+//raise the segment size for the large max_memory_limit
+static int shmcache_check_segment_size(struct shmcache_config *config)
+{
+    int64_t segment_size;
+
+    if (config->segment_size > SHM_HENTRY_MAX_SEGMENT_SIZE) {
+        logWarning("file: "__FILE__", line: %d, "
+                "segment_size: %"PRId64" is too large, set to %"PRId64,
+                __LINE__, config->segment_size,
+                (int64_t)SHM_HENTRY_MAX_SEGMENT_SIZE);
+        config->segment_size = SHM_HENTRY_MAX_SEGMENT_SIZE;
+    }
+    if (config->max_memory_limit / config->segment_size <=
+            SHM_HENTRY_MAX_SEGMENT_COUNT)
+    {
+        return 0;
+    }
+
+    segment_size = (config->max_memory_limit +
+            SHM_HENTRY_MAX_SEGMENT_COUNT - 1) / SHM_HENTRY_MAX_SEGMENT_COUNT;
+    if (segment_size > SHM_HENTRY_MAX_SEGMENT_SIZE) {
+        logError("file: "__FILE__", line: %d, "
+                "max_memory_limit: %"PRId64" is too large, exceeds "
+                "%d segments of %"PRId64" bytes", __LINE__,
+                config->max_memory_limit, SHM_HENTRY_MAX_SEGMENT_COUNT,
+                (int64_t)SHM_HENTRY_MAX_SEGMENT_SIZE);
+        return EOVERFLOW;
+    }
+    logWarning("file: "__FILE__", line: %d, "
+            "segment_size: %"PRId64" is too small for max_memory_limit: "
+            "%"PRId64", set to %"PRId64, __LINE__, config->segment_size,
+            config->max_memory_limit, segment_size);
+    config->segment_size = segment_size;
+    return 0;
+}
+
 int shmcache_init(struct shmcache_context *context,
 		struct shmcache_config *config, const bool create_segment,
         const bool check_segment)
@@ -365,6 +529,31 @@ int shmcache_init(struct shmcache_context *context,
     context->pid = getpid();
     context->lock_fd = -1;
     context->create_segment = create_segment;
+    if (context->config.max_memory_limit < context->config.max_memory) {
+        context->config.max_memory_limit = context->config.max_memory;
+    }
+    if ((result=shmcache_check_segment_size(&context->config)) != 0) {
+        return result;
+    }
+    if (context->config.checkpoint.enabled &&
+            context->config.type != SHMCACHE_TYPE_MMAP)
+    {
+        logWarning("file: "__FILE__", line: %d, "
+                "checkpoint is only supported by mmap type, disable it",
+                __LINE__);
+        context->config.checkpoint.enabled = false;
+    }
+    if (context->config.bloom_filter.counters_per_key <= 0) {
+        context->config.bloom_filter.counters_per_key =
+            SHMCACHE_DEFAULT_BLOOM_COUNTERS_PER_KEY;
+    }
+
+    //设置死锁检测的相关参数
+    if (context->config.lock_policy.trylock_interval_us > 0) {
+            context->detect_deadlock_clocks = 1000 * context->config.
+            lock_policy.detect_deadlock_interval_ms / context->config.
+            lock_policy.trylock_interval_us;
+    }
 
     ht_segment_size = shmcache_get_ht_segment_size(context, &segment, &striping, &ht_capacity, ht_offsets);   //共享内存大小
 
@@ -375,9 +564,13 @@ int shmcache_init(struct shmcache_context *context,
     {
         return result;
     }
+    if (!ht_segemnt_exists && create_segment) {
+        shm_numa_apply_policy(context, SHM_NUMA_HASHTABLE_SEGMENT,
+                context->segments.hashtable.base, ht_segment_size);
+    }
 
     //创建shmcache_segment_info池
-    bytes = sizeof(struct shmcache_segment_info) * segment.count.max;
+    bytes = sizeof(struct shmcache_segment_info) * segment.count.limit;
     context->segments.values.items = (struct shmcache_segment_info *)malloc(bytes);
     if (context->segments.values.items == NULL) {
         logError("file: "__FILE__", line: %d, "
@@ -387,11 +580,21 @@ int shmcache_init(struct shmcache_context *context,
     memset(context->segments.values.items, 0, bytes);
 
     context->memory = (struct shm_memory_info *)context->segments.hashtable.base;
-    shm_list_set(context, context->segments.hashtable.base, &context->memory->hashtable.head);
     shmcache_set_obj_allocators(context, ht_offsets);
-    if (ht_segemnt_exists && check_segment && (result=shmcache_check(context, &segment, &striping)) != 0)
-    {
-        return result;
+    if (ht_segemnt_exists && check_segment) {
+        if ((result=shmcache_check(context, &segment, &striping)) != 0) {
+            return result;
+        }
+        if (context->memory->checkpoint.enabled &&
+                (result=shm_checkpoint_recover(context)) != 0)
+        {
+            return result;
+        }
+        if (create_segment && (result=shmcache_grow_value_memory(
+                        context, &segment, &striping)) != 0)
+        {
+            return result;
+        }
     }
 
     //初始化 所有segment，hash表（数据结构太多、之间的关系太复杂，没看懂！！！）
@@ -419,14 +622,15 @@ int shmcache_init(struct shmcache_context *context,
             }
             shm_unlock(context);   //解锁
         }
-    }
 
-    //设置死锁检测的相关参数
-    if (context->config.lock_policy.trylock_interval_us > 0) {
-            context->detect_deadlock_clocks = 1000 * context->config.
-            lock_policy.detect_deadlock_interval_ms / context->config.
-            lock_policy.trylock_interval_us;
+        if (result == 0 && context->config.namespaces.count > 0) {
+            if ((result=shm_lock(context)) == 0) {
+                result = shm_ns_sync_config(context);
+                shm_unlock(context);
+            }
+        }
     }
+
     logDebug("file: "__FILE__", line: %d, "
             "doing count: %d, done count: %d, "
             "total entry count: %d", __LINE__,
@@ -445,13 +649,16 @@ int shmcache_init(struct shmcache_context *context,
         int64_t bytes;
         int ii;
 
-        logInfo("list count: %d", shm_list_count(context));
+        logInfo("list count: %d", shm_list_count(context,
+                    &SHM_NS_PTR(context, context->ns_index)->head));
         ii = 0;
         bytes = 0;
-        SHM_LIST_FOR_EACH(context, current, list) {
+        SHM_LIST_FOR_EACH(context, &SHM_NS_PTR(context,
+                    context->ns_index)->head, current, list) {
 
             key.data = current->key;
             key.length = current->key_len;
+            key.hashed = 0;
 
             if (shm_ht_get(context, &key, &value) != 0) {
                 logError("#%d. shm_ht_get key: %.*s fail, offset: %"PRId64
@@ -547,6 +754,184 @@ static int64_t shmcache_parse_bytes_with_default(IniContext *iniContext,
     return size;
 }
 
+//the percentage of the container memory for max_memory = auto
+#define SHMCACHE_AUTO_MEMORY_PERCENT  50
+
+//the default expected avg. size of key + value for max_key_count = auto
+#define SHMCACHE_DEFAULT_AVG_ENTRY_SIZE  1024
+
+/* parse the memory size, the value can be:
+ *   bytes such as 1G,
+ *   percentage of the container memory such as 50%,
+ *   or auto for SHMCACHE_AUTO_MEMORY_PERCENT of the container memory.
+ * the container memory is the less one of the system total memory size
+ * and the cgroup memory limit
+ */
+static int64_t shmcache_parse_memory(IniContext *iniContext,
+        const char *config_filename, const char *name,
+        const bool required, const int64_t def_value, int *result)
+{
+    char *value;
+    char *end;
+    double percent;
+    int64_t mem_size;
+    int len;
+
+    value = iniGetStrValue(NULL, name, iniContext);
+    if (value == NULL || *value == '\0') {
+        if (required) {
+            return shmcache_parse_bytes(iniContext,
+                    config_filename, name, result);
+        }
+        *result = 0;
+        return def_value;
+    }
+
+    len = strlen(value);
+    if (strcasecmp(value, "auto") == 0) {
+        percent = SHMCACHE_AUTO_MEMORY_PERCENT;
+    } else if (value[len - 1] == '%') {
+        percent = strtod(value, &end);
+        if (end != value + len - 1 || percent <= 0.00 || percent > 100.00) {
+            logError("file: "__FILE__", line: %d, "
+                    "config file: %s, item \"%s\": %s is invalid, "
+                    "the percentage should in (0%%, 100%%]",
+                    __LINE__, config_filename, name, value);
+            *result = EINVAL;
+            return -1;
+        }
+    } else if (required) {
+        return shmcache_parse_bytes(iniContext,
+                config_filename, name, result);
+    } else {
+        return shmcache_parse_bytes_with_default(iniContext,
+                config_filename, name, def_value, result);
+    }
+
+    if ((*result=get_container_mem_size(&mem_size)) != 0) {
+        return -1;
+    }
+    logInfo("file: "__FILE__", line: %d, "
+            "config file: %s, item \"%s\": %s, container memory: "
+            "%"PRId64" MB, set to %"PRId64" MB", __LINE__, config_filename,
+            name, value, mem_size / (1024 * 1024), (int64_t)(mem_size *
+                percent / 100.00) / (1024 * 1024));
+    return (int64_t)(mem_size * percent / 100.00);
+}
+
+//calculate the max key count by the expected avg. entry size
+static int shmcache_calc_max_key_count(const int64_t max_memory,
+        const int64_t avg_entry_size)
+{
+    int64_t count;
+
+    count = max_memory / (sizeof(struct shm_hash_entry) +
+            MEM_ALIGN(avg_entry_size));
+    if (count > INT32_MAX / 2) {
+        count = INT32_MAX / 2;
+    } else if (count <= 0) {
+        count = 1;
+    }
+    return count;
+}
+
+/* parse the namespace items, the format is name[:quota] such as:
+ *   namespace = sessions:256M
+ *   namespace = pages:20%
+ * the quota can be bytes or the percentage of max_memory,
+ * empty or 0 for unlimited
+ */
+static int shmcache_parse_namespaces(IniContext *iniContext,
+        const char *config_filename, struct shmcache_config *config)
+{
+    char *values[SHMCACHE_MAX_NAMESPACES + 1];
+    char buff[FAST_INI_ITEM_VALUE_LEN + 1];
+    char *name;
+    char *quota;
+    char *end;
+    double percent;
+    int64_t bytes;
+    int result;
+    int count;
+    int len;
+    int i;
+    int k;
+
+    config->namespaces.count = 0;
+    count = iniGetValues(NULL, "namespace", iniContext,
+            values, SHMCACHE_MAX_NAMESPACES + 1);
+    if (count > SHMCACHE_MAX_NAMESPACES) {
+        logError("file: "__FILE__", line: %d, "
+                "config file: %s, namespace count exceeds %d",
+                __LINE__, config_filename, SHMCACHE_MAX_NAMESPACES);
+        return EINVAL;
+    }
+
+    for (i=0; i<count; i++) {
+        snprintf(buff, sizeof(buff), "%s", values[i]);
+        name = buff;
+        quota = strchr(buff, ':');
+        if (quota != NULL) {
+            *quota++ = '\0';
+            trim(quota);
+        }
+        trim(name);
+
+        len = strlen(name);
+        if (len == 0 || len >= SHMCACHE_MAX_NAMESPACE_SIZE) {
+            logError("file: "__FILE__", line: %d, "
+                    "config file: %s, invalid namespace: %s, the name "
+                    "length should in [1, %d)", __LINE__, config_filename,
+                    values[i], SHMCACHE_MAX_NAMESPACE_SIZE);
+            return EINVAL;
+        }
+        for (k=0; k<config->namespaces.count; k++) {
+            if (strcmp(config->namespaces.items[k].name, name) == 0) {
+                logError("file: "__FILE__", line: %d, "
+                        "config file: %s, duplicate namespace: %s",
+                        __LINE__, config_filename, name);
+                return EEXIST;
+            }
+        }
+
+        if (quota == NULL || *quota == '\0') {
+            bytes = 0;
+        } else {
+            len = strlen(quota);
+            if (quota[len - 1] == '%') {
+                percent = strtod(quota, &end);
+                if (end != quota + len - 1 || percent <= 0.00 ||
+                        percent > 100.00)
+                {
+                    logError("file: "__FILE__", line: %d, "
+                            "config file: %s, namespace: %s, quota: %s "
+                            "is invalid, the percentage should in "
+                            "(0%%, 100%%]", __LINE__, config_filename,
+                            name, quota);
+                    return EINVAL;
+                }
+                bytes = (int64_t)(config->max_memory * percent / 100.00);
+            } else if ((result=parse_bytes(quota, 1, &bytes)) != 0) {
+                return result;
+            }
+            if (bytes < 0) {
+                logError("file: "__FILE__", line: %d, "
+                        "config file: %s, namespace: %s, "
+                        "quota: %s is invalid", __LINE__,
+                        config_filename, name, quota);
+                return EINVAL;
+            }
+        }
+
+        snprintf(config->namespaces.items[i].name,
+                sizeof(config->namespaces.items[i].name), "%s", name);
+        config->namespaces.items[i].quota = bytes;
+        config->namespaces.count++;
+    }
+
+    return 0;
+}
+
 int shmcache_load_config(struct shmcache_config *config,
 		const char *config_filename)
 {
@@ -555,6 +940,8 @@ int shmcache_load_config(struct shmcache_config *config,
     char *type;
     char *filename;
     char *hash_function;
+    char *max_key_count;
+    int64_t avg_entry_size;
 
     if ((result=iniLoadFromFile(config_filename, &iniContext)) != 0) {
         return result;
@@ -579,33 +966,62 @@ int shmcache_load_config(struct shmcache_config *config,
         snprintf(config->filename, sizeof(config->filename),
                 "%s", filename);
 
-        config->max_memory = shmcache_parse_bytes(&iniContext,
-                config_filename, "max_memory", &result);
+        config->max_memory = shmcache_parse_memory(&iniContext,
+                config_filename, "max_memory", true, 0, &result);
         if (result != 0) {
             break;
         }
 
-        config->min_memory = shmcache_parse_bytes_with_default(&iniContext,
-                config_filename, "min_memory", 0, &result);
+        config->min_memory = shmcache_parse_memory(&iniContext,
+                config_filename, "min_memory", false, 0, &result);
 
-        config->segment_size = shmcache_parse_bytes(&iniContext,
-                config_filename, "segment_size", &result);
+        config->max_memory_limit = shmcache_parse_memory(
+                &iniContext, config_filename, "max_memory_limit",
+                false, config->max_memory, &result);
         if (result != 0) {
             break;
         }
-        if (config->max_memory / config->segment_size > 255) {
-            int64_t segment_size;
-            segment_size = config->max_memory / 255;
+        if (config->max_memory_limit < config->max_memory) {
             logWarning("file: "__FILE__", line: %d, "
-                    "config file: %s, segment_size: %"PRId64
-                    " is too small, set to %"PRId64,
+                    "config file: %s, max_memory_limit: %"PRId64
+                    " < max_memory: %"PRId64", set to max_memory",
                     __LINE__, config_filename,
-                    config->segment_size, segment_size);
-            config->segment_size = segment_size;
+                    config->max_memory_limit, config->max_memory);
+            config->max_memory_limit = config->max_memory;
+        }
+
+        config->segment_size = shmcache_parse_bytes(&iniContext,
+                config_filename, "segment_size", &result);
+        if (result != 0) {
+            break;
+        }
+        if ((result=shmcache_check_segment_size(config)) != 0) {
+            break;
         }
 
-        config->max_key_count = iniGetIntValue(NULL, "max_key_count",
-                &iniContext, 0);
+        max_key_count = iniGetStrValue(NULL, "max_key_count", &iniContext);
+        if (max_key_count != NULL && strcasecmp(max_key_count, "auto") == 0) {
+            avg_entry_size = shmcache_parse_bytes_with_default(&iniContext,
+                    config_filename, "avg_entry_size",
+                    SHMCACHE_DEFAULT_AVG_ENTRY_SIZE, &result);
+            if (result != 0) {
+                break;
+            }
+            if (avg_entry_size <= 0) {
+                avg_entry_size = SHMCACHE_DEFAULT_AVG_ENTRY_SIZE;
+            }
+
+            //the hashtable is sized for the memory which can grow to
+            config->max_key_count = shmcache_calc_max_key_count(
+                    config->max_memory_limit, avg_entry_size);
+            logInfo("file: "__FILE__", line: %d, "
+                    "config file: %s, avg_entry_size: %"PRId64", "
+                    "set max_key_count to %d", __LINE__, config_filename,
+                    avg_entry_size, config->max_key_count);
+        } else {
+            config->max_key_count = iniGetIntValue(NULL, "max_key_count",
+                    &iniContext, 0);
+        }
         if (config->max_key_count <= 0) {
             logError("file: "__FILE__", line: %d, "
                     "config file: %s, item \"max_key_count\" "
@@ -689,6 +1105,98 @@ int shmcache_load_config(struct shmcache_config *config,
         if (config->recycle_key_once <= 0) {
             config->recycle_key_once = -1;
         }
+
+        config->numa.policy = shm_numa_parse_policy(iniGetStrValue(
+                    NULL, "numa.policy", &iniContext));
+        if (config->numa.policy < 0) {
+            logError("file: "__FILE__", line: %d, "
+                    "config file: %s, invalid item \"numa.policy\"",
+                    __LINE__, config_filename);
+            result = EINVAL;
+            break;
+        }
+        if (config->numa.policy != SHMCACHE_NUMA_POLICY_NONE) {
+            if ((result=shm_numa_parse_nodes(iniGetStrValue(NULL,
+                                "numa.nodes", &iniContext),
+                            config->numa.nodes,
+                            &config->numa.node_count)) != 0)
+            {
+                break;
+            }
+        }
+
+        config->checkpoint.enabled = iniGetBoolValue(NULL,
+                "checkpoint.enabled", &iniContext, false);
+        if (config->checkpoint.enabled &&
+                config->type != SHMCACHE_TYPE_MMAP)
+        {
+            logWarning("file: "__FILE__", line: %d, "
+                    "config file: %s, checkpoint is only supported "
+                    "by mmap type, disable it", __LINE__, config_filename);
+            config->checkpoint.enabled = false;
+        }
+
+        config->bloom_filter.enabled = iniGetBoolValue(NULL,
+                "bloom_filter.enabled", &iniContext, false);
+        config->bloom_filter.counters_per_key = iniGetIntValue(NULL,
+                "bloom_filter.counters_per_key", &iniContext,
+                SHMCACHE_DEFAULT_BLOOM_COUNTERS_PER_KEY);
+        if (config->bloom_filter.counters_per_key <= 0) {
+            logWarning("file: "__FILE__", line: %d, "
+                    "config file: %s, invalid bloom_filter.counters_per_key: "
+                    "%d, set to %d", __LINE__, config_filename,
+                    config->bloom_filter.counters_per_key,
+                    SHMCACHE_DEFAULT_BLOOM_COUNTERS_PER_KEY);
+            config->bloom_filter.counters_per_key =
+                SHMCACHE_DEFAULT_BLOOM_COUNTERS_PER_KEY;
+        }
+
+        config->compress.threshold = shmcache_parse_bytes_with_default(
+                &iniContext, config_filename, "compress.threshold",
+                0, &result);
+        if (result != 0) {
+            break;
+        }
+        if (config->compress.threshold < 0) {
+            config->compress.threshold = 0;
+        }
+
+        config->dedup.threshold = shmcache_parse_bytes_with_default(
+                &iniContext, config_filename, "dedup.threshold",
+                0, &result);
+        if (result != 0) {
+            break;
+        }
+        if (config->dedup.threshold < 0) {
+            config->dedup.threshold = 0;
+        }
+
+        config->chain.part_size = shmcache_parse_bytes_with_default(
+                &iniContext, config_filename, "chain.part_size",
+                0, &result);
+        if (result != 0) {
+            break;
+        }
+        if (config->chain.part_size < 0 || config->chain.part_size >=
+                config->max_value_size)
+        {
+            //the value always fits in one part
+            config->chain.part_size = 0;
+        } else if (config->chain.part_size > 0 && config->chain.part_size <
+                SHM_CHAIN_MIN_PART_SIZE)
+        {
+            logWarning("file: "__FILE__", line: %d, "
+                    "config file: %s, chain.part_size: %d is too small, "
+                    "set to %d", __LINE__, config_filename,
+                    config->chain.part_size, SHM_CHAIN_MIN_PART_SIZE);
+            config->chain.part_size = SHM_CHAIN_MIN_PART_SIZE;
+        }
+
+        if ((result=shmcache_parse_namespaces(&iniContext,
+                        config_filename, config)) != 0)
+        {
+            break;
+        }
         load_log_level(&iniContext);
     } while (0);
 
@@ -744,88 +1252,610 @@ int shmcache_set_ex(struct shmcache_context *context,
         const struct shmcache_value_info *value)
 {
     int result;
+    struct shmcache_value_info stored;
+
+    if ((result=shm_compress_value(context, value, &stored)) != 0) {
+        return result;
+    }
 
     //加posix锁。如果多次加锁失败，则 检测是否死锁了（解除死锁，然后清空shm cache）。
     if ((result=shm_lock(context)) != 0) {
         return result;
     }
     context->memory->stats.hashtable.set.total++;
-    result = shm_ht_set(context, key, value);
+    SHM_NS_PTR(context, context->ns_index)->stats.set.total++;
+    result = shm_ht_set(context, key, &stored);
     if (result == 0) {
         context->memory->stats.hashtable.set.success++;
+        SHM_NS_PTR(context, context->ns_index)->stats.set.success++;
     }
     shm_unlock(context);
     return result;
 }
 
-int shmcache_set(struct shmcache_context *context,
-        const struct shmcache_key_info *key,
-        const char *data, const int data_len, const int ttl)
-{
-    struct shmcache_value_info value;
-    value.options = SHMCACHE_SERIALIZER_STRING;
-    value.data = (char *)data;
-    value.length = data_len;
-    value.expires = HT_CALC_EXPIRES(get_current_time(), ttl);
-    return shmcache_set_ex(context, key, &value);
-}
-
-int shmcache_get(struct shmcache_context *context,
+int shmcache_set_with_tags(struct shmcache_context *context,
         const struct shmcache_key_info *key,
-        struct shmcache_value_info *value)
+        const struct shmcache_value_info *value,
+        const struct shmcache_key_info *tags, const int tag_count)
 {
     int result;
+    int i;
+    uint32_t slots[SHMCACHE_MAX_TAGS];
+    struct shmcache_value_info stored;
 
-    __sync_add_and_fetch(&context->memory->stats.hashtable.get.total, 1);
-    result = shm_ht_get(context, key, value);
-    if (result == 0) {
-        __sync_add_and_fetch(&context->memory->stats.hashtable.get.success, 1);
+    if (tag_count < 0 || tag_count > SHMCACHE_MAX_TAGS) {
+        logError("file: "__FILE__", line: %d, "
+                "invalid tag count: %d, should in [0, %d]",
+                __LINE__, tag_count, SHMCACHE_MAX_TAGS);
+        return EINVAL;
+    }
+    for (i=0; i<tag_count; i++) {
+        slots[i] = shm_tag_get_slot(context, context->ns_index, tags + i);
+    }
+    if ((result=shm_compress_value(context, value, &stored)) != 0) {
+        return result;
     }
-    return result;
-}
 
-int shmcache_delete(struct shmcache_context *context,
-        const struct shmcache_key_info *key)
-{
-    int result;
     if ((result=shm_lock(context)) != 0) {
         return result;
     }
-    context->memory->stats.hashtable.del.total++;
-    result = shm_ht_delete(context, key);
+    context->memory->stats.hashtable.set.total++;
+    SHM_NS_PTR(context, context->ns_index)->stats.set.total++;
+    result = shm_ht_set_ex(context, context->ns_index, key, &stored, 0,
+            slots, tag_count);
     if (result == 0) {
-        context->memory->stats.hashtable.del.success++;
+        context->memory->stats.hashtable.set.success++;
+        SHM_NS_PTR(context, context->ns_index)->stats.set.success++;
     }
     shm_unlock(context);
     return result;
 }
 
-int shmcache_incr(struct shmcache_context *context,
-        const struct shmcache_key_info *key,
-        const int64_t increment,
-        const int ttl, int64_t *new_value)
+int shmcache_invalidate_tag(struct shmcache_context *context,
+        const struct shmcache_key_info *tag)
 {
     int result;
-    struct shmcache_value_info value;
-    char *endptr;
-    char buff[24];
+    uint32_t slot;
 
+    slot = shm_tag_get_slot(context, context->ns_index, tag);
     if ((result=shm_lock(context)) != 0) {
         return result;
     }
+    shm_tag_invalidate(context, slot);
+    shm_unlock(context);
+    return 0;
+}
 
-    do {
-        result = shm_ht_get(context, key, &value);
-        if (result == 0) {
-            if (value.length >= sizeof(buff)) {
-                logError("file: "__FILE__", line: %d, "
-                        "key: %.*s, value length: %d exceeds %d",
-                        __LINE__, key->length, key->data,
-                        value.length, (int)sizeof(buff));
-                result = EINVAL;
-                break;
-            }
-            memcpy(buff, value.data, value.length);
+int shmcache_set(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const char *data, const int data_len, const int ttl)
+{
+    struct shmcache_value_info value;
+    value.options = SHMCACHE_SERIALIZER_STRING;
+    value.data = (char *)data;
+    value.length = data_len;
+    value.expires = HT_CALC_EXPIRES(get_current_time(), ttl);
+    return shmcache_set_ex(context, key, &value);
+}
+
+int shmcache_set_with_soft_ttl(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const char *data, const int data_len,
+        const int soft_ttl, const int hard_ttl)
+{
+    int result;
+    time_t current_time;
+    struct shmcache_value_info value;
+    struct shmcache_value_info stored;
+
+    if (soft_ttl <= 0 || (hard_ttl != SHMCACHE_NEVER_EXPIRED &&
+                soft_ttl >= hard_ttl))
+    {
+        logError("file: "__FILE__", line: %d, "
+                "invalid soft ttl: %d, hard ttl: %d, the soft ttl should "
+                "> 0 and < the hard ttl", __LINE__, soft_ttl, hard_ttl);
+        return EINVAL;
+    }
+
+    current_time = get_current_time();
+    value.options = SHMCACHE_SERIALIZER_STRING;
+    value.data = (char *)data;
+    value.length = data_len;
+    value.expires = HT_CALC_EXPIRES(current_time, hard_ttl);
+    if ((result=shm_compress_value(context, &value, &stored)) != 0) {
+        return result;
+    }
+    if ((result=shm_lock(context)) != 0) {
+        return result;
+    }
+    context->memory->stats.hashtable.set.total++;
+    SHM_NS_PTR(context, context->ns_index)->stats.set.total++;
+    result = shm_ht_set_ex(context, context->ns_index, key, &stored,
+            current_time + soft_ttl, NULL, 0);
+    if (result == 0) {
+        context->memory->stats.hashtable.set.success++;
+        SHM_NS_PTR(context, context->ns_index)->stats.set.success++;
+    }
+    shm_unlock(context);
+    return result;
+}
+
+//uncompress the value returned by get, include the stale one
+static inline int shmcache_uncompress(struct shmcache_context *context,
+        struct shmcache_value_info *value, const int result)
+{
+    if ((result == 0 || result == ETIMEDOUT) &&
+            (value->options & SHMCACHE_OPTIONS_COMPRESSED) != 0)
+    {
+        return shm_uncompress_value(context, value);
+    }
+    return result;
+}
+
+int shmcache_get_ex(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        struct shmcache_value_info *value, const bool elect_refresher)
+{
+    int result;
+
+    __sync_add_and_fetch(&context->memory->stats.hashtable.get.total, 1);
+    __sync_add_and_fetch(&SHM_NS_PTR(context, context->ns_index)->
+            stats.get.total, 1);
+    result = shmcache_uncompress(context, value,
+            shm_ht_get_ex(context, key, value, elect_refresher));
+    if (result == ENODATA) {
+        __sync_add_and_fetch(&context->memory->stats.
+                hashtable.tombstone.hit, 1);
+    } else if (result == 0) {
+        __sync_add_and_fetch(&context->memory->stats.hashtable.get.success, 1);
+        __sync_add_and_fetch(&SHM_NS_PTR(context, context->ns_index)->
+                stats.get.success, 1);
+        if (value->stale != SHMCACHE_VALUE_FRESH) {
+            __sync_add_and_fetch(&context->memory->stats.
+                    hashtable.stale.total, 1);
+            if (value->stale == SHMCACHE_VALUE_STALE_REFRESH) {
+                __sync_add_and_fetch(&context->memory->stats.
+                        hashtable.stale.refresh, 1);
+            }
+        }
+    }
+    return result;
+}
+
+int shmcache_get(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        struct shmcache_value_info *value)
+{
+    return shmcache_get_ex(context, key, value, true);
+}
+
+int shmcache_get_or_lease(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        struct shmcache_value_info *value, const int lease_ms,
+        const int wait_ms, int64_t *token)
+{
+    int result;
+    int lease_result;
+    int timeout_ms;
+    uint32_t wake_seq;
+    int64_t expires_ms;
+    int64_t deadline_ms;
+    int64_t current_ms;
+
+    *token = 0;
+    if ((result=shmcache_get(context, key, value)) == 0 ||
+            result == ENODATA)
+    {
+        return result;
+    }
+
+    deadline_ms = get_current_time_ms() + wait_ms;
+    while (1) {
+        if ((lease_result=shm_lock(context)) != 0) {
+            return lease_result;
+        }
+        //maybe filled by others before locked
+        if ((result=shmcache_uncompress(context, value,
+                        shm_ht_get(context, key, value))) == 0 ||
+                result == ENODATA)
+        {
+            shm_unlock(context);
+            return result;
+        }
+        lease_result = shm_lease_acquire(context, context->ns_index,
+                key, lease_ms, token, &wake_seq, &expires_ms);
+        shm_unlock(context);
+
+        if (lease_result != EINPROGRESS) {
+            //the lease granted or unable to lease for the slot conflict
+            return result;
+        }
+
+        if (result == ETIMEDOUT) {   //use the stale value during the fill
+            __sync_add_and_fetch(&context->memory->leases.stats.stale, 1);
+            return EINPROGRESS;
+        }
+
+        current_ms = get_current_time_ms();
+        if (current_ms >= deadline_ms) {
+            return EBUSY;
+        }
+        timeout_ms = (expires_ms < deadline_ms ? expires_ms :
+                deadline_ms) - current_ms;
+        if (timeout_ms <= 0) {
+            timeout_ms = 1;
+        }
+        __sync_add_and_fetch(&context->memory->leases.stats.wait, 1);
+        shm_lease_wait(context, context->ns_index, key, wake_seq, timeout_ms);
+        if ((result=shmcache_uncompress(context, value,
+                        shm_ht_get(context, key, value))) == 0 ||
+                result == ENODATA)
+        {
+            return result;
+        }
+    }
+}
+
+int shmcache_fill_lease(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_value_info *value, const int64_t token)
+{
+    int result;
+    struct shmcache_value_info stored;
+
+    if ((result=shm_compress_value(context, value, &stored)) != 0) {
+        return result;
+    }
+    if ((result=shm_lock(context)) != 0) {
+        return result;
+    }
+
+    do {
+        if ((result=shm_lease_release(context, context->ns_index,
+                        key, token)) != 0)
+        {
+            break;
+        }
+
+        context->memory->stats.hashtable.set.total++;
+        SHM_NS_PTR(context, context->ns_index)->stats.set.total++;
+        if ((result=shm_ht_set(context, key, &stored)) == 0) {
+            context->memory->stats.hashtable.set.success++;
+            SHM_NS_PTR(context, context->ns_index)->stats.set.success++;
+            context->memory->leases.stats.fill++;
+        }
+    } while (0);
+
+    shm_unlock(context);
+    return result;
+}
+
+int shmcache_release_lease(struct shmcache_context *context,
+        const struct shmcache_key_info *key, const int64_t token)
+{
+    int result;
+
+    if ((result=shm_lock(context)) != 0) {
+        return result;
+    }
+    result = shm_lease_release(context, context->ns_index, key, token);
+    shm_unlock(context);
+    return result;
+}
+
+int shmcache_set_int_key(struct shmcache_context *context,
+        const int64_t key, const struct shmcache_value_info *value)
+{
+    int result;
+
+    if ((result=shm_lock(context)) != 0) {
+        return result;
+    }
+    context->memory->stats.hashtable.set.total++;
+    SHM_NS_PTR(context, context->ns_index)->stats.set.total++;
+    result = shm_ht_set_int(context, context->ns_index, key, value);
+    if (result == 0) {
+        context->memory->stats.hashtable.set.success++;
+        SHM_NS_PTR(context, context->ns_index)->stats.set.success++;
+    }
+    shm_unlock(context);
+    return result;
+}
+
+int shmcache_get_int_key(struct shmcache_context *context,
+        const int64_t key, struct shmcache_value_info *value)
+{
+    int result;
+
+    __sync_add_and_fetch(&context->memory->stats.hashtable.get.total, 1);
+    __sync_add_and_fetch(&SHM_NS_PTR(context, context->ns_index)->
+            stats.get.total, 1);
+    result = shm_ht_get_int(context, key, value);
+    if (result == 0) {
+        __sync_add_and_fetch(&context->memory->stats.hashtable.get.success, 1);
+        __sync_add_and_fetch(&SHM_NS_PTR(context, context->ns_index)->
+                stats.get.success, 1);
+    }
+    return result;
+}
+
+int shmcache_delete_int_key(struct shmcache_context *context,
+        const int64_t key)
+{
+    int result;
+    bool recycled;
+
+    if ((result=shm_lock(context)) != 0) {
+        return result;
+    }
+    context->memory->stats.hashtable.del.total++;
+    SHM_NS_PTR(context, context->ns_index)->stats.del.total++;
+    result = shm_ht_delete_int(context, key, &recycled);
+    if (result == 0) {
+        context->memory->stats.hashtable.del.success++;
+        SHM_NS_PTR(context, context->ns_index)->stats.del.success++;
+    }
+    shm_unlock(context);
+    return result;
+}
+
+int shmcache_delete(struct shmcache_context *context,
+        const struct shmcache_key_info *key)
+{
+    int result;
+    if ((result=shm_lock(context)) != 0) {
+        return result;
+    }
+    context->memory->stats.hashtable.del.total++;
+    SHM_NS_PTR(context, context->ns_index)->stats.del.total++;
+    result = shm_ht_delete(context, key);
+    if (result == 0) {
+        context->memory->stats.hashtable.del.success++;
+        SHM_NS_PTR(context, context->ns_index)->stats.del.success++;
+    }
+    shm_unlock(context);
+    return result;
+}
+
+int shmcache_touch(struct shmcache_context *context,
+        const struct shmcache_key_info *key, const int ttl)
+{
+    int result;
+
+    if ((result=shm_lock(context)) != 0) {
+        return result;
+    }
+    context->memory->stats.hashtable.touch.total++;
+    result = shm_ht_touch(context, key, HT_CALC_EXPIRES(
+                get_current_time(), ttl));
+    if (result == 0) {
+        context->memory->stats.hashtable.touch.success++;
+    }
+    shm_unlock(context);
+    return result;
+}
+
+int shmcache_set_tombstone(struct shmcache_context *context,
+        const struct shmcache_key_info *key, const int ttl)
+{
+    int result;
+
+    if (ttl <= 0) {
+        logError("file: "__FILE__", line: %d, "
+                "invalid tombstone ttl: %d, should > 0", __LINE__, ttl);
+        return EINVAL;
+    }
+
+    if ((result=shm_lock(context)) != 0) {
+        return result;
+    }
+    result = shm_ht_set_tombstone(context, key,
+            get_current_time() + ttl);
+    if (result == 0) {
+        context->memory->stats.hashtable.tombstone.set++;
+    }
+    shm_unlock(context);
+    return result;
+}
+
+static int shmcache_write_range(struct shmcache_context *context,
+        const struct shmcache_key_info *key, const int op,
+        const int offset, const char *data, const int data_len)
+{
+    int result;
+    bool in_place;
+
+    if (offset < 0 || data_len < 0) {
+        logError("file: "__FILE__", line: %d, "
+                "invalid offset: %d or data length: %d",
+                __LINE__, offset, data_len);
+        return EINVAL;
+    }
+
+    if ((result=shm_lock(context)) != 0) {
+        return result;
+    }
+    context->memory->stats.hashtable.range.total++;
+    result = shm_ht_write_range(context, key, op, offset,
+            data, data_len, &in_place);
+    if (result == 0) {
+        context->memory->stats.hashtable.range.success++;
+        if (in_place) {
+            context->memory->stats.hashtable.range.in_place++;
+        }
+    }
+    shm_unlock(context);
+    return result;
+}
+
+int shmcache_append(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const char *data, const int data_len)
+{
+    return shmcache_write_range(context, key, HT_RANGE_APPEND,
+            0, data, data_len);
+}
+
+int shmcache_prepend(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const char *data, const int data_len)
+{
+    return shmcache_write_range(context, key, HT_RANGE_PREPEND,
+            0, data, data_len);
+}
+
+int shmcache_setrange(struct shmcache_context *context,
+        const struct shmcache_key_info *key, const int offset,
+        const char *data, const int data_len)
+{
+    return shmcache_write_range(context, key, HT_RANGE_SET,
+            offset, data, data_len);
+}
+
+int shmcache_hget(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *field,
+        struct shmcache_value_info *value)
+{
+    int result;
+
+    __sync_add_and_fetch(&context->memory->stats.hashtable.field.get.total, 1);
+    result = shm_field_get(context, key, field, value);
+    if (result == 0) {
+        __sync_add_and_fetch(&context->memory->stats.
+                hashtable.field.get.success, 1);
+    }
+    return result;
+}
+
+int shmcache_hset(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *field,
+        const char *data, const int data_len, const int ttl)
+{
+    int result;
+    bool in_place;
+
+    if ((result=shm_lock(context)) != 0) {
+        return result;
+    }
+    context->memory->stats.hashtable.field.set.total++;
+    result = shm_field_set(context, key, field, data, data_len,
+            ttl, &in_place);
+    if (result == 0) {
+        context->memory->stats.hashtable.field.set.success++;
+        if (in_place) {
+            context->memory->stats.hashtable.field.in_place++;
+        }
+    }
+    shm_unlock(context);
+    return result;
+}
+
+int shmcache_hincr(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *field,
+        const int64_t increment, const int ttl, int64_t *new_value)
+{
+    int result;
+    bool in_place;
+
+    if ((result=shm_lock(context)) != 0) {
+        return result;
+    }
+    context->memory->stats.hashtable.field.set.total++;
+    result = shm_field_incr(context, key, field, increment, ttl,
+            new_value, &in_place);
+    if (result == 0) {
+        context->memory->stats.hashtable.field.set.success++;
+        if (in_place) {
+            context->memory->stats.hashtable.field.in_place++;
+        }
+    }
+    shm_unlock(context);
+    return result;
+}
+
+#define SHMCACHE_ZSET_CALL(context, op) \
+    do { \
+        if ((result=shm_lock(context)) != 0) { \
+            return result; \
+        } \
+        context->memory->stats.hashtable.zset.total++; \
+        if ((result=op) == 0) { \
+            context->memory->stats.hashtable.zset.success++; \
+        } \
+        shm_unlock(context); \
+    } while (0)
+
+int shmcache_zadd(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *member,
+        const int64_t score, const int ttl)
+{
+    int result;
+    SHMCACHE_ZSET_CALL(context, shm_zset_add(context, key,
+                member, score, ttl));
+    return result;
+}
+
+int shmcache_zrem(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *member)
+{
+    int result;
+    SHMCACHE_ZSET_CALL(context, shm_zset_remove(context, key, member));
+    return result;
+}
+
+int shmcache_zrank(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *member, const bool reverse,
+        int *rank, int64_t *score)
+{
+    int result;
+    SHMCACHE_ZSET_CALL(context, shm_zset_rank(context, key,
+                member, reverse, rank, score));
+    return result;
+}
+
+int shmcache_zrange(struct shmcache_context *context,
+        const struct shmcache_key_info *key, const int start,
+        const bool reverse, struct shmcache_zset_item *items,
+        const int size, int *count)
+{
+    int result;
+    SHMCACHE_ZSET_CALL(context, shm_zset_range(context, key,
+                start, reverse, items, size, count));
+    return result;
+}
+
+int shmcache_incr(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const int64_t increment,
+        const int ttl, int64_t *new_value)
+{
+    int result;
+    struct shmcache_value_info value;
+    char *endptr;
+    char buff[24];
+
+    if ((result=shm_lock(context)) != 0) {
+        return result;
+    }
+
+    do {
+        result = shm_ht_get(context, key, &value);
+        if (result == 0) {
+            if (value.length >= sizeof(buff)) {
+                logError("file: "__FILE__", line: %d, "
+                        "key: %.*s, value length: %d exceeds %d",
+                        __LINE__, key->length, key->data,
+                        value.length, (int)sizeof(buff));
+                result = EINVAL;
+                break;
+            }
+            memcpy(buff, value.data, value.length);
             buff[value.length] = '\0';
             endptr = NULL;
             *new_value = strtoll(buff, &endptr, 10);
@@ -858,6 +1888,71 @@ int shmcache_incr(struct shmcache_context *context,
     return result;
 }
 
+int shmcache_cas(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_value_info *value,
+        const int64_t expected_version, int64_t *new_version)
+{
+    int result;
+    struct shmcache_value_info old_value;
+
+    if ((result=shm_lock(context)) != 0) {
+        return result;
+    }
+
+    do {
+        result = shm_ht_get(context, key, &old_value);
+        if (expected_version == 0) {  //add only
+            if (result == 0) {
+                result = EEXIST;
+                break;
+            }
+        } else if (result != 0) {  //not exist or expired
+            result = ENOENT;
+            break;
+        } else if (old_value.version != expected_version) {
+            result = EAGAIN;
+            break;
+        }
+
+        if ((result=shm_ht_set(context, key, value)) == 0) {
+            *new_version = context->memory->hashtable.version;
+        }
+    } while (0);
+
+    context->memory->stats.hashtable.cas.total++;
+    if (result == 0) {
+        context->memory->stats.hashtable.cas.success++;
+    }
+    shm_unlock(context);
+    return result;
+}
+
+int shmcache_set_max_memory(struct shmcache_context *context,
+        const int64_t max_memory)
+{
+    struct shm_value_size_info segment;
+    struct shm_value_size_info striping;
+
+    segment = context->memory->vm_info.segment;
+    striping = context->memory->vm_info.striping;
+    if (max_memory > context->segments.hashtable.size + segment.size *
+            segment.count.limit)
+    {
+        logError("file: "__FILE__", line: %d, "
+                "max_memory: %"PRId64" exceeds the reserved limit: "
+                "%"PRId64, __LINE__, max_memory,
+                context->segments.hashtable.size +
+                segment.size * segment.count.limit);
+        return EOVERFLOW;
+    }
+
+    shmcache_calc_value_max_count(max_memory - context->segments.
+            hashtable.size, &segment, &striping);
+    context->config.max_memory = max_memory;
+    return shmcache_grow_value_memory(context, &segment, &striping);
+}
+
 int shmcache_remove_all(struct shmcache_context *context)
 {
     int result;
@@ -881,10 +1976,38 @@ void shmcache_stats_ex(struct shmcache_context *context, struct shmcache_stats *
     stats->memory.max = context->segments.hashtable.size +
         context->memory->vm_info.segment.size *
         context->memory->vm_info.segment.count.max;
+    stats->memory.limit = context->segments.hashtable.size +
+        context->memory->vm_info.segment.size *
+        context->memory->vm_info.segment.count.limit;
     stats->memory.used = context->memory->usage.used.common +
         context->memory->usage.used.entry;
     stats->memory.usage = context->memory->usage;
-    stats->hashtable.count = context->memory->hashtable.count;
+    stats->hashtable.count = shm_ht_count(context);
+    stats->hashtable.stale = context->memory->hashtable.stale;
+    stats->namespaces = context->memory->namespaces;
+    stats->tags.invalidate_count = context->memory->tags.invalidate_count;
+    stats->leases.grant = context->memory->leases.stats.grant;
+    stats->leases.wait = context->memory->leases.stats.wait;
+    stats->leases.stale = context->memory->leases.stats.stale;
+    stats->leases.fill = context->memory->leases.stats.fill;
+    stats->leases.expire = context->memory->leases.stats.expire;
+    stats->bloom.memory = (int64_t)SHM_BLOOM_BLOCK_SIZE *
+        context->memory->bloom.block_count;
+    stats->bloom.hash_count = context->memory->bloom.hash_count;
+    stats->bloom.reject = context->memory->bloom.stats.reject;
+    stats->bloom.false_positive = context->memory->bloom.stats.false_positive;
+    stats->bloom.saturated = context->memory->bloom.stats.saturated;
+    stats->dedup.threshold = context->memory->dedup.capacity > 0 ?
+        context->config.dedup.threshold : 0;
+    stats->dedup.count = context->memory->dedup.count;
+    stats->dedup.refs = context->memory->dedup.refs;
+    stats->dedup.bytes = context->memory->dedup.bytes;
+    stats->dedup.saved = context->memory->dedup.saved;
+    stats->dedup.hit = context->memory->dedup.stats.hit;
+    stats->chain.part_size = context->memory->chain.part_size;
+    stats->chain.count = context->memory->chain.count;
+    stats->chain.parts = context->memory->chain.parts;
+    stats->chain.bytes = context->memory->chain.bytes;
     stats->hashtable.segment_size = context->segments.hashtable.size;
     stats->max_key_count = MAX_KEYS_IN_SHM(context);
 
@@ -922,9 +2045,15 @@ void shmcache_stats_ex(struct shmcache_context *context, struct shmcache_stats *
 
 void shmcache_clear_stats(struct shmcache_context *context)
 {
+    int i;
+
     shm_lock(context);
 
     memset(&context->memory->stats, 0, sizeof(context->memory->stats));
+    for (i=0; i<context->memory->namespaces.count; i++) {
+        memset(&SHM_NS_PTR(context, i)->stats, 0,
+                sizeof(SHM_NS_PTR(context, i)->stats));
+    }
     context->memory->stats.init_time =
         context->memory->stats.last.calc_time = get_current_time();
 
@@ -933,7 +2062,9 @@ void shmcache_clear_stats(struct shmcache_context *context)
 
 const char *shmcache_get_serializer_label(const int serializer)
 {
-    switch (serializer) {
+    switch (serializer & ~(SHMCACHE_OPTIONS_COMPRESSED |
+                SHMCACHE_OPTIONS_DEDUP | SHMCACHE_OPTIONS_CHAINED))
+    {
         case SHMCACHE_SERIALIZER_STRING:
             return "string";
         case SHMCACHE_SERIALIZER_INTEGER:
@@ -946,6 +2077,10 @@ const char *shmcache_get_serializer_label(const int serializer)
             return "igbinary";
         case SHMCACHE_SERIALIZER_PHP:
             return "php";
+        case SHMCACHE_SERIALIZER_HASH:
+            return "hash";
+        case SHMCACHE_SERIALIZER_ZSET:
+            return "zset";
         default:
             return "unkown";
     }
@@ -959,11 +2094,114 @@ int shmcache_clear(struct shmcache_context *context)
         return result;
     }
 
-    if (shm_ht_clear(context) > 0) {
-        if (context->config.va_policy.sleep_us_when_recycle_valid_entries > 0) {
-            usleep(context->config.va_policy.sleep_us_when_recycle_valid_entries);
-        }
+    //O(1) clear, the stale entries are invisible to the readers at once
+    //and reaped lazily, so do NOT need to sleep
+    shm_ht_flush(context);
+    shm_unlock(context);
+    return 0;
+}
+
+int shmcache_use_namespace(struct shmcache_context *context,
+        const char *name)
+{
+    int ns_index;
+
+    if ((ns_index=shm_ns_find(context, name)) < 0) {
+        logError("file: "__FILE__", line: %d, "
+                "namespace: %s not exist", __LINE__, name);
+        return ENOENT;
+    }
+    context->ns_index = ns_index;
+    return 0;
+}
+
+int shmcache_clear_namespace(struct shmcache_context *context)
+{
+    int result;
+
+    if ((result=shm_lock(context)) != 0) {
+        return result;
     }
+    shm_ht_flush_ns(context, context->ns_index);
     shm_unlock(context);
     return 0;
 }
+
+int shmcache_dump(struct shmcache_context *context,
+        const char *filename, struct shmcache_snapshot_stats *stats)
+{
+    int result;
+    int64_t start_time;
+
+    start_time = get_current_time_us();
+    result = shm_snapshot_dump(context, filename, stats);
+
+    if (result == 0) {
+        logInfo("file: "__FILE__", line: %d, pid: %d, "
+                "dump to file: %s, total entries: %"PRId64", "
+                "dumped entries: %"PRId64", expired entries: %"PRId64", "
+                "time used: %"PRId64" ms", __LINE__, context->pid,
+                filename, stats->total, stats->success, stats->expired,
+                (get_current_time_us() - start_time) / 1000);
+    }
+    return result;
+}
+
+int shmcache_load(struct shmcache_context *context,
+        const char *filename, const int thread_count,
+        struct shmcache_snapshot_stats *stats)
+{
+    int result;
+    int64_t start_time;
+
+    start_time = get_current_time_us();
+    result = shm_snapshot_load(context, filename, thread_count, stats);
+    logInfo("file: "__FILE__", line: %d, pid: %d, "
+            "load from file: %s, result: %d, total entries: %"PRId64", "
+            "loaded entries: %"PRId64", expired entries: %"PRId64", "
+            "fail entries: %"PRId64", time used: %"PRId64" ms",
+            __LINE__, context->pid, filename, result, stats->total,
+            stats->success, stats->expired, stats->fail,
+            (get_current_time_us() - start_time) / 1000);
+    return result;
+}
+
+int shmcache_checkpoint(struct shmcache_context *context,
+        int *striping_count)
+{
+    int result;
+    int64_t start_time;
+
+    if ((result=shm_lock(context)) != 0) {
+        return result;
+    }
+    start_time = get_current_time_us();
+    result = shm_checkpoint(context, striping_count);
+    shm_unlock(context);
+
+    if (result == 0) {
+        logInfo("file: "__FILE__", line: %d, pid: %d, "
+                "checkpoint done, synced stripings: %d, "
+                "time used: %"PRId64" ms", __LINE__, context->pid,
+                *striping_count, (get_current_time_us() - start_time) / 1000);
+    }
+    return result;
+}
+
+int shmcache_get_numa_placement(struct shmcache_context *context,
+        const int segment_index, struct shmcache_numa_placement *placement)
+{
+    char *base;
+    int64_t size;
+
+    if (segment_index < 0) {
+        base = context->segments.hashtable.base;
+        size = context->segments.hashtable.size;
+    } else {
+        if ((base=shmopt_get_value_segment(context, segment_index)) == NULL) {
+            return ENOENT;
+        }
+        size = context->memory->vm_info.segment.size;
+    }
+    return shm_numa_get_placement(base, size, placement);
+}
@@ -24,6 +24,8 @@ parameters:
     config: the config parameters
     create_segment: if create segment when segment not exist
     check_segment: if check segment
+the segment_size is raised when max_memory_limit exceeds 255 segments,
+EOVERFLOW when exceeds 255 segments of 128MB (about 32GB)
 return error no, 0 for success, != 0 for fail
 */
 int shmcache_init(struct shmcache_context *context,
@@ -74,7 +76,27 @@ parameters:
 void shmcache_destroy(struct shmcache_context *context);
 
 /**
-set value
+compute the hash code of the key once, the key can be used repeatedly by
+set, get and delete without rehash. the key must be rehashed after the
+data changed. the hashed field should be 0 when not calling this function
+parameters:
+	context: the context pointer
+    key: the key to hash
+return none
+*/
+static inline void shmcache_key_hash(struct shmcache_context *context,
+        struct shmcache_key_info *key)
+{
+    key->hash_code = (unsigned int)context->config.hash_func(
+            key->data, key->length);
+    key->hashed = SHMCACHE_KEY_HASHED;
+}
+
+/**
+set value, the value >= compress.threshold bytes of the config is
+compressed transparently when it saves more than 1/8, the value
+>= dedup.threshold bytes is shared with the other keys of the same value,
+and the value > chain.part_size bytes is split to the chained parts
 parameters:
 	context: the context pointer
     key: the key
@@ -85,6 +107,35 @@ int shmcache_set_ex(struct shmcache_context *context,
         const struct shmcache_key_info *key,
         const struct shmcache_value_info *value);
 
+/**
+set value with tags, all entries with a tag can be invalidated at once
+by shmcache_invalidate_tag
+parameters:
+	context: the context pointer
+    key: the key
+    value: the value, include expire filed
+    tags: the tags
+    tag_count: the tag count, max SHMCACHE_MAX_TAGS
+return error no, 0 for success, != 0 for fail
+*/
+int shmcache_set_with_tags(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_value_info *value,
+        const struct shmcache_key_info *tags, const int tag_count);
+
+/**
+invalidate all entries with the tag of the namespace in use in O(1)
+by increasing the tag version, the entries are invisible at once and
+recycled lazily. the tags are hashed to a fixed count of version slots,
+so the entries of a colliding tag may be invalidated too
+parameters:
+	context: the context pointer
+    tag: the tag
+return error no, 0 for success, != 0 for fail
+*/
+int shmcache_invalidate_tag(struct shmcache_context *context,
+        const struct shmcache_key_info *tag);
+
 /**
 set value
 parameters:
@@ -99,6 +150,286 @@ int shmcache_set(struct shmcache_context *context,
         const struct shmcache_key_info *key,
         const char *data, const int data_len, const int ttl);
 
+/**
+set value with the soft ttl for stale-while-revalidate: after the soft ttl,
+get returns the value as stale and elects one caller to refresh it,
+after the hard ttl the value is expired and can be recycled
+parameters:
+	context: the context pointer
+    key: the key
+    data: the value string ptr
+    data_len: the value length
+    soft_ttl: the soft time to live in seconds, should < hard_ttl
+    hard_ttl: the hard time to live in seconds
+return error no, 0 for success, != 0 for fail
+*/
+int shmcache_set_with_soft_ttl(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const char *data, const int data_len,
+        const int soft_ttl, const int hard_ttl);
+
+/**
+get value or the fill lease of the key for single-flight fill:
+the first process that misses gets the lease token and should fill the
+key by shmcache_fill_lease (or shmcache_release_lease when fail),
+the others get the stale value or wait for the filler
+parameters:
+	context: the context pointer
+    key: the key
+    value: store the returned value
+    lease_ms: the lease time in milliseconds, the lease is free when
+              expired or the owner process died
+    wait_ms: the max time to wait for the filler when no stale value
+    token: return the fill token, 0 for no lease
+return error no:
+    0 for success,
+    ENODATA for the tombstone, no lease,
+    ENOENT or ETIMEDOUT (the value is the stale one) for not found,
+        the caller should fill the key when token != 0,
+        or set by shmcache_set when token is 0 (the lease slot
+        is used by another key),
+    EINPROGRESS for the key is filling by another process and
+        the value is the stale one,
+    EBUSY for wait timeout
+*/
+int shmcache_get_or_lease(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        struct shmcache_value_info *value, const int lease_ms,
+        const int wait_ms, int64_t *token);
+
+/**
+set the value with the fill lease and wake up the waiters
+parameters:
+	context: the context pointer
+    key: the key
+    value: the value, include expire filed
+    token: the fill token returned by shmcache_get_or_lease
+return error no, 0 for success, EAGAIN for the lease is lost
+*/
+int shmcache_fill_lease(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_value_info *value, const int64_t token);
+
+/**
+release the fill lease without set, such as the backend fails
+parameters:
+	context: the context pointer
+    key: the key
+    token: the fill token returned by shmcache_get_or_lease
+return error no, 0 for success, EAGAIN for the lease is lost
+*/
+int shmcache_release_lease(struct shmcache_context *context,
+        const struct shmcache_key_info *key, const int64_t token);
+
+/**
+compare and swap, set the value only when the version of the entry
+equals to the expected version, the version is returned by shmcache_get
+parameters:
+	context: the context pointer
+    key: the key
+    value: the new value, include expire filed
+    expected_version: the expected version, 0 for set only when
+                      the key not exist
+    new_version: return the version of the new value
+return error no, 0 for success, != 0 for fail:
+    ENOENT for the key not exist or expired,
+    EAGAIN for the version not match,
+    EEXIST for the key exists when expected_version is 0
+*/
+int shmcache_cas(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_value_info *value,
+        const int64_t expected_version, int64_t *new_version);
+
+/**
+touch the key to extend its ttl (sliding expiration), the expires is
+updated in place without rewriting the value
+parameters:
+	context: the context pointer
+    key: the key
+    ttl: the new time to live in seconds from now,
+         SHMCACHE_NEVER_EXPIRED for never expired
+return error no, 0 for success, ENOENT for not exist or expired
+*/
+int shmcache_touch(struct shmcache_context *context,
+        const struct shmcache_key_info *key, const int ttl);
+
+/**
+set the tombstone (negative entry) of the key which not exists in the
+backend, the tombstone has no value bytes and costs only the entry header
+and the key. shmcache_get returns ENODATA for the tombstone until expired,
+the set of the key replaces the tombstone
+parameters:
+	context: the context pointer
+    key: the key
+    ttl: the time to live in seconds, should be > 0
+return error no, 0 for success, != 0 for fail
+*/
+int shmcache_set_tombstone(struct shmcache_context *context,
+        const struct shmcache_key_info *key, const int ttl);
+
+/**
+append the data to the value of the key, the value grows in place when
+its entry has slack, otherwise it is relocated with slack for the
+following appends. the compressed value is always relocated, it is
+uncompressed to compose and compressed again. the expires, soft ttl and
+tags are not changed
+parameters:
+	context: the context pointer
+    key: the key
+    data: the data to append
+    data_len: the data length
+return error no, 0 for success, ENOENT for not exist or expired
+*/
+int shmcache_append(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const char *data, const int data_len);
+
+/**
+prepend the data to the value of the key, the value is always relocated
+to keep the lock-free readers consistent
+parameters:
+	context: the context pointer
+    key: the key
+    data: the data to prepend
+    data_len: the data length
+return error no, 0 for success, ENOENT for not exist or expired
+*/
+int shmcache_prepend(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const char *data, const int data_len);
+
+/**
+overwrite the value of the key from the offset, the gap after the value
+is filled with zero. written in place only when after the current value
+parameters:
+	context: the context pointer
+    key: the key
+    offset: the offset of the value to write
+    data: the data to write
+    data_len: the data length
+return error no, 0 for success, ENOENT for not exist or expired
+*/
+int shmcache_setrange(struct shmcache_context *context,
+        const struct shmcache_key_info *key, const int offset,
+        const char *data, const int data_len);
+
+/**
+get the field of the hash value (the field table created by shmcache_hset),
+the field can be read without deserializing the whole value
+parameters:
+	context: the context pointer
+    key: the key
+    field: the field name
+    value: store the returned field value
+return error no, 0 for success, ENOENT for the key or the field not exist,
+    EINVAL for the value of the key is not a hash
+*/
+int shmcache_hget(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *field,
+        struct shmcache_value_info *value);
+
+/**
+set the field of the hash value, the hash is created when the key not exist.
+the field is never overwritten for the lock-free readers, the new field is
+appended in place when the hash has slack, otherwise the hash is copied on
+write with slack. the expires of the existing hash is not changed
+parameters:
+	context: the context pointer
+    key: the key
+    field: the field name
+    data: the field value
+    data_len: the field value length
+    ttl: the time to live in seconds when the hash is created
+return error no, 0 for success, EINVAL for the value is not a hash
+*/
+int shmcache_hset(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *field,
+        const char *data, const int data_len, const int ttl);
+
+/**
+increase the integer field of the hash value, set as shmcache_hset
+parameters:
+	context: the context pointer
+    key: the key
+    field: the field name
+    increment: the incremental number
+    ttl: the time to live in seconds when the hash is created
+    new_value: return the new value
+return error no, 0 for success, EINVAL for the value is not a hash
+    or the field is not an integer
+*/
+int shmcache_hincr(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *field,
+        const int64_t increment, const int ttl, int64_t *new_value);
+
+/**
+add the member to the sorted set (the skiplist in the value) or update its
+score, the sorted set is created when the key not exist. the members are
+ordered by the score then the member, the size of the sorted set is
+limited by max_value_size
+parameters:
+	context: the context pointer
+    key: the key
+    member: the member, max SHMCACHE_MAX_ZSET_MEMBER_SIZE bytes
+    score: the score
+    ttl: the time to live in seconds when the sorted set is created
+return error no, 0 for success, EINVAL for the value is not a sorted set,
+    ENOSPC for the sorted set exceeds max_value_size
+*/
+int shmcache_zadd(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *member,
+        const int64_t score, const int ttl);
+
+/**
+remove the member from the sorted set
+parameters:
+	context: the context pointer
+    key: the key
+    member: the member
+return error no, 0 for success, ENOENT for not exist
+*/
+int shmcache_zrem(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *member);
+
+/**
+get the rank and the score of the member
+parameters:
+	context: the context pointer
+    key: the key
+    member: the member
+    reverse: if rank by the score descending, such as the leaderboard
+    rank: return the rank based 0
+    score: return the score
+return error no, 0 for success, ENOENT for not exist
+*/
+int shmcache_zrank(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        const struct shmcache_key_info *member, const bool reverse,
+        int *rank, int64_t *score);
+
+/**
+get the members of the sorted set by rank, such as the top N
+parameters:
+	context: the context pointer
+    key: the key
+    start: the start rank based 0
+    reverse: if rank by the score descending
+    items: store the members
+    size: the max count of the items
+    count: return the item count
+return error no, 0 for success, ENOENT for the key not exist
+*/
+int shmcache_zrange(struct shmcache_context *context,
+        const struct shmcache_key_info *key, const int start,
+        const bool reverse, struct shmcache_zset_item *items,
+        const int size, int *count);
+
 /**
 increase integer value
 parameters:
@@ -116,17 +447,72 @@ int shmcache_incr(struct shmcache_context *context,
 
 /**
 get value
+parameters:
+	context: the context pointer
+    key: the key
+    value: store the returned value, value->stale is SHMCACHE_VALUE_STALE
+        or SHMCACHE_VALUE_STALE_REFRESH after the soft ttl
+    elect_refresher: if elect the caller to refresh the soft expired value,
+        only one caller gets SHMCACHE_VALUE_STALE_REFRESH
+return error no, 0 for success, ENODATA for the tombstone (the key not
+    exists in the backend), EBADMSG for the corrupted compressed value,
+    != 0 for fail
+the compressed value is uncompressed and the chained value is assembled
+to the buffer of the calling thread, which is valid until the next get of
+the same thread
+*/
+int shmcache_get_ex(struct shmcache_context *context,
+        const struct shmcache_key_info *key,
+        struct shmcache_value_info *value, const bool elect_refresher);
+
+/**
+get value, elect the refresher for the soft expired value
 parameters:
 	context: the context pointer
     key: the key
     value: store the returned value
-return error no, 0 for success, != 0 for fail
+return error no, 0 for success, ENODATA for the tombstone,
+    != 0 for fail
 shmcache_value_info 结构体 需要在调用前 分配好。
 */
 int shmcache_get(struct shmcache_context *context,
         const struct shmcache_key_info *key,
         struct shmcache_value_info *value);
 
+/**
+set value of the int64 key, the key is hashed by an integer mixer and
+stored as 8 bytes without formatting to string. the integer keys and the
+string keys are in different key spaces
+parameters:
+	context: the context pointer
+    key: the int64 key
+    value: the value, include expire filed
+return error no, 0 for success, != 0 for fail
+*/
+int shmcache_set_int_key(struct shmcache_context *context,
+        const int64_t key, const struct shmcache_value_info *value);
+
+/**
+get value of the int64 key
+parameters:
+	context: the context pointer
+    key: the int64 key
+    value: store the returned value
+return error no, 0 for success, != 0 for fail
+*/
+int shmcache_get_int_key(struct shmcache_context *context,
+        const int64_t key, struct shmcache_value_info *value);
+
+/**
+delete the int64 key
+parameters:
+	context: the context pointer
+    key: the int64 key
+return error no, 0 for success, != 0 for fail
+*/
+int shmcache_delete_int_key(struct shmcache_context *context,
+        const int64_t key);
+
 /**
 delte the key
 parameters:
@@ -138,6 +524,16 @@ int shmcache_delete(struct shmcache_context *context,
         const struct shmcache_key_info *key);
 
 
+/**
+raise max memory online, the new value segments will be created on demand
+parameters:
+	context: the context pointer
+    max_memory: the new max memory, can NOT exceed max_memory_limit
+return error no, 0 for success, != 0 for fail
+*/
+int shmcache_set_max_memory(struct shmcache_context *context,
+        const int64_t max_memory);
+
 /**
 remove all share memory
 parameters:
@@ -179,13 +575,83 @@ return serializer label
 const char *shmcache_get_serializer_label(const int serializer);
 
 /**
-clear hashtable
+clear hashtable in O(1) by increasing the generation,
+the cleared entries are reaped lazily
 parameters:
 	context: the context pointer
 return error no, 0 for success, != 0 for fail
 */
 int shmcache_clear(struct shmcache_context *context);
 
+/**
+use the namespace for the following set, get, delete and incr,
+the namespaces are created by the config items "namespace"
+parameters:
+	context: the context pointer
+    name: the namespace name, "default" for the default namespace
+return error no, 0 for success, ENOENT for the namespace not exist
+*/
+int shmcache_use_namespace(struct shmcache_context *context,
+        const char *name);
+
+/**
+clear the entries of the namespace in use in O(1),
+the other namespaces are not touched
+parameters:
+	context: the context pointer
+return error no, 0 for success, != 0 for fail
+*/
+int shmcache_clear_namespace(struct shmcache_context *context);
+
+/**
+dump all valid entries to a snapshot file in insertion order,
+the write operations are blocked during dump
+parameters:
+	context: the context pointer
+    filename: the snapshot filename
+    stats: return the dump stats
+return error no, 0 for success, != 0 for fail
+*/
+int shmcache_dump(struct shmcache_context *context,
+        const char *filename, struct shmcache_snapshot_stats *stats);
+
+/**
+load entries from a snapshot file, the expired entries are skipped
+parameters:
+	context: the context pointer
+    filename: the snapshot filename
+    thread_count: the thread count to load in parallel
+    stats: return the load stats
+return error no, 0 for success, != 0 for fail
+*/
+int shmcache_load(struct shmcache_context *context,
+        const char *filename, const int thread_count,
+        struct shmcache_snapshot_stats *stats);
+
+/**
+checkpoint: sync the modified stripings and the hashtable segment to the
+files, only for mmap type with checkpoint.enabled = true.
+the files can be reused after host reboot when no modification
+since the last checkpoint, otherwise the cache is cleared
+parameters:
+	context: the context pointer
+    striping_count: return the synced striping count
+return error no, 0 for success, != 0 for fail
+*/
+int shmcache_checkpoint(struct shmcache_context *context,
+        int *striping_count);
+
+/**
+get the NUMA node placement of the segment by sampling the pages
+parameters:
+	context: the context pointer
+    segment_index: the value segment index, -1 for the hashtable segment
+    placement: return the placement
+return error no, 0 for success, != 0 for fail
+*/
+int shmcache_get_numa_placement(struct shmcache_context *context,
+        const int segment_index, struct shmcache_numa_placement *placement);
+
 #ifdef __cplusplus
 }
 #endif
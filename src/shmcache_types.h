@@ -18,6 +18,12 @@
 
 #define SHMCACHE_MAX_KEY_SIZE  64
 
+#define SHMCACHE_MAX_NAMESPACES        32
+#define SHMCACHE_MAX_NAMESPACE_SIZE    32
+#define SHMCACHE_DEFAULT_NAMESPACE     "default"
+
+#define SHMCACHE_MAX_TAGS   8     //max tags of one entry
+
 #define SHMCACHE_STATUS_INIT   0
 #define SHMCACHE_STATUS_NORMAL 0x12345678
 
@@ -26,12 +32,37 @@
 
 #define SHMCACHE_NEVER_EXPIRED  0
 
+//the stale status of the value returned by get
+#define SHMCACHE_VALUE_FRESH          0
+#define SHMCACHE_VALUE_STALE          1  //soft expired, refreshed by others
+#define SHMCACHE_VALUE_STALE_REFRESH  2  //soft expired, the caller should refresh
+
 #define SHMCACHE_SERIALIZER_STRING    0   //string type
 #define SHMCACHE_SERIALIZER_INTEGER   1   //integer type
 #define SHMCACHE_SERIALIZER_NONE      0x100
 #define SHMCACHE_SERIALIZER_IGBINARY  0x200
 #define SHMCACHE_SERIALIZER_MSGPACK   0x400
 #define SHMCACHE_SERIALIZER_PHP       0x800
+#define SHMCACHE_SERIALIZER_HASH      0x1000  //the field table, see shm_field.h
+#define SHMCACHE_SERIALIZER_ZSET      0x2000  //the sorted set, see shm_zset.h
+
+//the value is compressed by the library, stripped by get, see shm_compress.h
+#define SHMCACHE_OPTIONS_COMPRESSED   0x40000000
+
+//the entry points to the shared value, internal only, see shm_dedup.h
+#define SHMCACHE_OPTIONS_DEDUP        0x20000000
+
+//the value is stored in the chained parts, internal only, see shm_chain.h
+#define SHMCACHE_OPTIONS_CHAINED      0x10000000
+
+#define SHMCACHE_MAX_ZSET_MEMBER_SIZE  64
+
+#define SHMCACHE_NUMA_POLICY_NONE         0
+#define SHMCACHE_NUMA_POLICY_INTERLEAVE   1  //interleave pages on all nodes
+#define SHMCACHE_NUMA_POLICY_PREFERRED    2  //prefer the first node
+#define SHMCACHE_NUMA_POLICY_ROUND_ROBIN  3  //prefer one node per segment
+
+#define SHMCACHE_MAX_NUMA_NODES  64
 
 #define SHMCACHE_STRIPING_ALLOCATOR_POOL_DOING  0
 #define SHMCACHE_STRIPING_ALLOCATOR_POOL_DONE   1
@@ -40,6 +71,11 @@ struct shmcache_config {
     char filename[MAX_PATH_SIZE];
     int64_t min_memory;
     int64_t max_memory;
+
+    /* the upper limit which max_memory can be raised to online,
+     * the allocator metadata is reserved for this limit
+     */
+    int64_t max_memory_limit;
     int64_t segment_size;
     int max_key_count;
     int max_value_size;
@@ -76,6 +112,41 @@ struct shmcache_config {
         int detect_deadlock_interval_ms;
     } lock_policy;
 
+    struct {
+        bool enabled;  //only for mmap type
+    } checkpoint;
+
+    struct {
+        bool enabled;
+        int counters_per_key;  //the 4 bits counters per key
+    } bloom_filter;
+
+    struct {
+        int threshold;  //compress the value >= threshold bytes, 0 for never
+    } compress;
+
+    struct {
+        int threshold;  //share the same value >= threshold bytes, 0 for never
+    } dedup;
+
+    struct {
+        int part_size;  //split the value > part_size bytes, 0 for never
+    } chain;
+
+    struct {
+        int policy;
+        int node_count;
+        short nodes[SHMCACHE_MAX_NUMA_NODES];  //the nodes for the policy
+    } numa;   //NUMA placement of the segments when created
+
+    struct {
+        int count;
+        struct {
+            char name[SHMCACHE_MAX_NAMESPACE_SIZE];
+            int64_t quota;   //memory quota, 0 for unlimited
+        } items[SHMCACHE_MAX_NAMESPACES];
+    } namespaces;   //the namespaces to create or update
+
     HashFunc hash_func;
 };
 
@@ -90,34 +161,217 @@ struct shm_value {
 };
 
 struct shm_list {
-    int64_t prev;   //上一个结点的entry offset
-    int64_t next;   //下一个结点的entry offset
+    uint32_t prev;   //上一个结点的entry offset
+    uint32_t next;   //下一个结点的entry offset
 };
 
-union shm_hentry_offset {
-    int64_t offset;
-    struct {
-        int index :16;
-        int64_t offset :48;
-    } segment;
-};
+/* the entry offset is 32 bits: (segment index + 1) << 24 | (offset >> 3)
+ * the entry is 8 bytes aligned, so the max segment size is 128MB.
+ * 0 for NULL (the end of the bucket chain) or the list head
+ */
+#define SHM_HENTRY_OFFSET_BITS     24
+#define SHM_HENTRY_ALIGN_BITS      3
+#define SHM_HENTRY_OFFSET_MASK     ((1 << SHM_HENTRY_OFFSET_BITS) - 1)
+#define SHM_HENTRY_MAX_SEGMENT_SIZE  (1LL << (SHM_HENTRY_OFFSET_BITS + \
+            SHM_HENTRY_ALIGN_BITS))
+//the segment index + 1 is 8 bits, about 32GB of the max segments
+#define SHM_HENTRY_MAX_SEGMENT_COUNT  255
+
+#define SHM_HENTRY_FLAG_TAGGED    1   //the tag refs follow the value
+#define SHM_HENTRY_FLAG_SOFT_TTL  2   //the soft ttl follows the value
+#define SHM_HENTRY_FLAG_INT_KEY   4   //the key is an int64 of 8 bytes
+#define SHM_HENTRY_FLAG_TOMBSTONE 8   //the negative entry without value
 
 //存储顺序: sizeof(struct shm_hash_entry) + MEM_ALIGN(entry->key_len) + value.length
+//          [+ MEM_ALIGN(value.length) for the soft ttl entry: struct shm_soft_ttl]
+//          [+ for the tagged entry: struct shm_tag_refs]
+//the segment index, striping index and segment offset are derived
+//from the entry offset
 struct shm_hash_entry {
     struct shm_list list;  //for recycle, must be first
 
-    int key_len;
-    time_t expires;
+    uint32_t ht_next;  //for hashtable   //此桶链表的 下一个entry节点的 offset
+    uint32_t expires;  //relative to memory->init_time, 0 for never expired
+    int64_t version;   //the CAS token, unique for every write
     struct shm_value value;
 
+    int size;       //alloc size
+    uint32_t key_len :7;
+    uint32_t ns :5;           //the namespace index
+    uint32_t flags :4;        //SHM_HENTRY_FLAG_*
+    uint32_t generation :16;  //stale when != the namespace generation
+    char key[0];    //存放 key 内容，长度为key_len
+};
+
+//between the soft and the hard expires, the value is served as stale
+//and only one reader is elected to refresh by struct shm_refresh_info
+struct shm_soft_ttl {
+    uint32_t expires;  //relative to memory->init_time
+    uint32_t padding;  //keep the entry size aligned
+};
+
+//the record of the field table of the hash value, 8 bytes aligned:
+//struct shm_field + name + value (the capacity includes the padding).
+//the record is never overwritten, the updated field is appended
+struct shm_field {
+    uint16_t name_len;
+    uint16_t flags;   //SHM_FIELD_FLAG_*
+    int value_len;
+    int capacity;
+    char name[0];
+};
+
+/* the sorted set is a skiplist in the value blob, the offsets are
+ * relative to the blob, 0 for NULL:
+ * struct shm_zset_header + member buckets (int * bucket_count)
+ * + the head node + the nodes (8 bytes aligned)
+ * the removed nodes are garbage until the blob is rebuilt
+ */
+#define SHM_ZSET_MAX_LEVEL  16
+
+struct shm_zset_header {
+    int count;         //the member count
+    int level;         //the level count in use
+    int used;          //the end of the node area
+    int garbage;       //the bytes of the removed nodes
+    int bucket_count;  //the member hash buckets
+    int head;          //the head node offset
+    int tail;          //the last node offset, 0 for empty
+    int reserved;
+};
+
+struct shm_zset_link {
+    int next;   //the next node offset
+    int span;   //the node count to the next, for rank
+};
+
+struct shm_zset_node {
+    int64_t score;
+    int prev;        //the previous node offset of level 0
+    int hnext;       //the next node offset of the member bucket
+    uint8_t level;
+    uint8_t member_len;
+    uint16_t reserved;
+    int padding;
+    struct shm_zset_link links[0];  //the member follows the links
+};
+
+//the tag version counters, the tag is hashed to the slot
+#define SHM_TAG_SLOT_COUNT  16381
+
+struct shm_tag_ref {
+    uint32_t slot;     //the tag slot index
+    uint32_t version;  //the slot version when set
+};
+
+//the entry is invalid when any version != that of the slot
+struct shm_tag_refs {
+    uint32_t count;
+    uint32_t reserved;
+    struct shm_tag_ref items[0];
+};
+
+struct shm_tag_info {
+    int64_t invalidate_count;
+    volatile uint32_t versions[SHM_TAG_SLOT_COUNT];
+};
+
+//the leases of the missed keys for single-flight fill
+#define SHM_LEASE_SLOT_COUNT  1021
+
+struct shm_lease {
+    volatile uint32_t wake_seq;  //the futex word, increase when released
+    pid_t pid;          //the lease owner, 0 for free
+    uint32_t key_hash;
+    int ns;             //the namespace index of the key
+    int64_t token;      //the fill token, 0 for free
+    int64_t expires_ms; //the lease is free after this time
+};
+
+struct shm_lease_info {
+    int64_t token_seq;
     struct {
-        int size;       //alloc size
-        struct shm_segment_striping_pair index;   //此key/value的 segment index和striping index
-        int64_t offset; //value segment offset  此key/value对　在shm segment块的偏移量
-    } memory;
+        int64_t grant;   //the leases granted
+        int64_t wait;    //the waits for the filler
+        int64_t stale;   //the stale values returned during fill
+        int64_t fill;    //the values filled with the lease
+        int64_t expire;  //the leases expired or the owner died
+    } stats;
+    struct shm_lease slots[SHM_LEASE_SLOT_COUNT];
+};
+
+//the refresh claims of the soft expired keys, claimed by the readers
+//without lock, so NEVER claim in the entry which maybe freed by the writer
+#define SHM_REFRESH_SLOT_COUNT  1021
 
-    int64_t ht_next;  //for hashtable   //此桶链表的 下一个entry节点在 shm中的 segment index, 偏移量
-    char key[0];　　　 //存放 key 内容，长度为key_len
+struct shm_refresh_info {
+    //the key hash << 32 | the relative time of the claim, 0 for free
+    volatile uint64_t claims[SHM_REFRESH_SLOT_COUNT];
+};
+
+//the counting Bloom filter in front of the hashtable, one block per key
+//is a cache line of 4 bits counters, so a miss checks one cache line
+#define SHM_BLOOM_BLOCK_SIZE       64
+#define SHM_BLOOM_BLOCK_COUNTERS  (SHM_BLOOM_BLOCK_SIZE * 2)
+#define SHM_BLOOM_COUNTER_MAX      15  //sticky when saturated
+#define SHM_BLOOM_MAX_HASH_COUNT    8
+
+#define SHMCACHE_DEFAULT_BLOOM_COUNTERS_PER_KEY  10
+
+struct shm_bloom_info {
+    int block_count;   //0 for disabled
+    int hash_count;    //the counters of one key
+    int64_t base_offset;  //the offset of the blocks in the hashtable segment
+    struct {
+        int64_t reject;  //the gets returned ENOENT by the filter
+        int64_t false_positive;  //passed the filter but not found
+        int64_t saturated;  //the counters reach SHM_BLOOM_COUNTER_MAX
+    } stats;
+};
+
+//the entries with the same value share one blob, which is allocated by
+//the value allocator but not in the hashtable and the recycle list, so it
+//is freed only when the last entry is freed
+struct shm_dedup_blob {
+    uint32_t hash_code;  //the hash code of the value
+    int refcount;        //the entries point to this blob
+    char data[0];        //the value
+};
+
+//the value of the entry with SHMCACHE_OPTIONS_DEDUP
+struct shm_dedup_ref {
+    uint32_t blob_offset;  //the entry offset of the blob
+    int length;            //the value length
+};
+
+struct shm_dedup_info {
+    int capacity;     //the bucket count of the blobs, 0 for disabled
+    int count;        //the blob count
+    int64_t base_offset;  //the offset of the buckets in the hashtable segment
+    int64_t refs;     //the entries point to the blobs
+    int64_t bytes;    //the value bytes of the blobs
+    int64_t saved;    //the value bytes saved by sharing
+    struct {
+        int64_t hit;  //the values shared an existing blob
+    } stats;
+};
+
+//the value longer than the part size is split to the parts, which are
+//allocated by the value allocator and linked by ht_next, but not in the
+//hashtable and the recycle list, so they are freed with the entry
+struct shm_chain_ref {
+    uint32_t first_offset;  //the entry offset of the first part
+    int count;       //the part count
+    int length;      //the value length
+    int size;        //the alloc size of the parts
+    int64_t stamp;   //the version of the parts, checked by the readers
+};
+
+struct shm_chain_info {
+    int part_size;   //the max value length of one part, 0 for disabled
+    int64_t count;   //the chained values
+    int64_t parts;   //the part count
+    int64_t bytes;   //the value bytes of the parts
 };
 
 struct shm_ring_queue {
@@ -135,10 +389,11 @@ struct shm_object_pool_info {
 };
 
 struct shm_hashtable {
-    struct shm_list head; //for recycle
     int capacity;   //允许的key的最大个数
-    int count;      //当前存储的key的个数
-    int64_t buckets[0]; //entry offset     bucket index -> bucket entry offset
+    int count;      //当前存储的key的个数, include the stale entries
+    int stale;      //the stale entries of the old generations to reap
+    int64_t version;  //the version of the last write, increase when set
+    uint32_t buckets[0]; //entry offset     bucket index -> bucket entry offset
 };
 
 //存储 一个striping_allocator对象的参数信息
@@ -147,6 +402,7 @@ struct shm_striping_allocator {
     int fail_times;   //allocate fail times
     short in_which_pool;  //in doing or done
     struct shm_segment_striping_pair index;
+    int64_t epoch;   //the checkpoint epoch of the last modification
     struct {
         int total;
         int used;   //已使用的大小
@@ -169,6 +425,7 @@ struct shm_value_size_info {
     struct {
         int current;
         int max;
+        int limit;  //reserved max count, max can grow up to limit online
     } count;
 };
 
@@ -200,6 +457,35 @@ struct shm_stats {
         struct shm_counter get;
         struct shm_counter del;
         struct shm_counter incr;
+        struct shm_counter cas;
+        struct shm_counter touch;
+        struct {
+            int64_t total;
+            int64_t success;
+            int64_t in_place;  //grow in place without relocation
+        } range;   //append, prepend and setrange
+        struct {
+            struct shm_counter get;
+            struct shm_counter set;  //hset and hincr
+            int64_t in_place;        //the field updated in place
+        } field;
+        struct shm_counter zset;  //the sorted set operations
+        struct {
+            int64_t total;    //the soft expired values returned
+            int64_t refresh;  //the refreshers elected
+        } stale;
+        struct {
+            int64_t set;   //the tombstones set
+            int64_t hit;   //the gets returned ENODATA
+        } tombstone;
+        struct {
+            int64_t total;   //the values stored compressed
+            int64_t skip;    //stored raw for the compressed one not smaller
+            int64_t raw_bytes;     //the original length of the compressed
+            int64_t stored_bytes;  //the stored length of the compressed
+            int64_t uncompress;    //the values uncompressed by get
+            int64_t fail;    //the corrupted values returned EBADMSG
+        } compress;
         int64_t last_clear_time;
     } hashtable;
 
@@ -243,6 +529,39 @@ struct shm_memory_usage {
     } used;
 };
 
+struct shm_checkpoint_info {
+    int enabled;
+    int dirty;          //modified since the last checkpoint
+    int64_t epoch;      //increase after every checkpoint
+    int64_t last_time;  //last checkpoint unix timestamp
+    int64_t boot_time;  //boot time of the host which the memory attached
+};
+
+//the namespace has its own quota, recycle list and stats,
+//the value stripings are shared by all namespaces
+struct shm_namespace {
+    char name[SHMCACHE_MAX_NAMESPACE_SIZE];
+    int64_t quota;  //memory quota, 0 for unlimited
+    int64_t used;   //alloc size of the entries
+    struct shm_list head;  //FIFO list for recycle
+    int count;      //entry count, include the stale entries
+    int stale;      //the stale entries of the old generations to reap
+    volatile uint32_t generation;  //increase when clear
+
+    struct {
+        struct shm_counter set;
+        struct shm_counter get;
+        struct shm_counter del;
+        int64_t recycle;   //recycled entries for quota or memory
+        int64_t last_clear_time;
+    } stats;
+};
+
+struct shm_namespace_info {
+    int count;
+    struct shm_namespace items[SHMCACHE_MAX_NAMESPACES];
+};
+
 // 存储 共享内存 hash表的所有信息及地址
 struct shm_memory_info {
     int size;           //sizeof(struct shm_memory_info)
@@ -254,12 +573,31 @@ struct shm_memory_info {
     struct shm_value_allocator value_allocator;
     struct shm_stats stats;
     struct shm_memory_usage usage;
+    struct shm_checkpoint_info checkpoint;
+    struct shm_namespace_info namespaces;
+    struct shm_tag_info tags;
+    struct shm_lease_info leases;
+    struct shm_refresh_info refreshes;
+    struct shm_bloom_info bloom;
+    struct shm_dedup_info dedup;
+    struct shm_chain_info chain;
     struct shm_hashtable hashtable;   //must be last
 };
 
+//the magic of shmcache_key_info.hashed set by shmcache_key_hash
+#define SHMCACHE_KEY_HASHED  0x48415348
+
 struct shmcache_key_info {
     char *data;
     int length;
+    int hashed;   //SHMCACHE_KEY_HASHED for hash_code is valid, 0 for not
+    unsigned int hash_code;  //the precomputed hash code of the key
+};
+
+struct shmcache_zset_item {
+    int64_t score;
+    int member_len;
+    char member[SHMCACHE_MAX_ZSET_MEMBER_SIZE];
 };
 
 struct shmcache_value_info {
@@ -267,6 +605,8 @@ struct shmcache_value_info {
     int length;
     int options;    //options for application
     time_t expires; //expire time
+    int64_t version;  //the CAS token returned by get, ignored by set
+    int stale;        //SHMCACHE_VALUE_* returned by get, ignored by set
 };
 
 struct shmcache_segment_info {
@@ -288,13 +628,6 @@ struct shmcache_value_allocator_context {
     struct shm_striping_allocator *allocators; //base address 是一个数组，存储所有的striping_allocator对象的参数信息 　//它指向的内存地址是 shm空间中的地址,  即context->segments.hashtable.base中的空间
 };
 
-struct shmcache_list {
-    struct {
-        struct shm_list *ptr;
-        int64_t offset;  //链表最后一个结点的entry offset
-    } head;   //head.ptr->next: 链表的第一个结点
-};
-
 struct shmcache_context {
     pid_t pid;
     int lock_fd;    //for file lock　　用配置的文件 做　文件锁
@@ -312,7 +645,7 @@ struct shmcache_context {
     } segments;
 
     struct shmcache_value_allocator_context value_allocator;   //存储所有的striping_allocator对象的 相关信息（在分配hash entry时，会用到）
-    struct shmcache_list list;   //for value recycle  //将所有已经已存储的key/value entry的offset都 保存到这个链表上
+    int ns_index;   //the namespace in use, 0 for the default namespace
     bool create_segment;  //if check segment size
 };
 
@@ -322,11 +655,50 @@ struct shmcache_stats {
         int64_t segment_size;  //segment memory size
         int capacity;
         int count;  //key count
+        int stale;  //stale entry count to reap
     } hashtable;
     int max_key_count;
+    struct shm_namespace_info namespaces;
+
+    struct {
+        int64_t invalidate_count;
+    } tags;
+
+    struct {
+        int64_t grant;
+        int64_t wait;
+        int64_t stale;
+        int64_t fill;
+        int64_t expire;
+    } leases;
+
+    struct {
+        int64_t memory;   //the memory size of the filter, 0 for disabled
+        int hash_count;
+        int64_t reject;
+        int64_t false_positive;
+        int64_t saturated;
+    } bloom;
+
+    struct {
+        int threshold;    //0 for disabled
+        int count;        //the blob count
+        int64_t refs;     //the entries point to the blobs
+        int64_t bytes;    //the value bytes of the blobs
+        int64_t saved;    //the value bytes saved by sharing
+        int64_t hit;
+    } dedup;
+
+    struct {
+        int part_size;    //0 for disabled
+        int64_t count;    //the chained values
+        int64_t parts;    //the part count
+        int64_t bytes;    //the value bytes of the parts
+    } chain;
 
     struct {
         int64_t max;
+        int64_t limit;
         int64_t used;
         struct shm_memory_usage usage;
     } memory;
@@ -338,6 +710,19 @@ struct shmcache_stats {
     } hit;
 };
 
+struct shmcache_numa_placement {
+    int sampled;  //sampled page count
+    int absent;   //not present page count
+    int pages[SHMCACHE_MAX_NUMA_NODES];  //page count per node
+};
+
+struct shmcache_snapshot_stats {
+    int64_t total;    //total entries
+    int64_t success;  //dumped or loaded entries
+    int64_t expired;  //skipped expired entries
+    int64_t fail;     //fail entries
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
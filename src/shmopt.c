@@ -6,6 +6,7 @@
 #include "shm_op_wrapper.h"
 #include "shm_striping_allocator.h"
 #include "shm_object_pool.h"
+#include "shm_numa.h"
 #include "shmopt.h"
 
 int shmopt_init_segment(struct shmcache_context *context,
@@ -71,6 +72,10 @@ int shmopt_create_value_segment(struct shmcache_context *context)
     if ((result=shmopt_init_value_segment(context, segment_index)) != 0) {
         return result;
     }
+    //apply before the first touch, the placement is best effort
+    shm_numa_apply_policy(context, segment_index,
+            context->segments.values.items[segment_index].base,
+            context->memory->vm_info.segment.size);
     context->memory->vm_info.segment.count.current++;
     ////////////////////////////////////////////////////
 
@@ -55,7 +55,11 @@ return the value segment ptr, return NULL if fail
 //获取第index块 shm segment的首地址
 static inline char *shmopt_get_value_segment(struct shmcache_context *context, const int index)
 {
-    if (index < context->segments.values.count)
+    if (index < 0)   //the garbage offset read without lock
+    {
+        return NULL;
+    }
+    else if (index < context->segments.values.count)
     {
         return context->segments.values.items[index].base;
     }
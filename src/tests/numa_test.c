@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include "logger.h"
+#include "shmcache.h"
+#include "shm_numa.h"
+
+#define MAX_CALL_COUNT  64
+#define VALUE_SIZE      (64 * 1024)
+
+struct mbind_call {
+    void *addr;
+    unsigned long len;
+    int mode;
+    unsigned long nodemask;
+    unsigned long maxnode;
+};
+
+static struct mbind_call calls[MAX_CALL_COUNT];
+static int call_count = 0;
+
+//record the mbind calls instead of binding the memory
+static long fake_mbind(void *addr, unsigned long len, int mode,
+        const unsigned long *nodemask, unsigned long maxnode,
+        unsigned int flags)
+{
+    if (call_count < MAX_CALL_COUNT) {
+        calls[call_count].addr = addr;
+        calls[call_count].len = len;
+        calls[call_count].mode = mode;
+        calls[call_count].nodemask = nodemask[0];
+        calls[call_count].maxnode = maxnode;
+    }
+    call_count++;
+    return 0;
+}
+
+static void get_expected(const struct shmcache_config *config,
+        const int segment_index, int *mode, unsigned long *nodemask)
+{
+    int i;
+
+    *nodemask = 0;
+    if (config->numa.policy == SHMCACHE_NUMA_POLICY_INTERLEAVE ||
+            (config->numa.policy == SHMCACHE_NUMA_POLICY_ROUND_ROBIN &&
+             segment_index == SHM_NUMA_HASHTABLE_SEGMENT))
+    {
+        *mode = SHM_NUMA_MPOL_INTERLEAVE;
+        for (i=0; i<config->numa.node_count; i++) {
+            *nodemask |= 1UL << config->numa.nodes[i];
+        }
+    } else if (config->numa.policy == SHMCACHE_NUMA_POLICY_ROUND_ROBIN) {
+        *mode = SHM_NUMA_MPOL_PREFERRED;
+        *nodemask = 1UL << config->numa.nodes[segment_index %
+            config->numa.node_count];
+    } else {
+        *mode = SHM_NUMA_MPOL_PREFERRED;
+        *nodemask = 1UL << config->numa.nodes[0];
+    }
+}
+
+static int check_calls(struct shmcache_context *context)
+{
+    struct mbind_call *call;
+    int segment_index;
+    int64_t size;
+    int mode;
+    unsigned long nodemask;
+    int i;
+
+    if (call_count != 1 + context->segments.values.count) {
+        printf("policy: %s, mbind count: %d != segment count: %d\n",
+                shm_numa_get_policy_name(context->config.numa.policy),
+                call_count, 1 + context->segments.values.count);
+        return EINVAL;
+    }
+
+    for (i=0; i<call_count; i++) {
+        call = calls + i;
+        if (call->addr == context->segments.hashtable.base) {
+            segment_index = SHM_NUMA_HASHTABLE_SEGMENT;
+            size = context->segments.hashtable.size;
+        } else {
+            for (segment_index=0; segment_index<context->segments.
+                    values.count; segment_index++)
+            {
+                if (call->addr == context->segments.values.
+                        items[segment_index].base)
+                {
+                    break;
+                }
+            }
+            if (segment_index == context->segments.values.count) {
+                printf("mbind #%d, unknown address: %p\n", i, call->addr);
+                return EINVAL;
+            }
+            size = context->memory->vm_info.segment.size;
+        }
+
+        get_expected(&context->config, segment_index, &mode, &nodemask);
+        printf("policy: %s, segment: %d, mode: %d, nodemask: %lx, "
+                "length: %lu\n", shm_numa_get_policy_name(
+                    context->config.numa.policy), segment_index,
+                call->mode, call->nodemask, call->len);
+        if (call->mode != mode || call->nodemask != nodemask ||
+                call->len != size || call->maxnode !=
+                SHMCACHE_MAX_NUMA_NODES + 1)
+        {
+            printf("segment: %d, expect mode: %d, nodemask: %lx, "
+                    "length: %"PRId64"\n", segment_index, mode,
+                    nodemask, size);
+            return EINVAL;
+        }
+    }
+    return 0;
+}
+
+static int test_policy(struct shmcache_config *config, const int policy,
+        const short *nodes, const int node_count)
+{
+    int result;
+    int i;
+    struct shmcache_context context;
+    struct shmcache_key_info key;
+    char szKey[SHMCACHE_MAX_KEY_SIZE];
+    static char szValue[VALUE_SIZE];
+
+    config->numa.policy = policy;
+    config->numa.node_count = node_count;
+    memcpy(config->numa.nodes, nodes, sizeof(short) * node_count);
+    call_count = 0;
+    if ((result=shmcache_init(&context, config, true, true)) != 0) {
+        return result;
+    }
+
+    //fill the values to create more segments
+    memset(szValue, 'A', sizeof(szValue));
+    key.data = szKey;
+    key.hashed = 0;
+    for (i=0; i<(int)(config->max_memory / VALUE_SIZE); i++) {
+        key.length = sprintf(key.data, "key_%04d", i + 1);
+        if ((result=shmcache_set(&context, &key, szValue,
+                        sizeof(szValue), 120)) != 0)
+        {
+            printf("%d. set fail, errno: %d\n", i + 1, result);
+            break;
+        }
+    }
+
+    if (result == 0) {
+        if (policy == SHMCACHE_NUMA_POLICY_NONE) {
+            result = call_count == 0 ? 0 : EINVAL;
+        } else if (context.segments.values.count < 3) {
+            printf("segment count: %d < 3\n", context.segments.values.count);
+            result = EINVAL;
+        } else {
+            result = check_calls(&context);
+        }
+    }
+
+    shmcache_remove_all(&context);
+    shmcache_destroy(&context);
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+	int result;
+    struct shmcache_config config;
+    short nodes[2];
+
+	log_init();
+	g_log_context.log_level = LOG_WARNING;
+
+    if ((result=shmcache_load_config(&config,
+                    "../../conf/libshmcache.conf")) != 0)
+    {
+        return result;
+    }
+    config.type = SHMCACHE_TYPE_MMAP;
+    snprintf(config.filename, sizeof(config.filename),
+            "/tmp/shmcache_numa_test");
+    config.segment_size = 4 * 1024 * 1024;
+    config.min_memory = 0;
+    config.max_memory = config.max_memory_limit = 16 * 1024 * 1024;
+    config.max_key_count = 10000;
+    config.checkpoint.enabled = false;
+    g_shm_numa_mbind = fake_mbind;
+
+    nodes[0] = 0; nodes[1] = 2;
+    if ((result=test_policy(&config, SHMCACHE_NUMA_POLICY_INTERLEAVE,
+                    nodes, 2)) != 0)
+    {
+        return result;
+    }
+
+    nodes[0] = 1; nodes[1] = 2;
+    if ((result=test_policy(&config, SHMCACHE_NUMA_POLICY_PREFERRED,
+                    nodes, 2)) != 0)
+    {
+        return result;
+    }
+
+    //more segments than nodes
+    nodes[0] = 0; nodes[1] = 1;
+    if ((result=test_policy(&config, SHMCACHE_NUMA_POLICY_ROUND_ROBIN,
+                    nodes, 2)) != 0)
+    {
+        return result;
+    }
+
+    if ((result=test_policy(&config, SHMCACHE_NUMA_POLICY_NONE,
+                    nodes, 2)) != 0)
+    {
+        return result;
+    }
+
+    printf("numa test OK\n");
+	return 0;
+}
@@ -40,6 +40,7 @@ int main(int argc, char *argv[])
     srand(time(NULL));
     memset(szValue, 'A', sizeof(szValue));
     key.data = szKey;
+    key.hashed = 0;
     for (i=0; i<100000; i++) {
         key.length = sprintf(key.data, "key_%04d", i + 1);
         value_len = (MAX_VALUE_SIZE * (int64_t)rand()) / (int64_t)RAND_MAX;
@@ -0,0 +1,56 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "logger.h"
+#include "shared_func.h"
+#include "shmcache.h"
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "sync the modified shmcache data to the mmap files.\n"
+         "Usage: %s [config_filename]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	int result;
+    int striping_count;
+    char *config_filename;
+    struct shmcache_context context;
+
+    if (argc >= 2 && (strcmp(argv[1], "-h") == 0 ||
+                strcmp(argv[1], "help") == 0 ||
+                strcmp(argv[1], "--help") == 0))
+    {
+        usage(argv[0]);
+        return 0;
+    }
+    if (argc > 2) {
+        usage(argv[0]);
+        return EINVAL;
+    }
+
+    config_filename = "/etc/libshmcache.conf";
+    if (argc == 2) {
+        config_filename = argv[1];
+    }
+
+	log_init();
+    if ((result=shmcache_init_from_file_ex(&context,
+                    config_filename, false, true)) != 0)
+    {
+        return result;
+    }
+
+    result = shmcache_checkpoint(&context, &striping_count);
+    if (result == 0) {
+        printf("checkpoint success, synced stripings: %d\n",
+                striping_count);
+    } else {
+        fprintf(stderr, "checkpoint fail, errno: %d\n", result);
+    }
+
+	return result;
+}
@@ -53,6 +53,7 @@ int main(int argc, char *argv[])
 
     key.data = argv[index++];
     key.length = strlen(key.data);
+    key.hashed = 0;
     result = shmcache_delete(&context, &key);
     if (result == 0) {
         printf("delete key: %s successfully.\n", key.data);
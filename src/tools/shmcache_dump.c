@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "logger.h"
+#include "shared_func.h"
+#include "shmcache.h"
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "dump shmcache entries to a snapshot file.\n"
+         "Usage: %s [config_filename] <snapshot_filename>\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	int result;
+    char *config_filename;
+    char *snapshot_filename;
+    struct shmcache_context context;
+    struct shmcache_snapshot_stats stats;
+
+    if (argc >= 2 && (strcmp(argv[1], "-h") == 0 ||
+                strcmp(argv[1], "help") == 0 ||
+                strcmp(argv[1], "--help") == 0))
+    {
+        usage(argv[0]);
+        return 0;
+    }
+    if (argc < 2 || argc > 3) {
+        usage(argv[0]);
+        return EINVAL;
+    }
+
+    config_filename = "/etc/libshmcache.conf";
+    if (argc == 3) {
+        config_filename = argv[1];
+        snapshot_filename = argv[2];
+    } else {
+        snapshot_filename = argv[1];
+    }
+
+	log_init();
+    if ((result=shmcache_init_from_file_ex(&context,
+                    config_filename, false, true)) != 0)
+    {
+        return result;
+    }
+
+    result = shmcache_dump(&context, snapshot_filename, &stats);
+    if (result == 0) {
+        printf("dump to file: %s success, total entries: %"PRId64", "
+                "dumped entries: %"PRId64", expired entries: %"PRId64"\n",
+                snapshot_filename, stats.total, stats.success,
+                stats.expired);
+    } else {
+        fprintf(stderr, "dump to file: %s fail, errno: %d\n",
+                snapshot_filename, result);
+    }
+
+	return result;
+}
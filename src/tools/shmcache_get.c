@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <time.h>
 #include "logger.h"
 #include "shared_func.h"
@@ -20,6 +21,7 @@ int main(int argc, char *argv[])
     struct shmcache_context context;
     struct shmcache_key_info key;
     struct shmcache_value_info value;
+    char buff[32];
 
     if (argc >= 2 && (strcmp(argv[1], "-h") == 0 ||
                 strcmp(argv[1], "help") == 0 ||
@@ -54,10 +56,17 @@ int main(int argc, char *argv[])
 
     key.data = argv[index++];
     key.length = strlen(key.data);
-    result = shmcache_get(&context, &key, &value);
+    key.hashed = 0;
+    //the tool never refreshes, so do NOT take the refresh from others
+    result = shmcache_get_ex(&context, &key, &value, false);
     if (result == 0) {
-        printf("value options: %d, value length: %d, value:\n%.*s\n",
-                value.options, value.length, value.length, value.data);
+        printf("value options: %d, value length: %d, version: %"PRId64", "
+                "stale: %d, value:\n%.*s\n", value.options, value.length,
+                value.version, value.stale, value.length, value.data);
+    } else if (result == ENODATA) {
+        printf("key: %s is a tombstone, expires: %s\n", key.data,
+                formatDatetime(value.expires, "%Y-%m-%d %H:%M:%S",
+                    buff, sizeof(buff)));
     } else {
         fprintf(stderr, "get key: %s fail, errno: %d\n",  key.data, result);
     }
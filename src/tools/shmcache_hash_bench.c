@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "logger.h"
+#include "shared_func.h"
+#include "hash.h"
+#include "shmcache.h"
+
+#define BENCH_LINE_SIZE  1024
+
+struct hash_bench_func {
+    const char *name;
+    HashFunc func;
+};
+
+struct hash_bench_keys {
+    struct shmcache_key_info *keys;
+    int count;
+    int alloc;
+    int64_t bytes;
+};
+
+static struct hash_bench_func bench_funcs[] = {
+    {"simple_hash", simple_hash},
+    {"Time33Hash", Time33Hash},
+    {"BKDRHash", BKDRHash},
+    {"ELFHash", ELFHash},
+    {"APHash", APHash},
+    {"CRC32", (HashFunc)CRC32},
+    {"CRC32C", CRC32C},
+    {"wyhash", wyhash}
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "compare the hash functions for the hash_function "
+            "config item by the throughput and the chain length "
+            "distribution of the real keys.\n"
+         "Usage: %s <key_filename> [capacity] [loops]\n"
+         "\tkey_filename: one key per line, - for stdin\n"
+         "\tcapacity: the bucket count, default: the prime capacity "
+         "for max_key_count = the key count\n"
+         "\tloops: the hash loops for the throughput, default: 10\n\n",
+         prog);
+}
+
+static int load_keys(const char *filename, struct hash_bench_keys *keys)
+{
+    FILE *fp;
+    char line[BENCH_LINE_SIZE];
+    struct shmcache_key_info *key;
+    int len;
+
+    if (strcmp(filename, "-") == 0) {
+        fp = stdin;
+    } else if ((fp=fopen(filename, "r")) == NULL) {
+        fprintf(stderr, "open file %s fail, errno: %d, error info: %s\n",
+                filename, errno, STRERROR(errno));
+        return errno != 0 ? errno : ENOENT;
+    }
+
+    memset(keys, 0, sizeof(*keys));
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        len = strlen(line);
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            len--;
+        }
+        if (len == 0) {
+            continue;
+        }
+
+        if (keys->count == keys->alloc) {
+            keys->alloc = keys->alloc == 0 ? 4096 : keys->alloc * 2;
+            keys->keys = (struct shmcache_key_info *)realloc(keys->keys,
+                    sizeof(struct shmcache_key_info) * keys->alloc);
+            if (keys->keys == NULL) {
+                fprintf(stderr, "realloc %d keys fail\n", keys->alloc);
+                return ENOMEM;
+            }
+        }
+        key = keys->keys + keys->count++;
+        if ((key->data=(char *)malloc(len)) == NULL) {
+            fprintf(stderr, "malloc %d bytes fail\n", len);
+            return ENOMEM;
+        }
+        memcpy(key->data, line, len);
+        key->length = len;
+        key->hashed = 0;
+        keys->bytes += len;
+    }
+
+    if (fp != stdin) {
+        fclose(fp);
+    }
+    return 0;
+}
+
+static void bench_func(struct hash_bench_func *bf,
+        struct hash_bench_keys *keys, const unsigned int capacity,
+        const int loops, int *chains)
+{
+    struct shmcache_key_info *key;
+    struct shmcache_key_info *end;
+    int64_t start_time;
+    int64_t time_used;
+    int64_t probes;
+    volatile int sink;
+    int empty_count;
+    int max_chain;
+    unsigned int i;
+    int k;
+
+    end = keys->keys + keys->count;
+    sink = 0;
+    start_time = get_current_time_us();
+    for (k=0; k<loops; k++) {
+        for (key=keys->keys; key<end; key++) {
+            sink ^= bf->func(key->data, key->length);
+        }
+    }
+    time_used = get_current_time_us() - start_time;
+    if (time_used <= 0) {
+        time_used = 1;
+    }
+
+    memset(chains, 0, sizeof(int) * capacity);
+    for (key=keys->keys; key<end; key++) {
+        chains[(unsigned int)bf->func(key->data, key->length) % capacity]++;
+    }
+
+    //probes: the key compare count to find all keys once
+    empty_count = 0;
+    max_chain = 0;
+    probes = 0;
+    for (i=0; i<capacity; i++) {
+        if (chains[i] == 0) {
+            empty_count++;
+        } else if (chains[i] > max_chain) {
+            max_chain = chains[i];
+        }
+        probes += (int64_t)chains[i] * (chains[i] + 1) / 2;
+    }
+
+    printf("%-12s %8.2f %10.2f %8.2f%% %10.3f %10d %10.3f\n", bf->name,
+            (double)time_used * 1000 / ((int64_t)keys->count * loops),
+            (double)keys->bytes * loops / time_used,
+            100.00 * empty_count / capacity,
+            capacity > empty_count ? (double)keys->count /
+            (capacity - empty_count) : 0.00, max_chain,
+            (double)probes / keys->count);
+}
+
+int main(int argc, char *argv[])
+{
+	int result;
+    int loops;
+    int i;
+    unsigned int capacity;
+    unsigned int *prime;
+    int *chains;
+    struct hash_bench_keys keys;
+
+    if (argc < 2 || strcmp(argv[1], "-h") == 0 ||
+            strcmp(argv[1], "help") == 0 ||
+            strcmp(argv[1], "--help") == 0)
+    {
+        usage(argv[0]);
+        return argc < 2 ? EINVAL : 0;
+    }
+
+	log_init();
+    if ((result=load_keys(argv[1], &keys)) != 0) {
+        return result;
+    }
+    if (keys.count == 0) {
+        fprintf(stderr, "no key in file: %s\n", argv[1]);
+        return ENOENT;
+    }
+
+    if (argc >= 3) {
+        capacity = strtoul(argv[2], NULL, 10);
+    } else if ((prime=hash_get_prime_capacity(keys.count)) != NULL) {
+        capacity = *prime;
+    } else {
+        capacity = keys.count;
+    }
+    if (capacity == 0) {
+        fprintf(stderr, "invalid capacity: %s\n", argv[2]);
+        return EINVAL;
+    }
+    loops = argc >= 4 ? atoi(argv[3]) : 10;
+    if (loops <= 0) {
+        loops = 1;
+    }
+
+    if ((chains=(int *)malloc(sizeof(int) * capacity)) == NULL) {
+        fprintf(stderr, "malloc %d bytes fail\n",
+                (int)(sizeof(int) * capacity));
+        return ENOMEM;
+    }
+
+    printf("key count: %d, avg key length: %.2f, capacity: %u, "
+            "load factor: %.3f, loops: %d\n\n", keys.count,
+            (double)keys.bytes / keys.count, capacity,
+            (double)keys.count / capacity, loops);
+    printf("%-12s %8s %10s %9s %10s %10s %10s\n", "function", "ns/key",
+            "MB/s", "empty", "avg_chain", "max_chain", "avg_probes");
+    for (i=0; i<sizeof(bench_funcs) / sizeof(bench_funcs[0]); i++) {
+        bench_func(bench_funcs + i, &keys, capacity, loops, chains);
+    }
+
+    free(chains);
+	return 0;
+}
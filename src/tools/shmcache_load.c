@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "logger.h"
+#include "shared_func.h"
+#include "shmcache.h"
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "load shmcache entries from a snapshot file.\n"
+         "Usage: %s [config_filename] <snapshot_filename> [thread_count]\n"
+         "\tthread_count: the thread count to load in parallel, "
+         "default: 4\n\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	int result;
+    int index;
+    int thread_count;
+    char *config_filename;
+    char *snapshot_filename;
+    struct shmcache_context context;
+    struct shmcache_snapshot_stats stats;
+
+    if (argc >= 2 && (strcmp(argv[1], "-h") == 0 ||
+                strcmp(argv[1], "help") == 0 ||
+                strcmp(argv[1], "--help") == 0))
+    {
+        usage(argv[0]);
+        return 0;
+    }
+    if (argc < 2) {
+        usage(argv[0]);
+        return EINVAL;
+    }
+
+    config_filename = "/etc/libshmcache.conf";
+    if (argc >= 3 && isFile(argv[1]) && isFile(argv[2])) {
+        config_filename = argv[1];
+        index = 2;
+    } else {
+        index = 1;
+    }
+    snapshot_filename = argv[index++];
+    if (index < argc) {
+        thread_count = atoi(argv[index]);
+    } else {
+        thread_count = 4;
+    }
+
+	log_init();
+    if ((result=shmcache_init_from_file(&context, config_filename)) != 0) {
+        return result;
+    }
+
+    result = shmcache_load(&context, snapshot_filename,
+            thread_count, &stats);
+    if (result == 0) {
+        printf("load from file: %s success, total entries: %"PRId64", "
+                "loaded entries: %"PRId64", expired entries: %"PRId64", "
+                "fail entries: %"PRId64"\n", snapshot_filename,
+                stats.total, stats.success, stats.expired, stats.fail);
+    } else {
+        fprintf(stderr, "load from file: %s fail, errno: %d\n",
+                snapshot_filename, result);
+    }
+
+	return result;
+}
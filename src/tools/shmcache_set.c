@@ -54,6 +54,7 @@ int main(int argc, char *argv[])
 
     key.data = argv[index++];
     key.length = strlen(key.data);
+    key.hashed = 0;
     value = argv[index++];
     value_len = strlen(value);
     ttl = atoi(argv[index++]);
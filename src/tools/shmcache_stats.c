@@ -6,8 +6,11 @@
 #include "shared_func.h"
 #include "sched_thread.h"
 #include "shmcache.h"
+#include "shm_numa.h"
 
 static void stats_output(struct shmcache_context *context);
+static void numa_placement_output(struct shmcache_context *context);
+static void namespaces_output(struct shmcache_stats *stats);
 
 static void usage(const char *prog)
 {
@@ -145,18 +148,43 @@ static void stats_output(struct shmcache_context *context)
                     last_unlock_deadlock_time, "%Y-%m-%d %H:%M:%S",
                     time_buff, sizeof(time_buff)));
     }
+    if (context->memory->checkpoint.last_time > 0) {
+        printf("last checkpoint time: %s\n", formatDatetime(
+                    context->memory->checkpoint.last_time,
+                    "%Y-%m-%d %H:%M:%S", time_buff, sizeof(time_buff)));
+    }
     printf("\n");
 
     printf("\nhash table stats:\n");
     printf("max_key_count: %d\n"
             "current_key_count: %d\n"
+            "stale_key_count: %d\n"
+            "invalidate_tag_count: %"PRId64"\n"
             "segment_size: %.03f MB\n\n"
             "set.total_count: %"PRId64"\n"
             "set.success_count: %"PRId64"\n"
             "incr.total_count: %"PRId64"\n"
             "incr.success_count: %"PRId64"\n"
+            "cas.total_count: %"PRId64"\n"
+            "cas.success_count: %"PRId64"\n"
+            "touch.total_count: %"PRId64"\n"
+            "touch.success_count: %"PRId64"\n"
+            "range.total_count: %"PRId64"\n"
+            "range.success_count: %"PRId64"\n"
+            "range.in_place_count: %"PRId64"\n"
+            "hset.total_count: %"PRId64"\n"
+            "hset.success_count: %"PRId64"\n"
+            "hset.in_place_count: %"PRId64"\n"
+            "hget.total_count: %"PRId64"\n"
+            "hget.success_count: %"PRId64"\n"
+            "zset.total_count: %"PRId64"\n"
+            "zset.success_count: %"PRId64"\n"
             "get.total_count: %"PRId64"\n"
             "get.success_count: %"PRId64"\n"
+            "get.stale_count: %"PRId64"\n"
+            "get.refresh_count: %"PRId64"\n"
+            "get.tombstone_count: %"PRId64"\n"
+            "tombstone.set_count: %"PRId64"\n"
             "del.total_count: %"PRId64"\n"
             "del.success_count: %"PRId64"\n"
             "get.qps: %.2f\n"
@@ -165,27 +193,51 @@ static void stats_output(struct shmcache_context *context)
             "total RW ratio: %s\n\n",
             stats.max_key_count,
             stats.hashtable.count,
+            stats.hashtable.stale,
+            stats.tags.invalidate_count,
             (double)stats.hashtable.segment_size / (1024 * 1024),
             stats.shm.hashtable.set.total,
             stats.shm.hashtable.set.success,
             stats.shm.hashtable.incr.total,
             stats.shm.hashtable.incr.success,
+            stats.shm.hashtable.cas.total,
+            stats.shm.hashtable.cas.success,
+            stats.shm.hashtable.touch.total,
+            stats.shm.hashtable.touch.success,
+            stats.shm.hashtable.range.total,
+            stats.shm.hashtable.range.success,
+            stats.shm.hashtable.range.in_place,
+            stats.shm.hashtable.field.set.total,
+            stats.shm.hashtable.field.set.success,
+            stats.shm.hashtable.field.in_place,
+            stats.shm.hashtable.field.get.total,
+            stats.shm.hashtable.field.get.success,
+            stats.shm.hashtable.zset.total,
+            stats.shm.hashtable.zset.success,
             stats.shm.hashtable.get.total,
             stats.shm.hashtable.get.success,
+            stats.shm.hashtable.stale.total,
+            stats.shm.hashtable.stale.refresh,
+            stats.shm.hashtable.tombstone.hit,
+            stats.shm.hashtable.tombstone.set,
             stats.shm.hashtable.del.total,
             stats.shm.hashtable.del.success,
             stats.hit.get_qps, stats.hit.seconds, ratio,
             (int)(g_current_time - context->memory->stats.init_time),
             total_ratio, rw_ratio);
 
+    namespaces_output(&stats);
+
     printf("\nmemory stats:\n");
     printf("total: %.03f MB\n"
+            "limit: %.03f MB\n"
             "alloced: %.03f MB\n"
             "used: %.03f MB\n"
             "free: %.03f MB\n"
             "avg_key_len: %d\n"
             "avg_value_len: %d\n\n",
             (double)stats.memory.max / (1024 * 1024),
+            (double)stats.memory.limit / (1024 * 1024),
             (double)stats.memory.usage.alloced / (1024 * 1024),
             (double)stats.memory.used / (1024 * 1024),
             (double)(stats.memory.max - stats.memory.used) /
@@ -209,6 +261,78 @@ static void stats_output(struct shmcache_context *context)
             stats.shm.memory.recycle.value_striping.success,
             stats.shm.memory.recycle.value_striping.force);
 
+    printf("\nlease stats:\n");
+    printf("grant_count: %"PRId64"\n"
+            "wait_count: %"PRId64"\n"
+            "stale_count: %"PRId64"\n"
+            "fill_count: %"PRId64"\n"
+            "expire_count: %"PRId64"\n\n",
+            stats.leases.grant, stats.leases.wait, stats.leases.stale,
+            stats.leases.fill, stats.leases.expire);
+
+    if (stats.bloom.memory > 0) {
+        printf("\nbloom filter stats:\n");
+        printf("memory: %.03f MB\n"
+                "hash_count: %d\n"
+                "reject_count: %"PRId64"\n"
+                "false_positive_count: %"PRId64"\n"
+                "saturated_count: %"PRId64"\n\n",
+                (double)stats.bloom.memory / (1024 * 1024),
+                stats.bloom.hash_count, stats.bloom.reject,
+                stats.bloom.false_positive, stats.bloom.saturated);
+    }
+
+    if (context->config.compress.threshold > 0 ||
+            stats.shm.hashtable.compress.total > 0)
+    {
+        printf("\ncompress stats:\n");
+        printf("threshold: %d\n"
+                "total_count: %"PRId64"\n"
+                "skip_count: %"PRId64"\n"
+                "raw_size: %.03f MB\n"
+                "stored_size: %.03f MB\n"
+                "ratio: %.02f\n"
+                "uncompress_count: %"PRId64"\n"
+                "fail_count: %"PRId64"\n\n",
+                context->config.compress.threshold,
+                stats.shm.hashtable.compress.total,
+                stats.shm.hashtable.compress.skip,
+                (double)stats.shm.hashtable.compress.raw_bytes /
+                (1024 * 1024),
+                (double)stats.shm.hashtable.compress.stored_bytes /
+                (1024 * 1024),
+                stats.shm.hashtable.compress.stored_bytes > 0 ?
+                (double)stats.shm.hashtable.compress.raw_bytes /
+                stats.shm.hashtable.compress.stored_bytes : 1.00,
+                stats.shm.hashtable.compress.uncompress,
+                stats.shm.hashtable.compress.fail);
+    }
+
+    if (stats.dedup.threshold > 0) {
+        printf("\ndedup stats:\n");
+        printf("threshold: %d\n"
+                "blob_count: %d\n"
+                "ref_count: %"PRId64"\n"
+                "hit_count: %"PRId64"\n"
+                "blob_size: %.03f MB\n"
+                "saved_size: %.03f MB\n\n",
+                stats.dedup.threshold, stats.dedup.count,
+                stats.dedup.refs, stats.dedup.hit,
+                (double)stats.dedup.bytes / (1024 * 1024),
+                (double)stats.dedup.saved / (1024 * 1024));
+    }
+
+    if (stats.chain.part_size > 0) {
+        printf("\nchain stats:\n");
+        printf("part_size: %d\n"
+                "chained_count: %"PRId64"\n"
+                "part_count: %"PRId64"\n"
+                "chained_size: %.03f MB\n\n",
+                stats.chain.part_size, stats.chain.count,
+                stats.chain.parts,
+                (double)stats.chain.bytes / (1024 * 1024));
+    }
+
     printf("\nlock stats:\n");
     printf("total_count: %"PRId64"\n"
             "retry_count: %"PRId64"\n"
@@ -218,4 +342,81 @@ static void stats_output(struct shmcache_context *context)
             stats.shm.lock.retry,
             stats.shm.lock.detect_deadlock,
             stats.shm.lock.unlock_deadlock);
+
+    if (context->memory->checkpoint.enabled) {
+        printf("\ncheckpoint stats:\n");
+        printf("epoch: %"PRId64"\n"
+                "dirty: %s\n\n",
+                context->memory->checkpoint.epoch,
+                context->memory->checkpoint.dirty ? "true" : "false");
+    }
+
+    numa_placement_output(context);
+}
+
+static void namespaces_output(struct shmcache_stats *stats)
+{
+    struct shm_namespace *ns;
+    int i;
+
+    printf("\nnamespace stats:\n");
+    for (i=0; i<stats->namespaces.count; i++) {
+        ns = stats->namespaces.items + i;
+        printf("namespace #%d: %s\n"
+                "quota: %.03f MB%s\n"
+                "used: %.03f MB\n"
+                "current_key_count: %d\n"
+                "stale_key_count: %d\n"
+                "generation: %u\n"
+                "set.total_count: %"PRId64"\n"
+                "set.success_count: %"PRId64"\n"
+                "get.total_count: %"PRId64"\n"
+                "get.success_count: %"PRId64"\n"
+                "del.total_count: %"PRId64"\n"
+                "del.success_count: %"PRId64"\n"
+                "recycle_count: %"PRId64"\n\n",
+                i, ns->name, (double)ns->quota / (1024 * 1024),
+                ns->quota > 0 ? "" : " (unlimited)",
+                (double)ns->used / (1024 * 1024),
+                ns->count - ns->stale, ns->stale, ns->generation,
+                ns->stats.set.total, ns->stats.set.success,
+                ns->stats.get.total, ns->stats.get.success,
+                ns->stats.del.total, ns->stats.del.success,
+                ns->stats.recycle);
+    }
+}
+
+static void numa_placement_output(struct shmcache_context *context)
+{
+    int segment_index;
+    int node;
+    struct shmcache_numa_placement placement;
+
+    printf("\nnuma placement stats:\n");
+    printf("policy: %s\n", shm_numa_get_policy_name(
+                context->config.numa.policy));
+    for (segment_index=-1; segment_index<context->memory->
+            vm_info.segment.count.current; segment_index++)
+    {
+        if (shmcache_get_numa_placement(context, segment_index,
+                    &placement) != 0)
+        {
+            break;
+        }
+
+        if (segment_index < 0) {
+            printf("hashtable segment: ");
+        } else {
+            printf("value segment #%d: ", segment_index + 1);
+        }
+        printf("sampled pages: %d, absent: %d",
+                placement.sampled, placement.absent);
+        for (node=0; node<SHMCACHE_MAX_NUMA_NODES; node++) {
+            if (placement.pages[node] > 0) {
+                printf(", node%d: %d", node, placement.pages[node]);
+            }
+        }
+        printf("\n");
+    }
+    printf("\n");
 }